@@ -0,0 +1,97 @@
+#ifndef GIAGUI_BUFFEREDWRITER_HPP
+#define GIAGUI_BUFFEREDWRITER_HPP
+
+
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+
+// Formats text into a large buffer with std::to_chars and hands it to the stream in big chunks
+// Numbers come out exactly like printf() would print them, so the output matches what iostreams used to write
+// NOTE: The stream only sees the data on flush(), check it for errors after that
+struct BufferedWriter
+{
+	static constexpr size_t BUFFER_SIZE     = 1 << 20;
+	static constexpr size_t MAX_NUMBER_SIZE = 512; // A fixed point double can take over 300 characters
+	
+	std::ostream*     stream;
+	std::vector<char> buffer;
+	size_t            used = 0;
+	
+	
+	explicit BufferedWriter(std::ostream* stream) :
+		stream(stream),
+		buffer(BUFFER_SIZE)
+	{}
+	
+	~BufferedWriter()
+	{
+		flush();
+	}
+	
+	inline void flush()
+	{
+		if(used > 0)
+			stream->write(buffer.data(), used);
+		used = 0;
+	}
+	
+	inline void write(std::string_view text)
+	{
+		if(used + text.size() > buffer.size())
+		{
+			flush();
+			if(text.size() > buffer.size())
+			{
+				stream->write(text.data(), text.size());
+				return;
+			}
+		}
+		std::memcpy(buffer.data() + used, text.data(), text.size());
+		used += text.size();
+	}
+	
+	// Like `stream << std::hex << value`
+	inline void writeHex(uint64_t value)
+	{
+		formatNumber([&](char* first, char* last){ return std::to_chars(first, last, value, 16); });
+	}
+	
+	// Like `stream << std::dec << value`
+	inline void writeInteger(int64_t value)
+	{
+		formatNumber([&](char* first, char* last){ return std::to_chars(first, last, value); });
+	}
+	
+	// Like `stream << std::fixed << std::setprecision(precision) << value`
+	inline void writeFixed(double value, int precision = 6)
+	{
+		formatNumber([&](char* first, char* last){ return std::to_chars(first, last, value, std::chars_format::fixed, precision); });
+	}
+	
+	// Like `stream << std::scientific << std::setprecision(precision) << value`
+	inline void writeScientific(double value, int precision = 6)
+	{
+		formatNumber([&](char* first, char* last){ return std::to_chars(first, last, value, std::chars_format::scientific, precision); });
+	}
+
+
+protected:
+	template<typename F>
+	inline void formatNumber(F&& format)
+	{
+		if(used + MAX_NUMBER_SIZE > buffer.size())
+			flush();
+		std::to_chars_result result = format(buffer.data() + used, buffer.data() + buffer.size());
+		assert(result.ec == std::errc());
+		used = result.ptr - buffer.data();
+	}
+};
+
+
+#endif //GIAGUI_BUFFEREDWRITER_HPP
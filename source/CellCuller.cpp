@@ -0,0 +1,59 @@
+#include "CellCuller.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "CellGeometryCache.hpp"
+
+
+void CellCuller::reset(QSizeF surfaceSize)
+{
+	if(this->surfaceSize == surfaceSize && !bounds.empty())
+		return;
+	this->surfaceSize = surfaceSize;
+	
+	uint64_t slotCount = h3DenseSlotCount(CULLING_RESOLUTION);
+	bounds.assign(slotCount, QRectF());
+	visible.assign(slotCount, 1);
+	
+	std::vector<H3Index> neighbors(maxKringSize(1));
+	CellGeometry geometry;
+	for(uint64_t slot = 0; slot < slotCount; ++slot)
+	{
+		// NOTE: Pentagons have no children along the deleted K axis, those slots do not belong to any cell
+		H3Index index = h3FromDenseSlot(slot, CULLING_RESOLUTION);
+		if(!h3IsValid(index))
+			continue;
+		
+		std::fill(neighbors.begin(), neighbors.end(), H3_INVALID_INDEX);
+		kRing(index, 1, neighbors.data());
+		
+		double minX = DOUBLE_MAX;
+		double minY = DOUBLE_MAX;
+		double maxX = -DOUBLE_MAX;
+		double maxY = -DOUBLE_MAX;
+		for(H3Index neighbor : neighbors)
+		{
+			if(neighbor == H3_INVALID_INDEX)
+				continue;
+			
+			computeCellGeometry(neighbor, surfaceSize, &geometry);
+			for(int i = 0; i < geometry.pointsCount(); ++i)
+			{
+				minX = std::min(minX, geometry.points[i].x());
+				minY = std::min(minY, geometry.points[i].y());
+				maxX = std::max(maxX, geometry.points[i].x());
+				maxY = std::max(maxY, geometry.points[i].y());
+			}
+		}
+		bounds[slot] = QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+	}
+}
+
+
+void CellCuller::setVisibleRect(const QRectF& rect)
+{
+	assert(!bounds.empty());
+	for(size_t slot = 0; slot < bounds.size(); ++slot)
+		visible[slot] = bounds[slot].intersects(rect) ? 1 : 0;
+}
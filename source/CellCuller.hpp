@@ -0,0 +1,46 @@
+#ifndef GIAGUI_CELLCULLER_HPP
+#define GIAGUI_CELLCULLER_HPP
+
+#include <vector>
+#include <QRectF>
+#include <QSizeF>
+#include <h3/h3api.h>
+
+#include "MapUtils.hpp"
+
+
+// Tells which cells may intersect a rectangle of the map, by looking at their ancestor at CULLING_RESOLUTION
+// The bounds of each ancestor cover its neighbors too, because descendants can stick out of the outline of their
+// ancestor, but never past its neighbors. Tests are conservative: cells reported as hidden are certainly hidden
+struct CellCuller
+{
+	static constexpr int CULLING_RESOLUTION = 2; // 5882 cells, each about 1/100 of the map wide
+	
+	QSizeF               surfaceSize;
+	std::vector<QRectF>  bounds;  // Map space bounds of each cell at CULLING_RESOLUTION, by dense slot
+	std::vector<uint8_t> visible; // Whether each of those bounds intersects the rectangle given to setVisibleRect()
+	
+	
+	// Recomputes the bounds if `surfaceSize` differs from the one they were computed for
+	void reset(QSizeF surfaceSize);
+	void setVisibleRect(const QRectF& rect);
+	
+	inline bool isVisible(H3Index index) const;
+};
+
+
+inline bool CellCuller::isVisible(H3Index index) const
+{
+	int resolution = H3_GET_RESOLUTION(index);
+	if(resolution < CULLING_RESOLUTION)
+		return true;
+	
+	// Same as h3ToDenseSlot() of the ancestor, without computing the ancestor
+	uint64_t slot = H3_GET_BASE_CELL(index);
+	for(int r = 1; r <= CULLING_RESOLUTION; ++r)
+		slot = slot * 7 + H3_GET_INDEX_DIGIT(index, r);
+	return visible[slot];
+}
+
+
+#endif //GIAGUI_CELLCULLER_HPP
@@ -0,0 +1,373 @@
+#include "CellGeometryCache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <QPainter>
+
+#include "MapUtils.hpp"
+#include "Parallel.hpp"
+
+
+#define FILL_MIN_RANGE_CELLS 1024 // Cells looked up per task of fill(), projecting a cell costs a few microseconds
+
+
+static GeoCoord getEasternAntimeridianCrossingPoint(const GeoCoord& east, const GeoCoord& west)
+{
+	assert(east.lon >= 0.0);
+	assert(west.lon <= 0.0);
+	
+	GeoCoord anti; // antimeridian crossing point
+	anti.lon = PI; // we always draw the eastern segment first because I like it this way
+	
+	// Compute longitude `WEST` (move `west` by one full globe in the direction of the prime meridian)
+	// Basically, we remap the longitude of `west` from [-180, 0] to [180, 360]
+	// On the globe, `WEST` has the same angular distance from `east` as the original `west`, and computing the length by difference is correct
+	double WEST_lon = west.lon + 2*PI;
+	double east2anti_longitude_len = anti.lon - east.lon;
+	double east2west_longitude_len = WEST_lon - west.lon;
+	
+	// Compute latitude by linear interpolation
+	// c = a + t*(b-a)    =>    t = (c-a) / (b-a)
+	double t = east2anti_longitude_len / east2west_longitude_len;
+	anti.lat = east.lat + t * (west.lat - east.lat);
+	
+	return anti;
+}
+
+
+static void computePolarGeometry(GeoBoundary* geoBoundary, QSizeF surfaceSize, CellGeometry* outGeometry)
+{
+	QPointF* points      = outGeometry->points;
+	int      pointsCount = 0;
+	for(int i = 0; i < geoBoundary->numVerts; ++i)
+	{
+		const GeoCoord& p = geoBoundary->verts[i];
+		points[pointsCount++] = toMapCoord(p, surfaceSize);
+		
+		const GeoCoord& q = geoBoundary->verts[(i+1) % geoBoundary->numVerts];
+		if(edgeCrossesAntimeridian(p.lon, q.lon))
+		{
+			const GeoCoord& east = p.lon > 0 ? p : q;
+			const GeoCoord& west = p.lon > 0 ? q : p;
+			GeoCoord anti = getEasternAntimeridianCrossingPoint(east, west);
+			
+			// The crossing points and the corners between them are not on the cell boundary
+			outGeometry->synthetic |= uint16_t(0xF << pointsCount);
+			
+			// All points are either above or below the equator, so check any one point
+			bool isNorthern = p.lat > 0;
+			// NOTE: Points must be added in counterclockwise order
+			if(isNorthern)
+			{
+				points[pointsCount++] = toMapCoord(anti, surfaceSize);   // eastern crossing point
+				points[pointsCount++] = QPointF(surfaceSize.width(), 0); // top-right corner
+				points[pointsCount++] = QPointF(0, 0);                   // top-left corner
+				anti.lon = -anti.lon;
+				points[pointsCount++] = toMapCoord(anti, surfaceSize);   // western crossing point
+			}
+			else
+			{
+				anti.lon = -anti.lon; // First point in ccw order is western, not eastern
+				points[pointsCount++] = toMapCoord(anti, surfaceSize);                      // western crossing point
+				points[pointsCount++] = QPointF(0, surfaceSize.height());                   // bottom-left corner
+				points[pointsCount++] = QPointF(surfaceSize.width(), surfaceSize.height()); // bottom-right corner
+				anti.lon = -anti.lon; // go back to eastern point
+				points[pointsCount++] = toMapCoord(anti, surfaceSize);                      // eastern crossing point
+			}
+		}
+	}
+	outGeometry->counts[0] = pointsCount;
+}
+
+
+static void computeAntimeridianGeometry(GeoBoundary* geoBoundary, QSizeF surfaceSize, CellGeometry* outGeometry)
+{
+	QPointF  pointsEast[CellGeometry::MAX_POINTS];
+	int      pointsEastCount = 0;
+	uint16_t syntheticEast   = 0;
+	QPointF  pointsWest[CellGeometry::MAX_POINTS];
+	int      pointsWestCount = 0;
+	uint16_t syntheticWest   = 0;
+	
+	for(int i = 0; i < geoBoundary->numVerts; ++i)
+	{
+		const GeoCoord& p = geoBoundary->verts[i];
+		if(p.lon > 0)
+			pointsEast[pointsEastCount++] = toMapCoord(p, surfaceSize);
+		else
+			pointsWest[pointsWestCount++] = toMapCoord(p, surfaceSize);
+		
+		const GeoCoord& q = geoBoundary->verts[(i+1) % geoBoundary->numVerts];
+		if(edgeCrossesAntimeridian(p.lon, q.lon))
+		{
+			const GeoCoord& east = p.lon > 0 ? p : q;
+			const GeoCoord& west = p.lon > 0 ? q : p;
+			GeoCoord anti = getEasternAntimeridianCrossingPoint(east, west);
+			
+			syntheticEast |= uint16_t(1 << pointsEastCount);
+			pointsEast[pointsEastCount++] = toMapCoord(anti, surfaceSize);
+			anti.lon = -anti.lon;
+			syntheticWest |= uint16_t(1 << pointsWestCount);
+			pointsWest[pointsWestCount++] = toMapCoord(anti, surfaceSize);
+		}
+	}
+	
+	assert(pointsEastCount > 0);
+	assert(pointsWestCount > 0);
+	assert(pointsEastCount + pointsWestCount <= CellGeometry::MAX_POINTS);
+	std::copy(pointsEast, pointsEast + pointsEastCount, outGeometry->points);
+	std::copy(pointsWest, pointsWest + pointsWestCount, outGeometry->points + pointsEastCount);
+	outGeometry->counts[0] = pointsEastCount;
+	outGeometry->counts[1] = pointsWestCount;
+	outGeometry->synthetic = syntheticEast | uint16_t(syntheticWest << pointsEastCount);
+}
+
+
+void computeCellGeometry(H3Index index, QSizeF surfaceSize, CellGeometry* outGeometry)
+{
+	GeoBoundary geoBoundary;
+	h3ToGeoBoundary(index, &geoBoundary);
+	
+	outGeometry->counts[0] = 0;
+	outGeometry->counts[1] = 0;
+	outGeometry->synthetic = 0;
+	
+	int crossPointsCount = countEdgesCrossingAntimeridian(&geoBoundary);
+	if(crossPointsCount == 0)
+	{
+		for(int i = 0; i < geoBoundary.numVerts; ++i)
+			outGeometry->points[i] = toMapCoord(geoBoundary.verts[i], surfaceSize);
+		outGeometry->counts[0] = geoBoundary.numVerts;
+	}
+	else if(crossPointsCount == 1)
+	{
+		computePolarGeometry(&geoBoundary, surfaceSize, outGeometry);
+	}
+	else
+	{
+		computeAntimeridianGeometry(&geoBoundary, surfaceSize, outGeometry);
+	}
+}
+
+
+QRectF CellGeometry::boundingRect(int polygon) const
+{
+	assert(polygon == 0 || polygon == 1);
+	const QPointF* first = points + (polygon == 0 ? 0 : counts[0]);
+	int            count = counts[polygon];
+	if(count == 0)
+		return QRectF();
+	
+	double minX = first[0].x(), maxX = first[0].x();
+	double minY = first[0].y(), maxY = first[0].y();
+	for(int i = 1; i < count; ++i)
+	{
+		minX = std::min(minX, first[i].x());
+		maxX = std::max(maxX, first[i].x());
+		minY = std::min(minY, first[i].y());
+		maxY = std::max(maxY, first[i].y());
+	}
+	return QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+}
+
+
+void CellGeometryCache::reset(int resolution, QSizeF surfaceSize)
+{
+	if(this->resolution == resolution && this->surfaceSize == surfaceSize)
+		return;
+	
+	clear();
+	this->resolution  = resolution;
+	this->surfaceSize = surfaceSize;
+}
+
+
+void CellGeometryCache::clear()
+{
+	entries.clear();
+	points = std::vector<Point>();
+	centers.clear();
+}
+
+
+bool CellGeometryCache::find(H3Index index, CellGeometry* outGeometry) const
+{
+	assert(index != H3_INVALID_INDEX);
+	
+	const Entry* entry = entries.get(index);
+	if(!entry)
+		return false;
+	
+	const Point* first = points.data() + entry->first;
+	for(int i = 0, count = entry->counts[0] + entry->counts[1]; i < count; ++i)
+		outGeometry->points[i] = QPointF(first[i].x, first[i].y);
+	outGeometry->counts[0] = entry->counts[0];
+	outGeometry->counts[1] = entry->counts[1];
+	outGeometry->synthetic = entry->synthetic;
+	return true;
+}
+
+
+void CellGeometryCache::get(H3Index index, CellGeometry* outGeometry)
+{
+	if(find(index, outGeometry))
+		return;
+	
+	computeCellGeometry(index, surfaceSize, outGeometry);
+	if(entries.size() < MAX_CELLS)
+	{
+		Entry newEntry;
+		append(*outGeometry, &points, &newEntry);
+		entries.insert({index, newEntry});
+	}
+}
+
+
+void CellGeometryCache::fill(const H3Index* indices, size_t count)
+{
+	// Each range projects its misses into arrays of its own, which are merged on the calling thread
+	struct Misses
+	{
+		std::vector<std::pair<H3Index, Entry>> entries;
+		std::vector<Point>                     points;
+	};
+	
+	// NOTE: Ranges take room one cell at a time, so that all together they never go past MAX_CELLS
+	std::atomic<size_t> room(MAX_CELLS - std::min(MAX_CELLS, entries.size()));
+	std::vector<Misses> misses;
+	std::mutex          missesMutex;
+	parallelFor(count, FILL_MIN_RANGE_CELLS, [&](size_t begin, size_t end)
+	{
+		Misses       rangeMisses;
+		CellGeometry geometry;
+		for(size_t i = begin; i < end; ++i)
+		{
+			if(entries.get(indices[i]))
+				continue;
+			
+			size_t left = room;
+			while(left > 0 && !room.compare_exchange_weak(left, left - 1));
+			if(left == 0)
+				break;
+			
+			Entry newEntry;
+			computeCellGeometry(indices[i], surfaceSize, &geometry);
+			append(geometry, &rangeMisses.points, &newEntry);
+			rangeMisses.entries.push_back({indices[i], newEntry});
+		}
+		
+		std::lock_guard<std::mutex> lock(missesMutex);
+		misses.push_back(std::move(rangeMisses));
+	});
+	
+	for(Misses& rangeMisses : misses)
+	{
+		entries.reserve(entries.size() + rangeMisses.entries.size());
+		uint32_t offset = (uint32_t)points.size();
+		points.insert(points.end(), rangeMisses.points.begin(), rangeMisses.points.end());
+		for(auto& [index, entry] : rangeMisses.entries)
+		{
+			entry.first += offset;
+			entries.insert({index, entry});
+		}
+	}
+}
+
+
+void CellGeometryCache::append(const CellGeometry& geometry, std::vector<Point>* points, Entry* outEntry)
+{
+	outEntry->first     = (uint32_t)points->size();
+	outEntry->synthetic = geometry.synthetic;
+	outEntry->counts[0] = (uint8_t)geometry.counts[0];
+	outEntry->counts[1] = (uint8_t)geometry.counts[1];
+	for(int i = 0; i < geometry.pointsCount(); ++i)
+		points->push_back({(float)geometry.points[i].x(), (float)geometry.points[i].y()});
+}
+
+
+QPointF CellGeometryCache::center(H3Index index)
+{
+	assert(index != H3_INVALID_INDEX);
+	
+	const Point* point = centers.get(index);
+	if(point)
+		return QPointF(point->x, point->y);
+	
+	GeoCoord geoCenter;
+	h3ToGeo(index, &geoCenter);
+	QPointF result = toMapCoord(geoCenter, surfaceSize);
+	if(centers.size() < MAX_CELLS)
+		centers.insert({index, {(float)result.x(), (float)result.y()}});
+	return result;
+}
+
+
+void CellGeometryCache::drawCell(QPainter* painter, H3Index index)
+{
+	CellGeometry geometry;
+	get(index, &geometry);
+	drawCellGeometry(painter, geometry);
+}
+
+
+void drawCellGeometry(QPainter* painter, const CellGeometry& geometry)
+{
+	if(geometry.isConvex())
+	{
+		painter->drawConvexPolygon(geometry.points, geometry.counts[0]);
+		if(geometry.isSplit())
+			painter->drawConvexPolygon(geometry.points + geometry.counts[0], geometry.counts[1]);
+	}
+	else
+	{
+		// NOTE: Polygon can be concave
+		painter->drawPolygon(geometry.points, geometry.counts[0]);
+	}
+	
+#if ENABLE_DEBUG_DRAW_GEOBOUNDARY_VERTICES
+	QFont font = painter->font();
+	font.setPointSizeF(font.pointSizeF() * 0.4);
+	painter->setFont(font);
+	for(int i = 0; i < geometry.pointsCount(); ++i)
+	{
+		painter->setPen(QPen(QColor(255, 0, 255, 255), 1));
+		painter->setBrush(QBrush(QColor(255, 0, 0, 63), Qt::BrushStyle::SolidPattern));
+		painter->drawPoint(geometry.points[i]);
+		
+		painter->setPen(QPen(QColor(0, 0, 0, 255), 1));
+		painter->setBrush(QBrush(QColor(0, 0, 0, 255), Qt::BrushStyle::SolidPattern));
+		painter->drawText(geometry.points[i], QString::number(i));
+	}
+#endif
+}
+
+
+void CellGeometryCache::drawCellEdges(QPainter* painter, H3Index index)
+{
+	CellGeometry geometry;
+	get(index, &geometry);
+	
+	if(geometry.synthetic == 0)
+	{
+		painter->drawConvexPolygon(geometry.points, geometry.counts[0]);
+		return;
+	}
+	
+	// Segments between two points added by the cut run along the map border, they are not edges of the cell
+	int first = 0;
+	for(int polygon = 0; polygon < 2; ++polygon)
+	{
+		int count = geometry.counts[polygon];
+		for(int i = 0; i < count; ++i)
+		{
+			int  a = first + i;
+			int  b = first + (i+1) % count;
+			bool alongBorder = (geometry.synthetic & (1 << a)) && (geometry.synthetic & (1 << b));
+			if(!alongBorder)
+				painter->drawLine(QLineF(geometry.points[a], geometry.points[b]));
+		}
+		first += count;
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef GIAGUI_CELLGEOMETRYCACHE_HPP
+#define GIAGUI_CELLGEOMETRYCACHE_HPP
+
+#include <vector>
+#include <QPointF>
+#include <QRectF>
+#include <QSizeF>
+#include <h3/h3api.h>
+
+#include "Containers.hpp"
+
+
+class QPainter;
+
+
+// Outline of a cell in map coordinates, ready to be drawn
+// Cells that cross the antimeridian are cut along it: polar cells become one concave polygon closed along the top or
+// bottom border of the map, the others become two convex polygons, one on each side of the map
+struct CellGeometry
+{
+	// Enough for a split pentagon with distortion vertices (10 + 2 crossing points per side) or a polar cell (10 + 4)
+	static constexpr int MAX_POINTS = MAX_CELL_BNDRY_VERTS + 4;
+	
+	QPointF  points[MAX_POINTS];
+	int      counts[2];  // Points of each polygon. The second polygon is only there for cells split by the antimeridian
+	uint16_t synthetic;  // Bit i is set if points[i] lies on the map border because of the cut, not on the cell boundary
+	
+	
+	inline int  pointsCount() const { return counts[0] + counts[1]; }
+	inline bool isSplit() const     { return counts[1] > 0; }
+	inline bool isConvex() const    { return synthetic == 0 || isSplit(); }
+	
+	// Map space bounds of one of the two polygons
+	QRectF boundingRect(int polygon) const;
+};
+
+
+// Projected outlines of cells, so that repaints do not repeat the H3 math
+// Map coordinates do not depend on zoom or scroll, so entries stay valid until the map size changes. Entries are only
+// dropped all together, when the resolution of the drawn cells changes (see reset())
+// NOTE: A full resolution 6 globe would take over a gigabyte, so only the first MAX_CELLS cells asked for are stored.
+// The others are computed every time
+struct CellGeometryCache
+{
+	static constexpr size_t MAX_CELLS = 1 << 21; // Every cell up to resolution 5, about 150 MB
+	
+	// Single precision is plenty for map coordinates and halves the memory
+	struct Point
+	{
+		float x;
+		float y;
+	};
+	
+	struct Entry
+	{
+		uint32_t first;     // Position of the first point in `points`
+		uint16_t synthetic;
+		uint8_t  counts[2];
+	};
+	
+	
+	QSizeF                      surfaceSize;
+	int                         resolution = -1;
+	FlatHashMap<H3Index, Entry> entries;
+	std::vector<Point>          points;
+	FlatHashMap<H3Index, Point> centers; // Only of the cells center() was called for
+	
+	
+	// Drops all entries if `resolution` or `surfaceSize` differ from the ones of the stored entries
+	void reset(int resolution, QSizeF surfaceSize);
+	void clear();
+	
+	void get(H3Index index, CellGeometry* outGeometry);
+	
+	// Like get(), but never stores anything, so any number of threads can call it while no one calls get()
+	bool find(H3Index index, CellGeometry* outGeometry) const;
+	
+	// Stores the cells that are not stored yet, as long as there is room. The missing ones are projected on the thread pool
+	// Call before handing the cells to threads that only find() them
+	void fill(const H3Index* indices, size_t count);
+	
+	// Map position of the center of the cell. Stored like outlines, but apart from them, as few cells need it
+	QPointF center(H3Index index);
+	
+	// Fills the cell with the current brush and outlines it with the current pen
+	void drawCell(QPainter* painter, H3Index index);
+	
+	// Draws only the edges of the cell, without the segments added along the map border by the antimeridian cut
+	void drawCellEdges(QPainter* painter, H3Index index);
+
+
+protected:
+	static void append(const CellGeometry& geometry, std::vector<Point>* points, Entry* outEntry);
+};
+
+
+// Projects the boundary of `index` to map coordinates, cutting it along the antimeridian if needed
+void computeCellGeometry(H3Index index, QSizeF surfaceSize, CellGeometry* outGeometry);
+
+// Fills the polygons with the current brush and outlines them with the current pen
+void drawCellGeometry(QPainter* painter, const CellGeometry& geometry);
+
+
+#endif //GIAGUI_CELLGEOMETRYCACHE_HPP
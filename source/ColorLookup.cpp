@@ -0,0 +1,157 @@
+#include "ColorLookup.hpp"
+
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+
+// Colors sampled at evenly spaced points, interpolated linearly in between
+struct ColorStop
+{
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+};
+
+
+// https://bids.github.io/colormap/
+static const ColorStop VIRIDIS_STOPS[] = {
+	{ 68,   1,  84},
+	{ 71,  45, 123},
+	{ 59,  82, 139},
+	{ 44, 114, 142},
+	{ 33, 145, 140},
+	{ 40, 174, 128},
+	{ 94, 201,  98},
+	{173, 220,  48},
+	{253, 231,  37},
+};
+
+
+// Moreland's "cool to warm", see https://www.kennethmoreland.com/color-maps/
+static const ColorStop DIVERGING_STOPS[] = {
+	{ 59,  76, 192},
+	{141, 176, 254},
+	{221, 221, 221},
+	{244, 154, 123},
+	{180,   4,  38},
+};
+
+
+template<size_t N>
+static QColor interpolateStops(const ColorStop (&stops)[N], double t)
+{
+	double position = t * double(N - 1);
+	size_t i        = std::min(size_t(position), N - 2);
+	double f        = position - double(i);
+	auto lerp = [f](uint8_t a, uint8_t b) { return int(std::lround(a + (b - a) * f)); };
+	return QColor(lerp(stops[i].r, stops[i+1].r), lerp(stops[i].g, stops[i+1].g), lerp(stops[i].b, stops[i+1].b), ColorLookup::ALPHA);
+}
+
+
+ColorLookup::ColorLookup()
+{
+	setColormap(Colormap::Hue);
+}
+
+
+const char* ColorLookup::colormapName(Colormap colormap)
+{
+	switch(colormap)
+	{
+		case Colormap::Hue:       return "Hue";
+		case Colormap::Viridis:   return "Viridis";
+		case Colormap::Diverging: return "Diverging";
+	}
+	return "";
+}
+
+
+bool ColorLookup::colormapFromName(const std::string& name, Colormap* outColormap)
+{
+	assert(outColormap);
+	for(Colormap colormap : {Colormap::Hue, Colormap::Viridis, Colormap::Diverging})
+	{
+		const char* candidate = colormapName(colormap);
+		bool equal = name.size() == std::strlen(candidate) && std::equal(name.begin(), name.end(), candidate, [](char a, char b)
+		{
+			return std::tolower((unsigned char)a) == std::tolower((unsigned char)b);
+		});
+		if(equal)
+		{
+			*outColormap = colormap;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+QColor ColorLookup::colormapColor(Colormap colormap, double t)
+{
+	assert(0.0 <= t && t <= 1.0);
+	switch(colormap)
+	{
+		case Colormap::Hue:
+		{
+			// NOTE: 0 = red, 240 = somewhere in the middle of blue hue; we want the opposite, i.e. red high values, hence 1-t
+			int hue = int((1.0-t) * 240.0);
+			return QColor::fromHsv(hue, 255, 255, ALPHA);
+		}
+		case Colormap::Viridis:
+			return interpolateStops(VIRIDIS_STOPS, t);
+		case Colormap::Diverging:
+			return interpolateStops(DIVERGING_STOPS, t);
+	}
+	return QColor();
+}
+
+
+void ColorLookup::setColormap(Colormap colormap)
+{
+	this->colormap = colormap;
+	for(int i = 0; i < BINS; ++i)
+		brushes[i] = QBrush(colormapColor(colormap, double(i) / double(BINS - 1)), Qt::BrushStyle::SolidPattern);
+}
+
+
+void ColorLookup::setRange(double minValue, double maxValue)
+{
+	assert(minValue <= maxValue);
+	
+	if(colormap == Colormap::Diverging)
+	{
+		double extent = std::max(std::abs(minValue), std::abs(maxValue));
+		minValue = -extent;
+		maxValue = +extent;
+	}
+	
+	// NOTE: A single value gets the last bin (red with the hue colormap), or the neutral middle one if diverging
+	if(minValue == maxValue)
+	{
+		scale  = 0.0;
+		offset = colormap == Colormap::Diverging ? (BINS - 1) / 2 : BINS - 1;
+		return;
+	}
+	
+	// bin = (value - min) / (max - min) * (BINS-1), rounded to the nearest
+	scale  = double(BINS - 1) / (maxValue - minValue);
+	offset = -minValue * scale + 0.5;
+}
+
+
+void ColorLookup::binValues(const GeoValue* values, size_t count, bool isInteger, uint16_t* outBins) const
+{
+	const double lastBin = double(BINS - 1);
+	if(isInteger)
+	{
+		for(size_t i = 0; i < count; ++i)
+			outBins[i] = uint16_t(std::min(std::max(double(values[i].integer) * scale + offset, 0.0), lastBin));
+	}
+	else
+	{
+		for(size_t i = 0; i < count; ++i)
+			outBins[i] = uint16_t(std::min(std::max(values[i].real * scale + offset, 0.0), lastBin));
+	}
+}
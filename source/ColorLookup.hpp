@@ -0,0 +1,62 @@
+#ifndef GIAGUI_COLORLOOKUP_HPP
+#define GIAGUI_COLORLOOKUP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <QBrush>
+#include <QColor>
+
+#include "GeoValue.hpp"
+
+
+enum class Colormap
+{
+	Hue,       // Blue for low values to red for high values, through the hue wheel
+	Viridis,   // Perceptually uniform dark purple to yellow, readable in grayscale
+	Diverging, // Blue for negative values, light gray for zero, red for positive values
+};
+
+
+// Colors of dataset values, computed once per value range instead of once per cell
+// A value becomes a bin with one multiply-add and a clamp, and the bin indexes a table of brushes
+struct ColorLookup
+{
+	static constexpr int BINS  = 1024;
+	static constexpr int ALPHA = 64; // Cells are translucent so that the map shows through
+	
+	Colormap colormap = Colormap::Hue;
+	double   scale    = 0.0;
+	double   offset   = BINS - 1;
+	QBrush   brushes[BINS];
+	
+	
+	explicit ColorLookup();
+	
+	static const char* colormapName(Colormap colormap);
+	static bool        colormapFromName(const std::string& name, Colormap* outColormap); // Case insensitive
+	static QColor      colormapColor(Colormap colormap, double t);
+	
+	// Rebuilds the brushes. Bins keep their meaning, so values do not need to be binned again
+	void setColormap(Colormap colormap);
+	
+	// `minValue` gets the first bin and `maxValue` the last. Diverging colormaps center the range on zero instead
+	void setRange(double minValue, double maxValue);
+	
+	inline int bin(double value) const;
+	
+	// Bins a whole column of values. Kept branch-free so that the compiler can vectorize it
+	void binValues(const GeoValue* values, size_t count, bool isInteger, uint16_t* outBins) const;
+};
+
+
+inline int ColorLookup::bin(double value) const
+{
+	double result = value * scale + offset;
+	result = std::min(std::max(result, 0.0), double(BINS - 1));
+	return int(result);
+}
+
+
+#endif //GIAGUI_COLORLOOKUP_HPP
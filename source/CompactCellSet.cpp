@@ -0,0 +1,150 @@
+#include "CompactCellSet.hpp"
+
+#include <cassert>
+
+
+void CompactCellSet::reset(int resolution)
+{
+	assert(IS_VALID_RESOLUTION(resolution));
+	clear();
+	this->resolution = resolution;
+}
+
+
+void CompactCellSet::clear()
+{
+	cells.clear();
+	cellCount = 0;
+}
+
+
+bool CompactCellSet::contains(H3Index index) const
+{
+	assert(index != H3_INVALID_INDEX);
+	if(cells.empty())
+		return false;
+	
+	for(int r = H3_GET_RESOLUTION(index); r >= 0; --r)
+	{
+		if(cells.count(r == H3_GET_RESOLUTION(index) ? index : h3ToParent(index, r)) != 0)
+			return true;
+	}
+	return false;
+}
+
+
+void CompactCellSet::insert(H3Index index)
+{
+	assert(index != H3_INVALID_INDEX);
+	assert(H3_GET_RESOLUTION(index) == resolution);
+	if(contains(index))
+		return;
+	cellCount += 1;
+	
+	// Siblings that are all in the set become their parent, then the same for the parent
+	// NOTE: The set is compacted, so a sibling that is entirely in the set is stored as itself
+	for(int r = resolution; r > 0; --r)
+	{
+		H3Index parent = h3ToParent(index, r - 1);
+		H3Index siblings[7];
+		h3ToChildren(parent, r, siblings);
+		
+		bool complete = true;
+		for(H3Index sibling : siblings)
+		{
+			if(sibling != H3_INVALID_INDEX && sibling != index && cells.count(sibling) == 0)
+			{
+				complete = false;
+				break;
+			}
+		}
+		if(!complete)
+			break;
+		
+		for(H3Index sibling : siblings)
+			if(sibling != H3_INVALID_INDEX && sibling != index)
+				cells.erase(sibling);
+		index = parent;
+	}
+	cells.insert(index);
+}
+
+
+void CompactCellSet::erase(H3Index index)
+{
+	assert(index != H3_INVALID_INDEX);
+	assert(H3_GET_RESOLUTION(index) == resolution);
+	
+	int     ancestorResolution = resolution;
+	H3Index ancestor           = index;
+	while(cells.count(ancestor) == 0)
+	{
+		if(ancestorResolution == 0)
+			return;
+		ancestorResolution -= 1;
+		ancestor = h3ToParent(index, ancestorResolution);
+	}
+	cells.erase(ancestor);
+	cellCount -= 1;
+	
+	// Splits the stored ancestor down to `index`, keeping all the other branches
+	for(int r = ancestorResolution + 1; r <= resolution; ++r)
+	{
+		H3Index child = r == resolution ? index : h3ToParent(index, r);
+		H3Index siblings[7];
+		h3ToChildren(ancestor, r, siblings);
+		for(H3Index sibling : siblings)
+			if(sibling != H3_INVALID_INDEX && sibling != child)
+				cells.insert(sibling);
+		ancestor = child;
+	}
+}
+
+
+void CompactCellSet::setResolution(int newResolution)
+{
+	assert(IS_VALID_RESOLUTION(newResolution));
+	if(newResolution < resolution)
+	{
+		HashSet<H3Index> parents;
+		parents.reserve(cells.size());
+		for(H3Index cell : cells)
+			parents.insert(H3_GET_RESOLUTION(cell) > newResolution ? h3ToParent(cell, newResolution) : cell);
+		cells = std::move(parents);
+		compact(newResolution);
+	}
+	resolution = newResolution;
+	updateCellCount();
+}
+
+
+void CompactCellSet::compact(int fromResolution)
+{
+	for(int r = fromResolution; r > 0; --r)
+	{
+		HashMap<H3Index, int> childrenFound;
+		for(H3Index cell : cells)
+			if(H3_GET_RESOLUTION(cell) == r)
+				childrenFound[h3ToParent(cell, r - 1)] += 1;
+		
+		for(const auto& [parent, count] : childrenFound)
+		{
+			if(uint64_t(count) != h3ChildrenCount(parent, r))
+				continue;
+			
+			H3Index children[7];
+			h3ToChildren(parent, r, children);
+			for(H3Index child : children)
+				cells.erase(child);
+			cells.insert(parent);
+		}
+	}
+}
+
+
+void CompactCellSet::updateCellCount()
+{
+	cellCount = 0;
+	for(H3Index cell : cells)
+		cellCount += h3ChildrenCount(cell, resolution);
+}
@@ -0,0 +1,135 @@
+#ifndef GIAGUI_COMPACTCELLSET_HPP
+#define GIAGUI_COMPACTCELLSET_HPP
+
+#include <cstddef>
+#include <h3/h3api.h>
+
+#include "Containers.hpp"
+#include "MapUtils.hpp"
+
+
+// Set of cells at one resolution, stored compacted: whenever all the children of a cell are in the set, the set stores
+// the cell instead of them. Selecting a continent takes thousands of entries instead of millions, and changing the
+// resolution of the set only touches those entries
+// Iterating visits every cell at `resolution`, expanding the stored cells on the fly
+struct CompactCellSet
+{
+	// Visits the descendants at `resolution` of each stored cell, in ascending digit order
+	// NOTE: Like the iterators of HashSet, this is invalidated by any change to the set
+	struct Iterator
+	{
+		HashSet<H3Index>::const_iterator cell;
+		HashSet<H3Index>::const_iterator last;
+		int                              resolution;
+		H3Index                          index    = H3_INVALID_INDEX; // Current descendant of *cell
+		bool                             pentagon = false;            // Whether *cell is a pentagon
+		
+		inline Iterator(HashSet<H3Index>::const_iterator cell, HashSet<H3Index>::const_iterator last, int resolution);
+		inline void      start();
+		inline H3Index   operator*() const { return index; }
+		inline Iterator& operator++();
+		inline bool operator==(const Iterator& that) const { return cell == that.cell && index == that.index; }
+		inline bool operator!=(const Iterator& that) const { return !(*this == that); }
+	};
+	
+	
+	HashSet<H3Index> cells;          // Mixed resolution, none is the descendant of another
+	int              resolution = 0;
+	size_t           cellCount  = 0; // Cells at `resolution`, i.e. the number of iterations
+	
+	
+	inline size_t   size() const  { return cellCount; }
+	inline bool     empty() const { return cells.empty(); }
+	inline Iterator begin() const { return Iterator(cells.begin(), cells.end(), resolution); }
+	inline Iterator end() const   { return Iterator(cells.end(),   cells.end(), resolution); }
+	
+	// Empties the set and makes it hold cells at `resolution`
+	void reset(int resolution);
+	void clear();
+	
+	// Whether `index`, or any of its parents, is stored. Works with cells at any resolution
+	bool contains(H3Index index) const;
+	
+	// Both take a cell at `resolution`, and keep the set compacted. Each costs a few hash lookups per resolution level
+	void insert(H3Index index);
+	void erase(H3Index index);
+	
+	template<typename It>
+	void insert(It first, It last);
+	
+	// Finer resolutions keep the stored cells as they are, they just stand for more children. Coarser resolutions
+	// replace each finer cell with its parent, so that any child in the set selects its parent
+	void setResolution(int newResolution);
+
+
+protected:
+	// Replaces every complete group of siblings finer than `fromResolution` with their parent, level by level
+	void compact(int fromResolution);
+	void updateCellCount();
+};
+
+
+inline CompactCellSet::Iterator::Iterator(HashSet<H3Index>::const_iterator cell, HashSet<H3Index>::const_iterator last, int resolution)
+	: cell(cell), last(last), resolution(resolution)
+{
+	start();
+}
+
+
+inline void CompactCellSet::Iterator::start()
+{
+	if(cell == last)
+	{
+		index = H3_INVALID_INDEX;
+		return;
+	}
+	
+	// First descendant: all the digits below the stored cell are zero. This is never on the deleted axis of a pentagon
+	index    = H3_SET_RESOLUTION(*cell, resolution);
+	pentagon = h3IsPentagon(*cell);
+	for(int r = H3_GET_RESOLUTION(*cell) + 1; r <= resolution; ++r)
+		index = H3_SET_INDEX_DIGIT(index, r, 0);
+}
+
+
+inline CompactCellSet::Iterator& CompactCellSet::Iterator::operator++()
+{
+	int cellResolution = H3_GET_RESOLUTION(*cell);
+	for(;;)
+	{
+		// Counts in base 7 over the digits below the stored cell
+		int r = resolution;
+		while(r > cellResolution && H3_GET_INDEX_DIGIT(index, r) == 6)
+		{
+			index = H3_SET_INDEX_DIGIT(index, r, 0);
+			r -= 1;
+		}
+		if(r == cellResolution)
+		{
+			++cell;
+			start();
+			return *this;
+		}
+		index = H3_SET_INDEX_DIGIT(index, r, H3_GET_INDEX_DIGIT(index, r) + 1);
+		
+		// NOTE: Descendants of a pentagon whose first non-zero digit is 1 (the K axis) do not exist
+		if(!pentagon)
+			return *this;
+		int leadingDigit = 0;
+		for(int d = 1; d <= resolution && leadingDigit == 0; ++d)
+			leadingDigit = H3_GET_INDEX_DIGIT(index, d);
+		if(leadingDigit != 1)
+			return *this;
+	}
+}
+
+
+template<typename It>
+void CompactCellSet::insert(It first, It last)
+{
+	for(; first != last; ++first)
+		insert(*first);
+}
+
+
+#endif //GIAGUI_COMPACTCELLSET_HPP
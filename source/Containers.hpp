@@ -2,8 +2,16 @@
 #define GIAGUI_CONTAINERS_HPP
 
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
 #include <unordered_set>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 
 template<typename V>
@@ -38,4 +46,487 @@ struct HashMap : public std::unordered_map<K, V>
 	}
 };
 
+
+// Open addressing hash map with linear probing, meant for integer keys such as H3Index
+// All entries live in a single array, so there is no per-entry allocation and iteration is a linear scan
+// NOTE: Key 0 marks an empty slot and cannot be inserted. This is fine for H3 indices because H3_INVALID_INDEX is 0
+// NOTE: Erasing shifts the following entries back (no tombstones), so it invalidates iterators
+template<typename K, typename V>
+struct FlatHashMap
+{
+	static_assert(std::is_integral<K>::value, "FlatHashMap keys must be integers");
+	
+	using value_type = std::pair<K, V>;
+	
+	static constexpr K EMPTY_KEY = 0;
+	
+	
+	template<typename Slot>
+	struct Iterator
+	{
+		Slot* slot;
+		Slot* last;
+		
+		inline Iterator(Slot* slot, Slot* last) : slot(slot), last(last) { skipEmpty(); }
+		inline void      skipEmpty()        { while(slot != last && slot->first == EMPTY_KEY) ++slot; }
+		inline Slot&     operator*() const  { return *slot; }
+		inline Slot*     operator->() const { return slot; }
+		inline Iterator& operator++()       { ++slot; skipEmpty(); return *this; }
+		inline bool operator==(const Iterator& that) const { return slot == that.slot; }
+		inline bool operator!=(const Iterator& that) const { return slot != that.slot; }
+	};
+	
+	using iterator       = Iterator<value_type>;
+	using const_iterator = Iterator<const value_type>;
+	
+	
+	std::vector<value_type> slots;
+	size_t                  used  = 0;
+	int                     shift = 64;
+	
+	
+	inline size_t size() const  { return used; }
+	inline bool   empty() const { return used == 0; }
+	
+	inline iterator       begin()       { return iterator(slots.data(), slots.data() + slots.size()); }
+	inline iterator       end()         { return iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+	inline const_iterator begin() const { return const_iterator(slots.data(), slots.data() + slots.size()); }
+	inline const_iterator end() const   { return const_iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+	
+	
+	inline void clear()
+	{
+		slots = std::vector<value_type>();
+		used  = 0;
+		shift = 64;
+	}
+	
+	
+	// Make room for `n` entries without rehashing
+	inline void reserve(size_t n)
+	{
+		// Keep load factor at most 3/4
+		size_t wanted = 8;
+		while(wanted - wanted/4 < n)
+			wanted *= 2;
+		if(wanted > slots.size())
+			rehash(wanted);
+	}
+	
+	
+	inline iterator find(K key)
+	{
+		size_t i = findSlot(key);
+		if(i == slots.size() || slots[i].first == EMPTY_KEY)
+			return end();
+		return iterator(slots.data() + i, slots.data() + slots.size());
+	}
+	
+	inline const_iterator find(K key) const
+	{
+		size_t i = findSlot(key);
+		if(i == slots.size() || slots[i].first == EMPTY_KEY)
+			return end();
+		return const_iterator(slots.data() + i, slots.data() + slots.size());
+	}
+	
+	inline size_t count(K key) const
+	{
+		return find(key) != end() ? 1 : 0;
+	}
+	
+	
+	inline V* get(K key)
+	{
+		auto it = find(key);
+		if(it != end())
+			return &it->second;
+		return nullptr;
+	}
+	
+	inline const V* get(K key) const
+	{
+		auto it = find(key);
+		if(it != end())
+			return &it->second;
+		return nullptr;
+	}
+	
+	inline const V& get_or(K key, const V& fallback) const
+	{
+		auto it = find(key);
+		if(it != end())
+			return it->second;
+		return fallback;
+	}
+	
+	
+	// Same semantics as std::unordered_map::insert, an existing entry is not overwritten
+	inline std::pair<iterator, bool> insert(const value_type& entry)
+	{
+		assert(entry.first != EMPTY_KEY);
+		if(used + 1 > slots.size() - slots.size()/4)
+			reserve(used + 1);
+		
+		size_t i = findSlot(entry.first);
+		bool created = slots[i].first == EMPTY_KEY;
+		if(created)
+		{
+			slots[i] = entry;
+			used += 1;
+		}
+		return {iterator(slots.data() + i, slots.data() + slots.size()), created};
+	}
+	
+	
+	inline V& operator[](K key)
+	{
+		auto [iter, created] = insert({key, V{}});
+		return iter->second;
+	}
+	
+	
+	// Moves all entries out of the map in no particular order, leaving the map empty
+	// NOTE: The slot array is reused as the result, so this does not need any additional memory
+	inline std::vector<value_type> takeEntries()
+	{
+		std::vector<value_type> result = std::move(slots);
+		result.erase(std::remove_if(result.begin(), result.end(), [](const value_type& slot){ return slot.first == EMPTY_KEY; }), result.end());
+		clear();
+		return result;
+	}
+	
+	
+	inline size_t erase(K key)
+	{
+		size_t i = findSlot(key);
+		if(i == slots.size() || slots[i].first == EMPTY_KEY)
+			return 0;
+		
+		// Pull back the entries that follow in the probe sequence, so that lookups never stop at the hole
+		size_t mask = slots.size() - 1;
+		size_t j    = i;
+		for(;;)
+		{
+			j = (j + 1) & mask;
+			if(slots[j].first == EMPTY_KEY)
+				break;
+			
+			// The entry in `j` can move into the hole only if its home slot is not cyclically inside (i, j]
+			size_t home = homeSlot(slots[j].first);
+			bool   stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+			if(!stays)
+			{
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+		slots[i].first = EMPTY_KEY;
+		used -= 1;
+		return 1;
+	}
+	
+	
+protected:
+	inline size_t homeSlot(K key) const
+	{
+		// Fibonacci hashing. H3 indices differ mostly in their middle bits and multiplying spreads them into the top bits
+		return size_t((uint64_t(key) * UINT64_C(0x9E3779B97F4A7C15)) >> shift);
+	}
+	
+	
+	// Returns the slot holding `key`, or the empty slot where it would go, or slots.size() if there are no slots at all
+	inline size_t findSlot(K key) const
+	{
+		if(slots.empty())
+			return 0;
+		
+		size_t mask = slots.size() - 1;
+		size_t i    = homeSlot(key);
+		while(slots[i].first != EMPTY_KEY && slots[i].first != key)
+			i = (i + 1) & mask;
+		return i;
+	}
+	
+	
+	inline void rehash(size_t newCapacity)
+	{
+		assert((newCapacity & (newCapacity-1)) == 0);
+		
+		std::vector<value_type> oldSlots(newCapacity, value_type{EMPTY_KEY, V{}});
+		oldSlots.swap(slots);
+		
+		shift = 64;
+		for(size_t c = newCapacity; c > 1; c >>= 1)
+			shift -= 1;
+		
+		for(const value_type& entry : oldSlots)
+		{
+			if(entry.first != EMPTY_KEY)
+				slots[findSlot(entry.first)] = entry;
+		}
+	}
+};
+
+
+// Returns the position of `key` in the sorted array `keys`, or SIZE_MAX
+template<typename K>
+inline size_t sortedArrayIndexOf(const K* keys, size_t count, K key)
+{
+	size_t lo = 0;
+	size_t hi = count;
+	
+	// Keys of a dataset are roughly uniformly distributed, so a few interpolation steps narrow the range much
+	// faster than bisecting. Finish with a binary search to bound the worst case
+	for(int step = 0; step < 3 && hi - lo > 16; ++step)
+	{
+		K loKey = keys[lo];
+		K hiKey = keys[hi-1];
+		if(key < loKey || key > hiKey)
+			return SIZE_MAX;
+		if(loKey == hiKey)
+			break;
+		
+		double t     = double(key - loKey) / double(hiKey - loKey);
+		size_t guess = lo + size_t(t * double(hi - 1 - lo));
+		if(keys[guess] == key)
+			return guess;
+		if(keys[guess] < key)
+			lo = guess + 1;
+		else
+			hi = guess;
+	}
+	
+	const K* it = std::lower_bound(keys + lo, keys + hi, key);
+	if(it != keys + hi && *it == key)
+		return it - keys;
+	return SIZE_MAX;
+}
+
+
+// Non-owning view of a SortedArrayMap, or of sorted arrays that live somewhere else (e.g. a memory-mapped file)
+// `owner` keeps that memory alive for as long as any copy of the view exists, it is null when the view only borrows
+template<typename K, typename V>
+struct SortedArrayView
+{
+	static constexpr size_t NOT_FOUND = SIZE_MAX;
+	
+	const K*                    keys   = nullptr;
+	const V*                    values = nullptr;
+	size_t                      count  = 0;
+	std::shared_ptr<const void> owner;
+	
+	
+	inline size_t size() const  { return count; }
+	inline bool   empty() const { return count == 0; }
+	
+	
+	inline void clear()
+	{
+		*this = SortedArrayView();
+	}
+	
+	
+	inline size_t indexOf(K key) const
+	{
+		return sortedArrayIndexOf(keys, count, key);
+	}
+	
+	
+	inline const V* get(K key) const
+	{
+		size_t i = indexOf(key);
+		if(i != NOT_FOUND)
+			return &values[i];
+		return nullptr;
+	}
+};
+
+
+// Read-only map stored as two parallel arrays of keys and values (structure of arrays), sorted by key
+// Lookups are O(log n), iteration is a linear scan in key order and there is no memory overhead per entry
+// Values can be modified in place, but adding or removing entries requires rebuilding the arrays
+template<typename K, typename V>
+struct SortedArrayMap
+{
+	static_assert(std::is_integral<K>::value, "SortedArrayMap keys must be integers");
+	
+	static constexpr size_t NOT_FOUND = SIZE_MAX;
+	
+	std::vector<K> keys;
+	std::vector<V> values;
+	
+	
+	inline size_t size() const  { return keys.size(); }
+	inline bool   empty() const { return keys.empty(); }
+	
+	
+	inline void clear()
+	{
+		keys   = std::vector<K>();
+		values = std::vector<V>();
+	}
+	
+	
+	// Takes entries in any order. Keys must be unique
+	inline void assign(std::vector<std::pair<K, V>>&& entries)
+	{
+		std::sort(entries.begin(), entries.end(), [](const std::pair<K, V>& a, const std::pair<K, V>& b){ return a.first < b.first; });
+		
+		clear();
+		keys.reserve(entries.size());
+		values.reserve(entries.size());
+		for(const std::pair<K, V>& entry : entries)
+		{
+			keys.push_back(entry.first);
+			values.push_back(entry.second);
+		}
+		entries = std::vector<std::pair<K, V>>();
+	}
+	
+	
+	// Returns the position of `key` in the arrays, or NOT_FOUND
+	inline size_t indexOf(K key) const
+	{
+		return sortedArrayIndexOf(keys.data(), keys.size(), key);
+	}
+	
+	
+	inline V* get(K key)
+	{
+		size_t i = indexOf(key);
+		if(i != NOT_FOUND)
+			return &values[i];
+		return nullptr;
+	}
+	
+	inline const V* get(K key) const
+	{
+		size_t i = indexOf(key);
+		if(i != NOT_FOUND)
+			return &values[i];
+		return nullptr;
+	}
+	
+	inline const V& get_or(K key, const V& fallback) const
+	{
+		size_t i = indexOf(key);
+		if(i != NOT_FOUND)
+			return values[i];
+		return fallback;
+	}
+	
+	
+	// The view is only valid until the map is modified
+	inline SortedArrayView<K, V> view() const
+	{
+		SortedArrayView<K, V> result;
+		result.keys   = keys.data();
+		result.values = values.data();
+		result.count  = keys.size();
+		return result;
+	}
+};
+
+
+// Array with an entry for each possible key in [0, slotCount), plus a bitmap telling which entries are present
+// Meant for maps that cover most of their key space, where storing the keys would be pure overhead
+template<typename V>
+struct DenseArrayMap
+{
+	std::vector<V>        values;
+	std::vector<uint64_t> presence;
+	size_t                used = 0;
+	
+	
+	inline size_t size() const      { return used; }
+	inline bool   empty() const     { return used == 0; }
+	inline size_t slotCount() const { return values.size(); }
+	
+	
+	inline void clear()
+	{
+		values   = std::vector<V>();
+		presence = std::vector<uint64_t>();
+		used     = 0;
+	}
+	
+	
+	// Discards all entries and makes room for `slotCount` slots
+	inline void resize(size_t slotCount)
+	{
+		clear();
+		values.resize(slotCount, V{});
+		presence.resize((slotCount + 63) / 64, 0);
+	}
+	
+	
+	inline bool contains(size_t slot) const
+	{
+		assert(slot < values.size());
+		return (presence[slot / 64] >> (slot % 64)) & 1;
+	}
+	
+	inline V* get(size_t slot)
+	{
+		return contains(slot) ? &values[slot] : nullptr;
+	}
+	
+	inline const V* get(size_t slot) const
+	{
+		return contains(slot) ? &values[slot] : nullptr;
+	}
+	
+	
+	// Returns true if the slot was empty
+	inline bool set(size_t slot, const V& value)
+	{
+		bool created = setUncounted(slot, value);
+		used += created ? 1 : 0;
+		return created;
+	}
+	
+	
+	inline size_t erase(size_t slot)
+	{
+		size_t erasedCount = eraseUncounted(slot);
+		used -= erasedCount;
+		return erasedCount;
+	}
+	
+	
+	// Same as set() and erase(), but `used` is left to the caller. Threads whose slots share no presence word (64 slots
+	// each) can call these together, then the caller adds up what they return, see Dataset::updateGeoValues()
+	inline bool setUncounted(size_t slot, const V& value)
+	{
+		bool created = !contains(slot);
+		presence[slot / 64] |= uint64_t(1) << (slot % 64);
+		values[slot] = value;
+		return created;
+	}
+	
+	inline size_t eraseUncounted(size_t slot)
+	{
+		if(!contains(slot))
+			return 0;
+		presence[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+		return 1;
+	}
+	
+	
+	// Calls `f(size_t slot, const V& value)` for each present entry, in slot order
+	template<typename F>
+	inline void forEach(F&& f) const
+	{
+		for(size_t w = 0; w < presence.size(); ++w)
+		{
+			for(uint64_t bits = presence[w]; bits != 0; bits &= bits - 1)
+			{
+				size_t slot = w * 64 + __builtin_ctzll(bits);
+				f(slot, values[slot]);
+			}
+		}
+	}
+};
+
 #endif //GIAGUI_CONTAINERS_HPP
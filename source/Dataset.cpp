@@ -1,35 +1,411 @@
 #include "Dataset.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <mutex>
 #include <utility>
+#include <vector>
 #include "MapUtils.hpp"
+#include "Parallel.hpp"
+
+
+static constexpr size_t BULK_EDIT_RANGE_SIZE = 1 << 16; // Cells per task of a bulk edit, smaller batches run on the calling thread
+
+
+inline double divideRounded(double sum, int64_t count)
+{
+	return sum / double(count);
+}
+
+
+// Integer division rounded to the nearest, halves away from zero
+inline int64_t divideRounded(int64_t sum, int64_t count)
+{
+	assert(count > 0);
+	int64_t quotient  = sum / count;
+	int64_t remainder = sum % count;
+	if(2 * std::abs(remainder) >= count)
+		quotient += sum < 0 ? -1 : 1;
+	return quotient;
+}
+
+
+inline double roundToType(double value, double*)
+{
+	return value;
+}
+
+
+inline int64_t roundToType(double value, int64_t*)
+{
+	return std::llround(value);
+}
+
+
+// Aggregation policies for CoarseningKernel, one for each Dataset::Aggregation
+// add() is called for each child that has a value, finish() returns the value of their parent and resets the policy
+template<typename T>
+struct MeanAggregation
+{
+	T       sum   = 0;
+	int64_t count = 0;
+	
+	MeanAggregation(const Dataset* dataset, T defaultValue, int childResolution) {}
+	
+	inline void add(H3Index childIndex, T value)
+	{
+		sum   += value;
+		count += 1;
+	}
+	
+	inline T finish(H3Index parentIndex)
+	{
+		T result = divideRounded(sum, count);
+		sum   = 0;
+		count = 0;
+		return result;
+	}
+};
+
+
+template<typename T>
+struct MeanWithDefaultAggregation
+{
+	T       defaultValue;
+	int     childResolution;
+	T       sum   = 0;
+	int64_t count = 0;
+	
+	MeanWithDefaultAggregation(const Dataset* dataset, T defaultValue, int childResolution) :
+		defaultValue(defaultValue),
+		childResolution(childResolution)
+	{}
+	
+	inline void add(H3Index childIndex, T value)
+	{
+		sum   += value;
+		count += 1;
+	}
+	
+	inline T finish(H3Index parentIndex)
+	{
+		int64_t childrenCount = (int64_t)h3ChildrenCount(parentIndex, childResolution);
+		assert(count <= childrenCount);
+		T result = divideRounded(sum + T(childrenCount - count) * defaultValue, childrenCount);
+		sum   = 0;
+		count = 0;
+		return result;
+	}
+};
+
+
+// Sum of value * area of the children over the area of the children
+// NOTE: Cell areas change across the globe, so a value that is a density integrates to the same total before and after
+// NOTE: Children do not tile their parent exactly, so its own area would skew even a constant field. Missing children
+// count as 0 over the mean area of the present ones, their own areas would take visiting all of them
+template<typename T>
+struct AreaWeightedMeanAggregation
+{
+	int     childResolution;
+	double  sum   = 0;
+	double  area  = 0;
+	int64_t count = 0;
+	
+	AreaWeightedMeanAggregation(const Dataset* dataset, T defaultValue, int childResolution) :
+		childResolution(childResolution)
+	{}
+	
+	inline void add(H3Index childIndex, T value)
+	{
+		double childArea = h3CellArea(childIndex);
+		sum   += double(value) * childArea;
+		area  += childArea;
+		count += 1;
+	}
+	
+	inline T finish(H3Index parentIndex)
+	{
+		int64_t childrenCount = (int64_t)h3ChildrenCount(parentIndex, childResolution);
+		assert(count > 0 && count <= childrenCount);
+		T result = roundToType(sum / area * double(count) / double(childrenCount), (T*)nullptr);
+		sum   = 0;
+		area  = 0;
+		count = 0;
+		return result;
+	}
+};
+
+
+template<typename T>
+struct MinAggregation
+{
+	T    min;
+	bool empty = true;
+	
+	MinAggregation(const Dataset* dataset, T defaultValue, int childResolution) {}
+	
+	inline void add(H3Index childIndex, T value)
+	{
+		if(empty || value < min)
+			min = value;
+		empty = false;
+	}
+	
+	inline T finish(H3Index parentIndex)
+	{
+		assert(!empty);
+		empty = true;
+		return min;
+	}
+};
+
+
+template<typename T>
+struct MaxAggregation
+{
+	T    max;
+	bool empty = true;
+	
+	MaxAggregation(const Dataset* dataset, T defaultValue, int childResolution) {}
+	
+	inline void add(H3Index childIndex, T value)
+	{
+		if(empty || value > max)
+			max = value;
+		empty = false;
+	}
+	
+	inline T finish(H3Index parentIndex)
+	{
+		assert(!empty);
+		empty = true;
+		return max;
+	}
+};
+
+
+// NOTE: The buffer is reused across parents, so this allocates only while it grows to the largest family
+template<typename T>
+struct ModeAggregation
+{
+	std::vector<T> values;
+	
+	ModeAggregation(const Dataset* dataset, T defaultValue, int childResolution) {}
+	
+	inline void add(H3Index childIndex, T value)
+	{
+		values.push_back(value);
+	}
+	
+	inline T finish(H3Index parentIndex)
+	{
+		assert(!values.empty());
+		std::sort(values.begin(), values.end());
+		
+		T      mode      = values[0];
+		size_t modeCount = 0;
+		for(size_t begin = 0, end = 0; begin < values.size(); begin = end)
+		{
+			while(end < values.size() && values[end] == values[begin])
+				end += 1;
+			if(end - begin > modeCount)
+			{
+				mode      = values[begin];
+				modeCount = end - begin;
+			}
+		}
+		values.clear();
+		return mode;
+	}
+};
+
+
+// Combines the values of each run of children that share a parent, writing one value per parent
+// Children must be pushed in index order, which makes the children of a parent contiguous, so no map is needed
+template<typename T, T GeoValue::* field, template<typename> class Policy>
+struct CoarseningKernel
+{
+	SortedArrayMap<H3Index, GeoValue>* output;
+	int       parentResolution;
+	H3Index   parentIndex = H3_INVALID_INDEX;
+	Policy<T> policy;
+	
+	
+	CoarseningKernel(const Dataset* dataset, SortedArrayMap<H3Index, GeoValue>* output, int parentResolution) :
+		output(output),
+		parentResolution(parentResolution),
+		policy(dataset, dataset->defaultValue.*field, dataset->resolution)
+	{}
+	
+	inline void push(H3Index childIndex, GeoValue childGeoValue)
+	{
+		H3Index index = h3ToParent(childIndex, parentResolution);
+		assert(index != H3_INVALID_INDEX);
+		assert(index >= parentIndex || parentIndex == H3_INVALID_INDEX);
+		if(index != parentIndex)
+		{
+			flush();
+			parentIndex = index;
+		}
+		policy.add(childIndex, childGeoValue.*field);
+	}
+	
+	inline void flush()
+	{
+		if(parentIndex == H3_INVALID_INDEX)
+			return;
+		
+		GeoValue parentGeoValue;
+		parentGeoValue.*field = policy.finish(parentIndex);
+		output->keys.push_back(parentIndex);
+		output->values.push_back(parentGeoValue);
+		parentIndex = H3_INVALID_INDEX;
+	}
+};
+
+
+// Coarsens `children` if given, which must be sorted, or else all the values of the dataset
+template<typename Kernel>
+static void runCoarseningKernel(const Dataset* dataset, int newResolution, const SortedArrayView<H3Index, GeoValue>* children, SortedArrayMap<H3Index, GeoValue>* output, const Dataset::ProgressCallback& progress)
+{
+	Kernel kernel(dataset, output, newResolution);
+	
+	if(children)
+	{
+		for(size_t i = 0; i < children->size(); ++i)
+			kernel.push(children->keys[i], children->values[i]);
+		kernel.flush();
+		return;
+	}
+	
+	size_t childrenCount = dataset->geoValueCount();
+	size_t childrenDone  = 0;
+	auto push = [&](H3Index childIndex, GeoValue childGeoValue)
+	{
+		kernel.push(childIndex, childGeoValue);
+		
+		childrenDone += 1;
+		if(progress && childrenDone % (1 << 20) == 0)
+			progress(double(childrenDone) / double(childrenCount));
+	};
+	
+	// NOTE: Frozen and dense storage already iterate in index order, only the hash map needs a sorted copy
+	if(dataset->storage == Dataset::Storage::Sparse)
+	{
+		SortedArrayMap<H3Index, GeoValue> buffer;
+		dataset->sortedGeoValues(&buffer);
+		for(size_t i = 0; i < buffer.size(); ++i)
+			push(buffer.keys[i], buffer.values[i]);
+	}
+	else
+	{
+		dataset->forEachGeoValue(push);
+	}
+	kernel.flush();
+}
+
+
+// Instantiates the kernel for each policy, so the per-value loop has no runtime switch
+template<typename T, T GeoValue::* field>
+static void coarsenGeoValues(const Dataset* dataset, int newResolution, const SortedArrayView<H3Index, GeoValue>* children, SortedArrayMap<H3Index, GeoValue>* output, const Dataset::ProgressCallback& progress)
+{
+	switch(dataset->aggregation)
+	{
+		case Dataset::Aggregation::Mean:
+			runCoarseningKernel<CoarseningKernel<T, field, MeanAggregation>>(dataset, newResolution, children, output, progress);
+			break;
+		case Dataset::Aggregation::MeanWithDefault:
+			runCoarseningKernel<CoarseningKernel<T, field, MeanWithDefaultAggregation>>(dataset, newResolution, children, output, progress);
+			break;
+		case Dataset::Aggregation::AreaWeightedMean:
+			runCoarseningKernel<CoarseningKernel<T, field, AreaWeightedMeanAggregation>>(dataset, newResolution, children, output, progress);
+			break;
+		case Dataset::Aggregation::Min:
+			runCoarseningKernel<CoarseningKernel<T, field, MinAggregation>>(dataset, newResolution, children, output, progress);
+			break;
+		case Dataset::Aggregation::Max:
+			runCoarseningKernel<CoarseningKernel<T, field, MaxAggregation>>(dataset, newResolution, children, output, progress);
+			break;
+		case Dataset::Aggregation::Mode:
+			runCoarseningKernel<CoarseningKernel<T, field, ModeAggregation>>(dataset, newResolution, children, output, progress);
+			break;
+	}
+}
 
 
 Dataset::Dataset() :
 	id(""),
+	storage(Storage::Sparse),
 	resolution(0),
+	aggregation(Aggregation::Mean),
 	defaultValue{0},
 	density(NO_DENSITY),
 	isInteger(false),
 	measureUnit(""),
 	minValue{0},
-	maxValue{0}
+	maxValue{0},
+	denseRejected(false),
+	indicesUnchecked(false)
 {}
 
 
 Dataset::Dataset(DatasetID_t id, bool hasDensity, bool isInteger) :
 	id(std::move(id)),
+	storage(Storage::Sparse),
 	resolution(0),
+	aggregation(Aggregation::Mean),
 	defaultValue{0},
 	density(hasDensity ? 0.0 : NO_DENSITY),
 	isInteger(isInteger),
 	measureUnit(""),
 	minValue{0},
-	maxValue{0}
+	maxValue{0},
+	denseRejected(false),
+	indicesUnchecked(false)
 {}
 
 
+// Names used in dataset files
+const char* Dataset::aggregationName(Aggregation aggregation)
+{
+	switch(aggregation)
+	{
+		case Aggregation::Mean:             return "mean";
+		case Aggregation::MeanWithDefault:  return "mean_with_default";
+		case Aggregation::AreaWeightedMean: return "area_weighted_mean";
+		case Aggregation::Min:              return "min";
+		case Aggregation::Max:              return "max";
+		case Aggregation::Mode:             return "mode";
+	}
+	assert(false);
+	return "mean";
+}
+
+
+bool Dataset::aggregationFromName(const std::string& name, Aggregation* outAggregation)
+{
+	for(Aggregation aggregation : {Aggregation::Mean, Aggregation::MeanWithDefault, Aggregation::AreaWeightedMean,
+	                               Aggregation::Min,  Aggregation::Max,             Aggregation::Mode})
+	{
+		if(name == aggregationName(aggregation))
+		{
+			*outAggregation = aggregation;
+			return true;
+		}
+	}
+	
+	// NOTE: Files written before the rename call the area weighted mean a sum
+	if(name == "area_weighted_sum")
+	{
+		*outAggregation = Aggregation::AreaWeightedMean;
+		return true;
+	}
+	return false;
+}
+
+
 bool Dataset::geoValuesAreEqual(GeoValue a, GeoValue b)
 {
 	bool result;
@@ -48,118 +424,494 @@ bool Dataset::hasDensity()
 }
 
 
-void Dataset::increaseResolution(int newResolution)
+void Dataset::increaseResolution(int newResolution, const ProgressCallback& progress)
 {
-	assert(IS_VALID_RESOLUTION(newResolution));
-	assert(newResolution > resolution);
+	replaceGeoValues(newResolution, childGeoValues(newResolution, progress));
+}
+
+
+void Dataset::decreaseResolution(int newResolution, const ProgressCallback& progress)
+{
+	replaceGeoValues(newResolution, parentGeoValues(newResolution, progress));
+}
+
+
+bool Dataset::findGeoValue(H3Index index, GeoValue* outValue)
+{
+	assert(index != H3_INVALID_INDEX);
+	assert(outValue);
 	
-	uint64_t childrenBufferLength = h3MaxChildrenCount(resolution, newResolution);
-	H3Index* childrenBuffer       = new H3Index[childrenBufferLength];
+	if(storage == Storage::Frozen || storage == Storage::Mapped)
+	{
+		const GeoValue* value = storage == Storage::Frozen ? frozenGeoValues.get(index) : mappedGeoValues.get(index);
+		if(value)
+		{
+			*outValue = *value;
+			return true;
+		}
+		return false;
+	}
 	
-	HashMap<H3Index, GeoValue> childrenGeoValues;
-	for(auto& [parentIndex, parentGeoValue] : geoValues)
+	if(storage == Storage::Dense)
 	{
-		h3ToChildren(parentIndex, newResolution, childrenBuffer);
-		
-		for(uint64_t i = 0; i < childrenBufferLength; ++i)
+		if(!h3HasDenseSlot(index, resolution))
+			return false;
+		const GeoValue* value = denseGeoValues.get(h3ToDenseSlot(index, resolution));
+		if(value)
 		{
-			H3Index childIndex = childrenBuffer[i];
-			childrenGeoValues[childIndex] = parentGeoValue;
+			*outValue = *value;
+			return true;
 		}
+		return false;
 	}
-	childrenGeoValues.erase(H3_INVALID_INDEX);
 	
-	geoValues  = std::move(childrenGeoValues);
-	resolution = newResolution;
-	delete[] childrenBuffer;
+	auto it = geoValues.find(index);
+	if(it != geoValues.end())
+	{
+		*outValue = it->second;
+		return true;
+	}
+	return false;
 }
 
 
-void Dataset::decreaseResolution(int newResolution)
+size_t Dataset::removeGeoValue(H3Index index)
 {
-	assert(IS_VALID_RESOLUTION(newResolution));
-	assert(newResolution < resolution);
+	size_t affectedCount = eraseGeoValue(index);
+	if(affectedCount > 0)
+		markLodStale(index);
+	return affectedCount;
+}
+
+
+size_t Dataset::updateGeoValue(H3Index index, GeoValue newValue)
+{
+	size_t affectedCount = storeGeoValue(index, newValue);
+	if(affectedCount > 0)
+		markLodStale(index);
+	return affectedCount;
+}
+
+
+// Runs `f(size_t begin, size_t end)` on the thread pool over ranges of `slots`, which must be sorted
+// Ranges never split a presence word of a DenseArrayMap between them, so threads can set and erase slots without locking
+template<typename F>
+static void parallelForDenseSlots(const std::vector<uint64_t>& slots, F&& f)
+{
+	auto wordStart = [&slots](size_t i)
+	{
+		while(i > 0 && i < slots.size() && slots[i] / 64 == slots[i - 1] / 64)
+			i += 1;
+		return i;
+	};
 	
-	HashMap<H3Index, int>    childrenCount;
-	HashMap<H3Index, GeoValue> newGeoValues;
-	if(isInteger)
+	parallelFor(slots.size(), BULK_EDIT_RANGE_SIZE, [&](size_t begin, size_t end)
 	{
-		for(auto [childIndex, childGeoValue] : geoValues)
-		{
-			H3Index   parentIndex    = h3ToParent(childIndex, newResolution);
-			GeoValue& parentGeoValue = newGeoValues[parentIndex];
-			parentGeoValue.integer += childGeoValue.integer;
-			childrenCount[parentIndex] += 1;
-		}
-		
-		for(auto& [parentIndex, parentGeoValue] : newGeoValues)
+		begin = wordStart(begin);
+		end   = wordStart(end);
+		if(begin < end)
+			f(begin, end);
+	});
+}
+
+
+size_t Dataset::removeGeoValues(const H3Index* indices, size_t count)
+{
+	if(count < BULK_EDIT_MIN_CELLS)
+	{
+		size_t affectedCount = 0;
+		for(size_t i = 0; i < count; ++i)
+			affectedCount += removeGeoValue(indices[i]);
+		return affectedCount;
+	}
+	
+	size_t               affectedCount = 0;
+	std::vector<H3Index> sortedIndices;
+	if(storage == Storage::Sparse)
+	{
+		for(size_t i = 0; i < count; ++i)
 		{
-			assert(childrenCount.count(parentIndex) > 0);
-			assert(childrenCount[parentIndex] > 0);
-			parentGeoValue.integer = parentGeoValue.integer / childrenCount[parentIndex];
+			const GeoValue* value = geoValues.get(indices[i]);
+			if(!value)
+				continue;
+			stats.remove(geoValueToDouble(*value));
+			affectedCount += geoValues.erase(indices[i]);
 		}
 	}
 	else
 	{
-		for(auto [childIndex, childGeoValue] : geoValues)
+		sortedIndices.assign(indices, indices + count);
+		std::sort(sortedIndices.begin(), sortedIndices.end());
+		
+		if(storage == Storage::Mapped)
 		{
-			H3Index   parentIndex    = h3ToParent(childIndex, newResolution);
-			GeoValue& parentGeoValue = newGeoValues[parentIndex];
-			parentGeoValue.real += childGeoValue.real;
-			childrenCount[parentIndex] += 1;
+			// Removing values that are not there is not an edit, do not pay for a copy of the file
+			std::atomic<size_t> foundCount(0);
+			parallelFor(count, BULK_EDIT_RANGE_SIZE, [&](size_t begin, size_t end)
+			{
+				size_t found = 0;
+				for(size_t i = begin; i < end; ++i)
+					found += mappedGeoValues.indexOf(sortedIndices[i]) != mappedGeoValues.NOT_FOUND ? 1 : 0;
+				foundCount += found;
+			});
+			if(foundCount == 0)
+				return 0;
+			unmap();
 		}
 		
-		for(auto& [parentIndex, parentGeoValue] : newGeoValues)
+		if(storage == Storage::Frozen)
+		{
+			// Both sides are sorted, so the kept values are moved down in a single merge-like pass
+			std::vector<H3Index>&  keys   = frozenGeoValues.keys;
+			std::vector<GeoValue>& values = frozenGeoValues.values;
+			size_t keptCount = 0;
+			size_t removal   = 0;
+			for(size_t i = 0; i < keys.size(); ++i)
+			{
+				while(removal < count && sortedIndices[removal] < keys[i])
+					removal += 1;
+				if(removal < count && sortedIndices[removal] == keys[i])
+				{
+					stats.remove(geoValueToDouble(values[i]));
+					continue;
+				}
+				
+				keys[keptCount]   = keys[i];
+				values[keptCount] = values[i];
+				keptCount += 1;
+			}
+			affectedCount = keys.size() - keptCount;
+			keys.resize(keptCount);
+			values.resize(keptCount);
+		}
+		else
 		{
-			assert(childrenCount.count(parentIndex) > 0);
-			assert(childrenCount[parentIndex] > 0);
-			parentGeoValue.real = parentGeoValue.real / childrenCount[parentIndex];
+			assert(storage == Storage::Dense);
+			
+			// NOTE: Dense slots are in the same order as the indices. Indices without a slot have no value to remove
+			std::vector<uint64_t> slots;
+			slots.reserve(count);
+			for(size_t i = 0; i < count; ++i)
+				if(h3HasDenseSlot(sortedIndices[i], resolution))
+					slots.push_back(h3ToDenseSlot(sortedIndices[i], resolution));
+			
+			// NOTE: Ranges merge into `stats` while others start, and stats.remove() may reset it, so they read a copy of the bins
+			double histogramMin = stats.histogramMin;
+			double histogramMax = stats.histogramMax;
+			
+			std::atomic<size_t> erasedCount(0);
+			std::mutex          statsMutex;
+			parallelForDenseSlots(slots, [&](size_t begin, size_t end)
+			{
+				Statistics erased;
+				erased.reset(histogramMin, histogramMax);
+				for(size_t i = begin; i < end; ++i)
+				{
+					const GeoValue* value = denseGeoValues.get(slots[i]);
+					if(!value)
+						continue;
+					erased.add(geoValueToDouble(*value));
+					denseGeoValues.eraseUncounted(slots[i]);
+				}
+				erasedCount += erased.count;
+				
+				std::lock_guard<std::mutex> lock(statsMutex);
+				stats.remove(erased);
+			});
+			affectedCount = erasedCount;
+			denseGeoValues.used -= affectedCount;
+			
+			if(fillRatio() <= SPARSE_MAX_FILL_RATIO)
+				thaw();
 		}
 	}
 	
-	geoValues  = std::move(newGeoValues);
-	resolution = newResolution;
+	if(affectedCount > 0)
+		markLodStale(sortedIndices.empty() ? indices : sortedIndices.data(), count);
+	return affectedCount;
 }
 
 
-bool Dataset::findGeoValue(H3Index index, GeoValue* outValue)
+size_t Dataset::updateGeoValues(const H3Index* indices, size_t count, GeoValue newValue)
 {
-	assert(index != H3_INVALID_INDEX);
-	assert(outValue);
+	assert(isInteger || std::isfinite(newValue.real));
 	
-	auto it = geoValues.find(index);
-	if(it != geoValues.end())
+	if(count < BULK_EDIT_MIN_CELLS)
 	{
-		*outValue = it->second;
-		return true;
+		size_t affectedCount = 0;
+		for(size_t i = 0; i < count; ++i)
+			affectedCount += updateGeoValue(indices[i], newValue);
+		return affectedCount;
 	}
-	return false;
+	
+	// Values without a dense slot can only be kept in the other storages
+	if(storage == Storage::Dense && !std::all_of(indices, indices + count, [this](H3Index index){ return h3HasDenseSlot(index, resolution); }))
+	{
+		thaw();
+		denseRejected = true;
+	}
+	
+	size_t               affectedCount = 0;
+	std::vector<H3Index> sortedIndices;
+	if(storage == Storage::Sparse)
+	{
+		// NOTE: insert() leaves an existing value alone and tells where it is, so each cell takes a single probe
+		geoValues.reserve(geoValues.size() + count);
+		for(size_t i = 0; i < count; ++i)
+		{
+			assert(indices[i] != H3_INVALID_INDEX);
+			auto [iter, created] = geoValues.insert({indices[i], newValue});
+			if(!created && geoValuesAreEqual(iter->second, newValue))
+				continue;
+			updateStatistics(created ? nullptr : &iter->second, &newValue);
+			iter->second = newValue;
+			affectedCount += 1;
+		}
+		
+		if(fillRatio() >= DENSE_MIN_FILL_RATIO)
+			makeDense();
+	}
+	else
+	{
+		sortedIndices.assign(indices, indices + count);
+		std::sort(sortedIndices.begin(), sortedIndices.end());
+		
+		if(storage == Storage::Mapped)
+		{
+			// Values that are already there are not an edit, do not pay for a copy of the file
+			std::atomic<size_t> changedCount(0);
+			parallelFor(count, BULK_EDIT_RANGE_SIZE, [&](size_t begin, size_t end)
+			{
+				size_t changed = 0;
+				for(size_t i = begin; i < end; ++i)
+				{
+					const GeoValue* value = mappedGeoValues.get(sortedIndices[i]);
+					changed += !value || !geoValuesAreEqual(*value, newValue) ? 1 : 0;
+				}
+				changedCount += changed;
+			});
+			if(changedCount == 0)
+				return 0;
+			unmap();
+		}
+		
+		if(storage == Storage::Frozen)
+		{
+			// Existing values are overwritten in place, which keeps the arrays sorted. New ones are merged in afterwards
+			std::vector<uint8_t> isNew(count, 0);
+			std::atomic<size_t>  newCount(0);
+			std::mutex           statsMutex;
+			double               histogramMin = stats.histogramMin; // See removeGeoValues()
+			double               histogramMax = stats.histogramMax;
+			parallelFor(count, BULK_EDIT_RANGE_SIZE, [&](size_t begin, size_t end)
+			{
+				Statistics overwritten;
+				overwritten.reset(histogramMin, histogramMax);
+				size_t created = 0;
+				for(size_t i = begin; i < end; ++i)
+				{
+					GeoValue* value = frozenGeoValues.get(sortedIndices[i]);
+					if(!value)
+					{
+						isNew[i] = 1;
+						created += 1;
+					}
+					else
+					if(!geoValuesAreEqual(*value, newValue))
+					{
+						overwritten.add(geoValueToDouble(*value));
+						*value = newValue;
+					}
+				}
+				newCount += created;
+				
+				std::lock_guard<std::mutex> lock(statsMutex);
+				stats.remove(overwritten);
+				affectedCount += overwritten.count;
+			});
+			affectedCount += newCount;
+			stats.add(geoValueToDouble(newValue), affectedCount);
+			
+			if(newCount > 0)
+			{
+				SortedArrayMap<H3Index, GeoValue> merged;
+				merged.keys.reserve(frozenGeoValues.size() + newCount);
+				merged.values.reserve(frozenGeoValues.size() + newCount);
+				size_t old = 0;
+				for(size_t i = 0; i < count; ++i)
+				{
+					if(!isNew[i])
+						continue;
+					for(; old < frozenGeoValues.size() && frozenGeoValues.keys[old] < sortedIndices[i]; ++old)
+					{
+						merged.keys.push_back(frozenGeoValues.keys[old]);
+						merged.values.push_back(frozenGeoValues.values[old]);
+					}
+					merged.keys.push_back(sortedIndices[i]);
+					merged.values.push_back(newValue);
+				}
+				for(; old < frozenGeoValues.size(); ++old)
+				{
+					merged.keys.push_back(frozenGeoValues.keys[old]);
+					merged.values.push_back(frozenGeoValues.values[old]);
+				}
+				frozenGeoValues = std::move(merged);
+				
+				if(fillRatio() >= DENSE_MIN_FILL_RATIO)
+					makeDense();
+			}
+		}
+		else
+		{
+			assert(storage == Storage::Dense);
+			
+			// NOTE: Dense slots are in the same order as the indices
+			std::vector<uint64_t> slots(count);
+			for(size_t i = 0; i < count; ++i)
+				slots[i] = h3ToDenseSlot(sortedIndices[i], resolution);
+			
+			std::atomic<size_t> changedCount(0);
+			std::atomic<size_t> createdCount(0);
+			std::mutex          statsMutex;
+			double              histogramMin = stats.histogramMin; // See removeGeoValues()
+			double              histogramMax = stats.histogramMax;
+			parallelForDenseSlots(slots, [&](size_t begin, size_t end)
+			{
+				Statistics overwritten;
+				overwritten.reset(histogramMin, histogramMax);
+				size_t changed = 0;
+				size_t created = 0;
+				for(size_t i = begin; i < end; ++i)
+				{
+					const GeoValue* value = denseGeoValues.get(slots[i]);
+					if(value && geoValuesAreEqual(*value, newValue))
+						continue;
+					if(value)
+						overwritten.add(geoValueToDouble(*value));
+					created += denseGeoValues.setUncounted(slots[i], newValue) ? 1 : 0;
+					changed += 1;
+				}
+				changedCount += changed;
+				createdCount += created;
+				
+				std::lock_guard<std::mutex> lock(statsMutex);
+				stats.remove(overwritten);
+			});
+			affectedCount = changedCount;
+			denseGeoValues.used += createdCount;
+			stats.add(geoValueToDouble(newValue), affectedCount);
+		}
+	}
+	
+	if(affectedCount > 0)
+		markLodStale(sortedIndices.empty() ? indices : sortedIndices.data(), count);
+	return affectedCount;
 }
 
 
-size_t Dataset::removeGeoValue(H3Index index)
+size_t Dataset::eraseGeoValue(H3Index index)
 {
 	assert(index != H3_INVALID_INDEX);
 	
+	if(storage == Storage::Mapped)
+	{
+		if(mappedGeoValues.indexOf(index) == mappedGeoValues.NOT_FOUND)
+			return 0;
+		unmap();
+	}
+	
+	if(storage == Storage::Frozen)
+	{
+		// Removing a value that is not there is not an edit, do not pay for a thaw
+		if(frozenGeoValues.indexOf(index) == frozenGeoValues.NOT_FOUND)
+			return 0;
+		thaw();
+	}
+	
+	if(storage == Storage::Dense)
+	{
+		if(!h3HasDenseSlot(index, resolution))
+			return 0;
+		uint64_t        slot  = h3ToDenseSlot(index, resolution);
+		const GeoValue* value = denseGeoValues.get(slot);
+		if(!value)
+			return 0;
+		updateStatistics(value, nullptr);
+		size_t affectedCount = denseGeoValues.erase(slot);
+		if(fillRatio() <= SPARSE_MAX_FILL_RATIO)
+			thaw();
+		return affectedCount;
+	}
+	
+	const GeoValue* value = geoValues.get(index);
+	if(!value)
+		return 0;
+	updateStatistics(value, nullptr);
 	size_t affectedCount = geoValues.erase(index);
 	return affectedCount;
 }
 
 
-size_t Dataset::updateGeoValue(H3Index index, GeoValue newValue)
+size_t Dataset::storeGeoValue(H3Index index, GeoValue newValue)
 {
 	assert(index != H3_INVALID_INDEX);
 	assert(isInteger || std::isfinite(newValue.real));
 	
+	if(storage == Storage::Mapped)
+	{
+		const GeoValue* value = mappedGeoValues.get(index);
+		if(value && geoValuesAreEqual(*value, newValue))
+			return 0;
+		unmap();
+	}
+	
+	if(storage == Storage::Frozen)
+	{
+		// Overwriting an existing value keeps the arrays sorted, only new indices need the hash map
+		GeoValue* value = frozenGeoValues.get(index);
+		if(value)
+		{
+			if(geoValuesAreEqual(*value, newValue))
+				return 0;
+			updateStatistics(value, &newValue);
+			*value = newValue;
+			return 1;
+		}
+		thaw();
+	}
+	
+	if(storage == Storage::Dense && !h3HasDenseSlot(index, resolution))
+	{
+		thaw();
+		denseRejected = true;
+	}
+	
+	if(storage == Storage::Dense)
+	{
+		uint64_t  slot  = h3ToDenseSlot(index, resolution);
+		GeoValue* value = denseGeoValues.get(slot);
+		if(value && geoValuesAreEqual(*value, newValue))
+			return 0;
+		updateStatistics(value, &newValue);
+		denseGeoValues.set(slot, newValue);
+		return 1;
+	}
+	
 	auto [iter, created] = geoValues.insert({index, newValue});
 	if(created)
+	{
+		updateStatistics(nullptr, &newValue);
+		if(fillRatio() >= DENSE_MIN_FILL_RATIO)
+			makeDense();
 		return 1;
+	}
 	
 	GeoValue oldValue = iter->second;
 	if(isInteger)
 	{
 		if(oldValue.integer != newValue.integer)
 		{
+			updateStatistics(&oldValue, &newValue);
 			geoValues[index] = newValue;
 			return 1;
 		}
@@ -168,9 +920,636 @@ size_t Dataset::updateGeoValue(H3Index index, GeoValue newValue)
 	{
 		if(oldValue.real != newValue.real)
 		{
+			updateStatistics(&oldValue, &newValue);
 			geoValues[index] = newValue;
 			return 1;
 		}
 	}
 	return 0;
 }
+
+
+size_t Dataset::geoValueCount() const
+{
+	if(storage == Storage::Frozen)
+		return frozenGeoValues.size();
+	if(storage == Storage::Mapped)
+		return mappedGeoValues.size();
+	if(storage == Storage::Dense)
+		return denseGeoValues.size();
+	return geoValues.size();
+}
+
+
+double Dataset::fillRatio() const
+{
+	double result = double(geoValueCount()) / double(h3DenseSlotCount(resolution));
+	return result;
+}
+
+
+// Switches to the most compact read-mostly storage for the current fill ratio
+void Dataset::freeze()
+{
+	if(storage == Storage::Frozen || storage == Storage::Dense || storage == Storage::Mapped)
+		return;
+	
+	if(fillRatio() >= DENSE_MIN_FILL_RATIO)
+	{
+		makeDense();
+		return;
+	}
+	
+	frozenGeoValues.assign(geoValues.takeEntries());
+	storage = Storage::Frozen;
+}
+
+
+void Dataset::thaw()
+{
+	if(storage == Storage::Sparse)
+		return;
+	
+	geoValues.clear();
+	geoValues.reserve(geoValueCount());
+	forEachGeoValue([&](H3Index index, GeoValue geoValue)
+	{
+		geoValues.insert({index, geoValue});
+	});
+	
+	frozenGeoValues.clear();
+	denseGeoValues.clear();
+	mappedGeoValues.clear();
+	storage = Storage::Sparse;
+}
+
+
+// NOTE: A rejected dataset is not checked again until all of its values are replaced, edits would check it once per cell
+bool Dataset::makeDense()
+{
+	if(storage == Storage::Dense)
+		return true;
+	if(denseRejected)
+		return false;
+	
+	bool allHaveSlots = true;
+	forEachGeoValue([&](H3Index index, GeoValue)
+	{
+		allHaveSlots = allHaveSlots && h3HasDenseSlot(index, resolution);
+	});
+	if(!allHaveSlots)
+	{
+		denseRejected = true;
+		return false;
+	}
+	
+	DenseArrayMap<GeoValue> newGeoValues;
+	newGeoValues.resize(h3DenseSlotCount(resolution));
+	forEachGeoValue([&](H3Index index, GeoValue geoValue)
+	{
+		newGeoValues.set(h3ToDenseSlot(index, resolution), geoValue);
+	});
+	
+	geoValues.clear();
+	frozenGeoValues.clear();
+	mappedGeoValues.clear();
+	denseGeoValues = std::move(newGeoValues);
+	storage = Storage::Dense;
+	return true;
+}
+
+
+void Dataset::replaceGeoValues(int newResolution, SortedArrayMap<H3Index, GeoValue>&& newGeoValues)
+{
+	assert(IS_VALID_RESOLUTION(newResolution));
+	
+	geoValues.clear();
+	denseGeoValues.clear();
+	mappedGeoValues.clear();
+	frozenGeoValues = std::move(newGeoValues);
+	storage          = Storage::Frozen;
+	denseRejected    = false;
+	indicesUnchecked = false;
+	resolution       = newResolution;
+	invalidateLod();
+	recomputeStatistics();
+	
+	if(fillRatio() >= DENSE_MIN_FILL_RATIO)
+		makeDense();
+}
+
+
+// Serves the values straight from `newGeoValues`, which must be sorted and stay valid for as long as its owner lives
+// NOTE: Unlike replaceGeoValues(), this never switches to dense storage. That would copy the whole file into memory
+// NOTE: Statistics wait for the first statistics() call for the same reason, they read every value
+void Dataset::mapGeoValues(int newResolution, SortedArrayView<H3Index, GeoValue>&& newGeoValues)
+{
+	assert(IS_VALID_RESOLUTION(newResolution));
+	
+	geoValues.clear();
+	frozenGeoValues.clear();
+	denseGeoValues.clear();
+	mappedGeoValues  = std::move(newGeoValues);
+	storage          = Storage::Mapped;
+	denseRejected    = false;
+	indicesUnchecked = true;
+	resolution       = newResolution;
+	invalidateLod();
+	stats.reset(0.0, 0.0);
+	stats.stale = true;
+}
+
+
+// Copies mapped values into frozen storage, so that they can be edited. The mapping is released
+void Dataset::unmap()
+{
+	if(storage != Storage::Mapped)
+		return;
+	
+	frozenGeoValues.keys.assign(mappedGeoValues.keys, mappedGeoValues.keys + mappedGeoValues.size());
+	frozenGeoValues.values.assign(mappedGeoValues.values, mappedGeoValues.values + mappedGeoValues.size());
+	mappedGeoValues.clear();
+	storage = Storage::Frozen;
+	
+	// NOTE: Edits update the statistics from here on, so they must be there to update
+	if(stats.stale)
+		recomputeStatistics();
+}
+
+
+const SortedArrayMap<H3Index, GeoValue>& Dataset::lodGeoValues(int lodResolution)
+{
+	assert(0 <= lodResolution && lodResolution < resolution);
+	
+	// NOTE: Past some number of stale ancestors, visiting all their children costs more than coarsening everything
+	LodLevel& level = lodLevels[lodResolution];
+	if(!level.built || level.staleIndices.size() * h3MaxChildrenCount(lodResolution, resolution) >= geoValueCount())
+	{
+		level.geoValues = parentGeoValues(lodResolution);
+		level.staleIndices.clear();
+		level.built = true;
+	}
+	else
+	if(!level.staleIndices.empty())
+	{
+		refreshLodLevel(lodResolution);
+	}
+	return level.geoValues;
+}
+
+
+// Aggregates again the ancestors at `lodResolution` of the cells edited since the level was last used
+void Dataset::refreshLodLevel(int lodResolution)
+{
+	LodLevel& level = lodLevels[lodResolution];
+	
+	std::vector<H3Index> staleIndices(level.staleIndices.begin(), level.staleIndices.end());
+	std::sort(staleIndices.begin(), staleIndices.end());
+	level.staleIndices.clear();
+	
+	// Children of different parents do not interleave, so the children of sorted parents come out sorted
+	std::vector<H3Index> childIndices(h3MaxChildrenCount(lodResolution, resolution));
+	SortedArrayMap<H3Index, GeoValue> children;
+	for(H3Index parentIndex : staleIndices)
+	{
+		h3ToChildren(parentIndex, resolution, childIndices.data());
+		for(H3Index childIndex : childIndices)
+		{
+			GeoValue childGeoValue;
+			if(childIndex != H3_INVALID_INDEX && findGeoValue(childIndex, &childGeoValue))
+			{
+				children.keys.push_back(childIndex);
+				children.values.push_back(childGeoValue);
+			}
+		}
+	}
+	
+	SortedArrayMap<H3Index, GeoValue>  parents;
+	SortedArrayView<H3Index, GeoValue> childrenView = children.view();
+	if(isInteger)
+		coarsenGeoValues<int64_t, &GeoValue::integer>(this, lodResolution, &childrenView, &parents, nullptr);
+	else
+		coarsenGeoValues<double, &GeoValue::real>(this, lodResolution, &childrenView, &parents, nullptr);
+	
+	// Merge: stale parents are dropped from the level, those that still have children with a value come back updated
+	const SortedArrayMap<H3Index, GeoValue>& old = level.geoValues;
+	SortedArrayMap<H3Index, GeoValue> merged;
+	merged.keys.reserve(old.size() + parents.size());
+	merged.values.reserve(old.size() + parents.size());
+	size_t stale = 0;
+	size_t fresh = 0;
+	for(size_t i = 0; i < old.size(); ++i)
+	{
+		H3Index index = old.keys[i];
+		while(fresh < parents.size() && parents.keys[fresh] < index)
+		{
+			merged.keys.push_back(parents.keys[fresh]);
+			merged.values.push_back(parents.values[fresh]);
+			fresh += 1;
+		}
+		while(stale < staleIndices.size() && staleIndices[stale] < index)
+			stale += 1;
+		if(stale < staleIndices.size() && staleIndices[stale] == index)
+			continue;
+		
+		merged.keys.push_back(index);
+		merged.values.push_back(old.values[i]);
+	}
+	for(; fresh < parents.size(); ++fresh)
+	{
+		merged.keys.push_back(parents.keys[fresh]);
+		merged.values.push_back(parents.values[fresh]);
+	}
+	level.geoValues = std::move(merged);
+}
+
+
+void Dataset::markLodStale(H3Index index)
+{
+	for(int r = 0; r < resolution; ++r)
+		if(lodLevels[r].built)
+			lodLevels[r].staleIndices.insert(h3ToParent(index, r));
+}
+
+
+// NOTE: Cells of a batch that kept their value are marked too, aggregating their parents again is harmless
+// Sorted cells come in runs of siblings, so each parent is only looked up once per run. Once a level has as many stale
+// parents as lodGeoValues() rebuilds it for, it is dropped right away instead of collecting the rest
+void Dataset::markLodStale(const H3Index* indices, size_t count)
+{
+	for(int r = 0; r < resolution; ++r)
+	{
+		LodLevel& level = lodLevels[r];
+		if(!level.built)
+			continue;
+		
+		uint64_t childrenPerParent = h3MaxChildrenCount(r, resolution);
+		H3Index  lastParent        = H3_INVALID_INDEX;
+		for(size_t i = 0; i < count; ++i)
+		{
+			H3Index parent = h3ToParent(indices[i], r);
+			if(parent == lastParent)
+				continue;
+			lastParent = parent;
+			
+			level.staleIndices.insert(parent);
+			if(level.staleIndices.size() * childrenPerParent >= geoValueCount())
+			{
+				level.built = false;
+				level.geoValues.clear();
+				level.staleIndices.clear();
+				break;
+			}
+		}
+	}
+}
+
+
+// Drops every level of detail. Needed when the aggregation or the default value change, as edits do not cover those
+void Dataset::invalidateLod()
+{
+	for(LodLevel& level : lodLevels)
+	{
+		level.built = false;
+		level.geoValues.clear();
+		level.staleIndices.clear();
+	}
+}
+
+
+// Splits the values into ranges on the thread pool, and calls `f(Accumulator* partial, GeoValue geoValue)` on each value
+// of a range with a copy of `initial` private to the range. Partials are merged with `merge(Accumulator* into, const Accumulator& from)`
+template<typename Accumulator, typename F, typename M>
+static Accumulator reduceGeoValues(const Dataset* dataset, const Accumulator& initial, F&& f, M&& merge)
+{
+	Accumulator result = initial;
+	std::mutex  resultMutex;
+	auto reduceRange = [&](auto&& forEachInRange)
+	{
+		Accumulator partial = initial;
+		forEachInRange([&](GeoValue geoValue){ f(&partial, geoValue); });
+		
+		std::lock_guard<std::mutex> lock(resultMutex);
+		merge(&result, partial);
+	};
+	
+	if(dataset->storage == Dataset::Storage::Frozen || dataset->storage == Dataset::Storage::Mapped)
+	{
+		const GeoValue* values = dataset->storage == Dataset::Storage::Frozen ? dataset->frozenGeoValues.values.data() : dataset->mappedGeoValues.values;
+		parallelFor(dataset->geoValueCount(), BULK_EDIT_RANGE_SIZE, [&](size_t begin, size_t end)
+		{
+			reduceRange([&](auto&& visit)
+			{
+				for(size_t i = begin; i < end; ++i)
+					visit(values[i]);
+			});
+		});
+	}
+	else
+	if(dataset->storage == Dataset::Storage::Dense)
+	{
+		const DenseArrayMap<GeoValue>& dense = dataset->denseGeoValues;
+		parallelFor(dense.slotCount(), BULK_EDIT_RANGE_SIZE, [&](size_t begin, size_t end)
+		{
+			reduceRange([&](auto&& visit)
+			{
+				for(size_t slot = begin; slot < end; ++slot)
+					if(dense.contains(slot))
+						visit(dense.values[slot]);
+			});
+		});
+	}
+	else
+	{
+		const auto& slots = dataset->geoValues.slots;
+		parallelFor(slots.size(), BULK_EDIT_RANGE_SIZE, [&](size_t begin, size_t end)
+		{
+			reduceRange([&](auto&& visit)
+			{
+				for(size_t i = begin; i < end; ++i)
+					if(slots[i].first != FlatHashMap<H3Index, GeoValue>::EMPTY_KEY)
+						visit(slots[i].second);
+			});
+		});
+	}
+	return result;
+}
+
+
+void Dataset::Statistics::reset(double histogramMin, double histogramMax)
+{
+	*this = Statistics();
+	this->histogramMin = histogramMin;
+	this->histogramMax = histogramMax;
+}
+
+
+void Dataset::Statistics::add(double value, size_t repeat)
+{
+	if(repeat == 0)
+		return;
+	count        += repeat;
+	sum          += value * double(repeat);
+	sumOfSquares += value * value * double(repeat);
+	min           = std::min(min, value);
+	max           = std::max(max, value);
+	histogram[bin(value)] += repeat;
+}
+
+
+void Dataset::Statistics::remove(double value)
+{
+	assert(count > 0);
+	count        -= 1;
+	sum          -= value;
+	sumOfSquares -= value * value;
+	histogram[bin(value)] -= 1;
+	
+	// NOTE: Starting over also clears the rounding errors that the sums picked up
+	if(count == 0)
+		reset(histogramMin, histogramMax);
+	else
+	if(value <= min || value >= max)
+		extremesStale = true;
+}
+
+
+void Dataset::Statistics::add(const Statistics& that)
+{
+	assert(histogramMin == that.histogramMin && histogramMax == that.histogramMax);
+	count        += that.count;
+	sum          += that.sum;
+	sumOfSquares += that.sumOfSquares;
+	min           = std::min(min, that.min);
+	max           = std::max(max, that.max);
+	for(int i = 0; i < HISTOGRAM_BINS; ++i)
+		histogram[i] += that.histogram[i];
+}
+
+
+void Dataset::Statistics::remove(const Statistics& that)
+{
+	assert(histogramMin == that.histogramMin && histogramMax == that.histogramMax);
+	assert(count >= that.count);
+	if(that.count == 0)
+		return;
+	
+	count        -= that.count;
+	sum          -= that.sum;
+	sumOfSquares -= that.sumOfSquares;
+	for(int i = 0; i < HISTOGRAM_BINS; ++i)
+		histogram[i] -= that.histogram[i];
+	
+	if(count == 0)
+		reset(histogramMin, histogramMax);
+	else
+	if(that.min <= min || that.max >= max)
+		extremesStale = true;
+}
+
+
+int Dataset::Statistics::bin(double value) const
+{
+	if(!(histogramMax > histogramMin))
+		return 0;
+	double result = (value - histogramMin) / (histogramMax - histogramMin) * HISTOGRAM_BINS;
+	result = std::min(std::max(result, 0.0), double(HISTOGRAM_BINS - 1));
+	return int(result);
+}
+
+
+double Dataset::Statistics::mean() const
+{
+	double result = count > 0 ? sum / double(count) : DOUBLE_NAN;
+	return result;
+}
+
+
+double Dataset::Statistics::standardDeviation() const
+{
+	if(count == 0)
+		return DOUBLE_NAN;
+	double mean     = this->mean();
+	double variance = sumOfSquares / double(count) - mean * mean;
+	return std::sqrt(std::max(variance, 0.0));
+}
+
+
+const Dataset::Statistics& Dataset::statistics()
+{
+	if(stats.stale)
+		recomputeStatistics();
+	else
+	if(stats.extremesStale)
+		refreshStatisticsExtremes();
+	return stats;
+}
+
+
+// Two passes over the values, in parallel: the first finds the range of the histogram, the second fills it
+void Dataset::recomputeStatistics()
+{
+	stats.reset(0.0, 0.0);
+	refreshStatisticsExtremes();
+	
+	Statistics initial;
+	initial.reset(stats.min <= stats.max ? stats.min : 0.0, stats.min <= stats.max ? stats.max : 0.0);
+	stats = reduceGeoValues(this, initial,
+		[this](Statistics* partial, GeoValue geoValue){ partial->add(geoValueToDouble(geoValue)); },
+		[](Statistics* into, const Statistics& from){ into->add(from); });
+}
+
+
+void Dataset::fitValueRange()
+{
+	const Statistics& current = statistics();
+	if(current.count == 0)
+	{
+		minValue = {0};
+		maxValue = {0};
+	}
+	else
+	if(isInteger)
+	{
+		minValue.integer = int64_t(current.min);
+		maxValue.integer = int64_t(current.max);
+	}
+	else
+	{
+		minValue.real = current.min;
+		maxValue.real = current.max;
+	}
+}
+
+
+void Dataset::colorRange(double* outMin, double* outMax)
+{
+	assert(outMin && outMax);
+	
+	*outMin = geoValueToDouble(minValue);
+	*outMax = geoValueToDouble(maxValue);
+	if(*outMin == *outMax && statistics().count > 0)
+	{
+		*outMin = stats.min;
+		*outMax = stats.max;
+	}
+}
+
+
+// Keeps `stats` in sync with the edit of one cell
+void Dataset::updateStatistics(const GeoValue* oldValue, const GeoValue* newValue)
+{
+	if(oldValue)
+		stats.remove(geoValueToDouble(*oldValue));
+	if(newValue)
+		stats.add(geoValueToDouble(*newValue));
+}
+
+
+void Dataset::refreshStatisticsExtremes()
+{
+	std::pair<double, double> extremes = reduceGeoValues(this, std::pair<double, double>(+DOUBLE_INFINITY, -DOUBLE_INFINITY),
+		[this](std::pair<double, double>* partial, GeoValue geoValue)
+		{
+			double value = geoValueToDouble(geoValue);
+			partial->first  = std::min(partial->first,  value);
+			partial->second = std::max(partial->second, value);
+		},
+		[](std::pair<double, double>* into, const std::pair<double, double>& from)
+		{
+			into->first  = std::min(into->first,  from.first);
+			into->second = std::max(into->second, from.second);
+		});
+	stats.min           = extremes.first;
+	stats.max           = extremes.second;
+	stats.extremesStale = false;
+}
+
+
+SortedArrayMap<H3Index, GeoValue> Dataset::childGeoValues(int newResolution, const ProgressCallback& progress) const
+{
+	assert(IS_VALID_RESOLUTION(newResolution));
+	assert(newResolution > resolution);
+	
+	SortedArrayMap<H3Index, GeoValue>  buffer;
+	SortedArrayView<H3Index, GeoValue> parents = sortedGeoValues(&buffer);
+	
+	// Every parent owns a fixed block of the output, so threads write straight into the result without locking
+	// The children of a parent are sorted and come after the children of all smaller parents, so the result is sorted
+	uint64_t childrenPerParent = h3MaxChildrenCount(resolution, newResolution);
+	SortedArrayMap<H3Index, GeoValue> children;
+	children.keys.resize(parents.size() * childrenPerParent);
+	children.values.resize(parents.size() * childrenPerParent);
+	
+	std::atomic<size_t> parentsDone(0);
+	parallelFor(parents.size(), 256, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+		{
+			H3Index*  childIndices = children.keys.data()   + i * childrenPerParent;
+			GeoValue* childValues  = children.values.data() + i * childrenPerParent;
+			h3ToChildren(parents.keys[i], newResolution, childIndices);
+			std::fill(childValues, childValues + childrenPerParent, parents.values[i]);
+		}
+		
+		size_t done = parentsDone.fetch_add(end - begin) + (end - begin);
+		if(progress)
+			progress(double(done) / double(parents.size()));
+	});
+	
+	// NOTE: Pentagons have fewer children, the rest of their block is filled with H3_INVALID_INDEX. Squeeze it out
+	size_t childrenCount = 0;
+	for(size_t i = 0; i < children.keys.size(); ++i)
+	{
+		if(children.keys[i] != H3_INVALID_INDEX)
+		{
+			children.keys[childrenCount]   = children.keys[i];
+			children.values[childrenCount] = children.values[i];
+			childrenCount += 1;
+		}
+	}
+	children.keys.resize(childrenCount);
+	children.values.resize(childrenCount);
+	
+	return children;
+}
+
+
+SortedArrayMap<H3Index, GeoValue> Dataset::parentGeoValues(int newResolution, const ProgressCallback& progress) const
+{
+	assert(IS_VALID_RESOLUTION(newResolution));
+	assert(newResolution < resolution);
+	
+	// A parent gets a value if any of its children has one, so there cannot be more parents than children
+	SortedArrayMap<H3Index, GeoValue> parents;
+	size_t maxParentsCount = std::min<uint64_t>(geoValueCount(), h3DenseSlotCount(newResolution));
+	parents.keys.reserve(maxParentsCount);
+	parents.values.reserve(maxParentsCount);
+	
+	if(isInteger)
+		coarsenGeoValues<int64_t, &GeoValue::integer>(this, newResolution, nullptr, &parents, progress);
+	else
+		coarsenGeoValues<double, &GeoValue::real>(this, newResolution, nullptr, &parents, progress);
+	return parents;
+}
+
+
+// Returns the values sorted by index. Frozen and mapped storage are returned as they are, the others are copied into
+// `buffer`. A view of mapped storage keeps the mapping alive even if the dataset lets go of it
+SortedArrayView<H3Index, GeoValue> Dataset::sortedGeoValues(SortedArrayMap<H3Index, GeoValue>* buffer) const
+{
+	if(storage == Storage::Frozen)
+		return frozenGeoValues.view();
+	if(storage == Storage::Mapped)
+		return mappedGeoValues;
+	
+	assert(buffer);
+	std::vector<std::pair<H3Index, GeoValue>> entries;
+	entries.reserve(geoValueCount());
+	forEachGeoValue([&](H3Index index, GeoValue geoValue)
+	{
+		entries.push_back({index, geoValue});
+	});
+	buffer->assign(std::move(entries));
+	return buffer->view();
+}
@@ -3,11 +3,13 @@
 
 #include <cassert>
 #include <cmath>
+#include <functional>
 #include <QMetaType>
 #include <h3/h3api.h>
 
 #include "Containers.hpp"
 #include "GeoValue.hpp"
+#include "MapUtils.hpp"
 
 
 constexpr double DOUBLE_NAN = std::numeric_limits<double>::quiet_NaN();
@@ -19,33 +21,213 @@ struct Dataset
 {
 	static constexpr double NO_DENSITY = DOUBLE_NAN;
 	
+	// Receives the completed fraction of a long operation, in [0, 1]. May be called from any thread
+	using ProgressCallback = std::function<void(double progress)>;
 	
-	DatasetID_t                id;
-	HashMap<H3Index, GeoValue> geoValues;
-	int                        resolution;
-	GeoValue                   defaultValue;
-	double                     density;
-	bool                       isInteger;
-	std::string                measureUnit;
-	GeoValue                   minValue;
-	GeoValue                   maxValue;
+	// A dense array costs ~8 bytes per cell of the globe, sorted arrays cost 16 bytes per value
+	// Switch to dense storage when at least half of the cells have a value, and back only when a quarter or less of
+	// them have one, so that editing around the threshold does not convert the storage back and forth
+	static constexpr double DENSE_MIN_FILL_RATIO  = 0.5;
+	static constexpr double SPARSE_MAX_FILL_RATIO = 0.25;
+	
+	// Batches of edits smaller than this are applied cell by cell, sorting them would cost more than it saves
+	static constexpr size_t BULK_EDIT_MIN_CELLS = 1024;
+	
+	// How decreaseResolution() combines the values of the children into the value of their parent
+	enum class Aggregation
+	{
+		Mean,             // Mean of the children that have a value. Integers are rounded to the nearest
+		MeanWithDefault,  // Mean of all children, children without a value count as `defaultValue`
+		AreaWeightedMean, // Sum of value * area of the children over the area of the children. Children without a value count as 0
+		Min,              // Smallest value among the children that have a value
+		Max,              // Largest value among the children that have a value
+		Mode,             // Most common value among the children that have a value. Ties go to the smallest value
+	};
+	
+	// Values aggregated to one resolution coarser than the dataset, see lodGeoValues()
+	struct LodLevel
+	{
+		bool                              built = false;
+		SortedArrayMap<H3Index, GeoValue> geoValues;
+		HashSet<H3Index>                  staleIndices; // Parents of cells edited since `geoValues` was computed
+	};
+	
+	// Summary of the values, kept up to date by every edit, see statistics()
+	struct Statistics
+	{
+		static constexpr int HISTOGRAM_BINS = 32;
+		
+		size_t count         = 0;
+		double min           = +DOUBLE_INFINITY;
+		double max           = -DOUBLE_INFINITY;
+		double sum           = 0.0;
+		double sumOfSquares  = 0.0;
+		bool   extremesStale = false; // An extreme was removed, `min` and `max` are only bounds until they are found again
+		bool   stale         = false; // Nothing was computed yet for the values, see mapGeoValues()
+		
+		// The bins split [histogramMin, histogramMax] evenly, values outside of it count in the first or last bin
+		// NOTE: The range is set by the last full computation, edits never move the bins
+		double histogramMin  = 0.0;
+		double histogramMax  = 0.0;
+		size_t histogram[HISTOGRAM_BINS] = {};
+		
+		
+		void   reset(double histogramMin, double histogramMax);
+		void   add(double value, size_t repeat = 1);
+		void   remove(double value);
+		void   add(const Statistics& that);    // Both must have the same histogram range
+		void   remove(const Statistics& that); // Values of `that` must have been added before
+		int    bin(double value) const;
+		double mean() const;
+		double standardDeviation() const;
+	};
+	
+	enum class Storage
+	{
+		Sparse, // Values are in `geoValues`, which supports fast inserts and removals
+		Frozen, // Values are in `frozenGeoValues`, which is compact and iterates in index order
+		Dense,  // Values are in `denseGeoValues`, one slot per cell at `resolution` (see h3ToDenseSlot)
+		Mapped, // Values are in `mappedGeoValues`, read-only arrays inside a memory-mapped file. Edits copy them out
+	};
+	
+	
+	DatasetID_t                        id;
+	Storage                            storage;
+	FlatHashMap<H3Index, GeoValue>     geoValues;
+	SortedArrayMap<H3Index, GeoValue>  frozenGeoValues;
+	DenseArrayMap<GeoValue>            denseGeoValues;
+	SortedArrayView<H3Index, GeoValue> mappedGeoValues;
+	int                                resolution;
+	Aggregation                        aggregation;
+	GeoValue                           defaultValue;
+	double                             density;
+	bool                               isInteger;
+	std::string                        measureUnit;
+	GeoValue                           minValue;
+	GeoValue                           maxValue;
+	LodLevel                           lodLevels[MAX_SUPPORTED_RESOLUTION]; // By resolution, below `resolution` only
+	Statistics                         stats;                               // See statistics()
+	bool                               denseRejected;                       // Some value has no dense slot, see makeDense()
+	bool                               indicesUnchecked;                    // Mapped cells not all checked yet, see checkDatasetIndices()
 	
 	
 	explicit Dataset();
 //	explicit Dataset(DatasetID_t id);
 	Dataset(DatasetID_t id, bool hasDensity, bool isInteger);
 	
+	static const char* aggregationName(Aggregation aggregation);
+	static bool        aggregationFromName(const std::string& name, Aggregation* outAggregation);
+	
 	bool   geoValuesAreEqual(GeoValue a, GeoValue b);
 	bool   hasDensity();
-	void   increaseResolution(int newResolution);
-	void   decreaseResolution(int newResolution);
+	void   increaseResolution(int newResolution, const ProgressCallback& progress = nullptr);
+	void   decreaseResolution(int newResolution, const ProgressCallback& progress = nullptr);
 	bool   findGeoValue(H3Index index, GeoValue* outValue);
 	size_t removeGeoValue(H3Index index);
 	size_t updateGeoValue(H3Index index, GeoValue newValue);
+	
+	// Same as removeGeoValue() and updateGeoValue() on each cell, returning how many values changed. Large batches are
+	// sorted once and applied with a single lookup per cell, split across the thread pool where the storage allows it
+	// NOTE: Indices must be distinct
+	size_t removeGeoValues(const H3Index* indices, size_t count);
+	size_t updateGeoValues(const H3Index* indices, size_t count, GeoValue newValue);
+	
+	size_t geoValueCount() const;
+	double fillRatio() const;
+	void   freeze();
+	void   thaw();
+	bool   makeDense(); // Returns false and keeps the storage if some index is invalid or not at `resolution`
+	void   replaceGeoValues(int newResolution, SortedArrayMap<H3Index, GeoValue>&& newGeoValues);
+	void   mapGeoValues(int newResolution, SortedArrayView<H3Index, GeoValue>&& newGeoValues);
+	void   unmap();
+	
+	// Values of the parents at `lodResolution` of the cells that have a value, combined like decreaseResolution() does
+	// Zoomed out maps draw these instead of cells smaller than a pixel. Each level is computed on first use, edits
+	// only mark the ancestors of the edited cells, which are aggregated again on the next use
+	const SortedArrayMap<H3Index, GeoValue>& lodGeoValues(int lodResolution);
+	void   invalidateLod();
+	
+	// Count, extremes, moments and histogram of the values. Edits update them in O(1) per cell, except that removing the
+	// smallest or largest value leaves the extremes to be found again, in parallel, by the next call
+	const Statistics& statistics();
+	void   recomputeStatistics();
+	
+	// Sets `minValue` and `maxValue` to the range of the values
+	void   fitValueRange();
+	
+	// Range of the color scale: `minValue` and `maxValue`, or the range of the values as long as those two are equal
+	void   colorRange(double* outMin, double* outMax);
+	
+	inline double geoValueToDouble(GeoValue geoValue) const { return isInteger ? double(geoValue.integer) : geoValue.real; }
+	
+	// These only read the dataset, so they can run on a worker thread while the GUI thread draws it
+	// The dataset must not be modified until they return, see DatasetControlWidget::changeResolutionBegin()
+	SortedArrayMap<H3Index, GeoValue> childGeoValues(int newResolution, const ProgressCallback& progress = nullptr) const;
+	SortedArrayMap<H3Index, GeoValue> parentGeoValues(int newResolution, const ProgressCallback& progress = nullptr) const;
+	SortedArrayView<H3Index, GeoValue> sortedGeoValues(SortedArrayMap<H3Index, GeoValue>* buffer) const;
+	
+	// Calls `f(H3Index index, GeoValue geoValue)` for each value. Values come in index order unless storage is Sparse
+	template<typename F>
+	void forEachGeoValue(F&& f) const;
+	
+	// Same as forEachGeoValue() at `lodResolution`, which may be `resolution` itself
+	template<typename F>
+	void forEachLodGeoValue(int lodResolution, F&& f);
+
+
+protected:
+	size_t eraseGeoValue(H3Index index);
+	size_t storeGeoValue(H3Index index, GeoValue newValue);
+	void   refreshLodLevel(int lodResolution);
+	void   markLodStale(H3Index index);
+	void   markLodStale(const H3Index* indices, size_t count);
+	void   updateStatistics(const GeoValue* oldValue, const GeoValue* newValue); // Null for cells without a value
+	void   refreshStatisticsExtremes();
 };
 Q_DECLARE_METATYPE(Dataset*)
 
 
+template<typename F>
+void Dataset::forEachGeoValue(F&& f) const
+{
+	if(storage == Storage::Frozen || storage == Storage::Mapped)
+	{
+		const H3Index*  indices = storage == Storage::Frozen ? frozenGeoValues.keys.data()   : mappedGeoValues.keys;
+		const GeoValue* values  = storage == Storage::Frozen ? frozenGeoValues.values.data() : mappedGeoValues.values;
+		for(size_t i = 0, count = geoValueCount(); i < count; ++i)
+			f(indices[i], values[i]);
+	}
+	else
+	if(storage == Storage::Dense)
+	{
+		denseGeoValues.forEach([&](size_t slot, GeoValue geoValue)
+		{
+			f(h3FromDenseSlot(slot, resolution), geoValue);
+		});
+	}
+	else
+	{
+		for(const auto& [index, geoValue] : geoValues)
+			f(index, geoValue);
+	}
+}
+
+
+template<typename F>
+void Dataset::forEachLodGeoValue(int lodResolution, F&& f)
+{
+	if(lodResolution == resolution)
+	{
+		forEachGeoValue(f);
+		return;
+	}
+	
+	const SortedArrayMap<H3Index, GeoValue>& lodValues = lodGeoValues(lodResolution);
+	for(size_t i = 0; i < lodValues.size(); ++i)
+		f(lodValues.keys[i], lodValues.values[i]);
+}
+
+
 #if 0
 // https://uber.github.io/h3/#/documentation/core-library/resolution-table
 inline
@@ -2,18 +2,23 @@
 
 #include <cassert>
 
+#include <QComboBox>
 #include <QFormLayout>
 #include <QLabel>
 #include <QLineEdit>
+#include <QPushButton>
 #include <QSpinBox>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QtWidgets/QMessageBox>
 
 #include "Dataset.hpp"
 #include "MapUtils.hpp"
 
 
-DatasetControlWidget::DatasetControlWidget(QWidget* parent) : QWidget(parent)
+DatasetControlWidget::DatasetControlWidget(QWidget* parent) : QWidget(parent), resolutionChangePercent(0)
 {
+	QObject::connect(&resolutionChangeWatcher, &QFutureWatcher<void>::finished, this, &DatasetControlWidget::changeResolutionEnd);
+	
 	integerValidator.setRange(0, std::numeric_limits<int>::max());
 	doubleValidator.setRange(0, DOUBLE_MAX, UI_DOUBLE_PRECISION);
 	
@@ -35,6 +40,25 @@ DatasetControlWidget::DatasetControlWidget(QWidget* parent) : QWidget(parent)
 		groupLayout->addRow(label, resolutionSpinBox);
 	}
 	
+	{	QLabel* label = new QLabel(this);
+		label->setText(tr("Aggregation"));
+		
+		// NOTE: Item data is the Dataset::Aggregation value
+		aggregationComboBox = new QComboBox(this);
+		aggregationComboBox->setMaximumWidth(110);
+		aggregationComboBox->setToolTip(tr("How values are combined when the resolution is decreased"));
+		aggregationComboBox->addItem(tr("Mean"),               (int)Dataset::Aggregation::Mean);
+		aggregationComboBox->addItem(tr("Mean with default"),  (int)Dataset::Aggregation::MeanWithDefault);
+		aggregationComboBox->addItem(tr("Area weighted mean"), (int)Dataset::Aggregation::AreaWeightedMean);
+		aggregationComboBox->addItem(tr("Minimum"),            (int)Dataset::Aggregation::Min);
+		aggregationComboBox->addItem(tr("Maximum"),            (int)Dataset::Aggregation::Max);
+		aggregationComboBox->addItem(tr("Mode"),               (int)Dataset::Aggregation::Mode);
+		aggregationComboBox->setEnabled(false);
+		QObject::connect(aggregationComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, &DatasetControlWidget::onAggregationComboBoxChanged);
+		
+		groupLayout->addRow(label, aggregationComboBox);
+	}
+	
 	{	QLabel* label = new QLabel(this);
 		label->setText(tr("Default"));
 		
@@ -91,6 +115,33 @@ DatasetControlWidget::DatasetControlWidget(QWidget* parent) : QWidget(parent)
 		
 		groupLayout->addRow(label, maxValueLineEdit);
 	}
+	
+	{	fitRangeButton = new QPushButton(this);
+		fitRangeButton->setText(tr("Fit to values"));
+		fitRangeButton->setMaximumWidth(110);
+		fitRangeButton->setToolTip(tr("Set the minimum and maximum to the range of the values"));
+		fitRangeButton->setEnabled(false);
+		QObject::connect(fitRangeButton, &QPushButton::clicked, this, &DatasetControlWidget::onFitRangeClicked);
+		
+		groupLayout->addRow(new QLabel(this), fitRangeButton);
+	}
+	
+	{	QLabel* label = new QLabel(this);
+		label->setText(tr("Values"));
+		
+		// NOTE: The tooltip shows the histogram
+		statisticsLabel = new QLabel(this);
+		statisticsLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+		
+		groupLayout->addRow(label, statisticsLabel);
+	}
+}
+
+
+DatasetControlWidget::~DatasetControlWidget()
+{
+	// The worker reads the dataset and writes into this widget, neither can go away under it
+	resolutionChangeWatcher.waitForFinished();
 }
 
 
@@ -113,11 +164,13 @@ void DatasetControlWidget::refreshViews(Dataset* dataset)
 	
 	if(dataset)
 	{
-		resolutionSpinBox->setEnabled(true);
+		resolutionSpinBox->setEnabled(!isResolutionChangePending());
+		aggregationComboBox->setEnabled(!isResolutionChangePending());
 		defaultLineEdit->setEnabled(true);
 		densityLineEdit->setEnabled(dataset->hasDensity());
 		minValueLineEdit->setEnabled(true);
 		maxValueLineEdit->setEnabled(true);
+		fitRangeButton->setEnabled(true);
 		
 		QString measureUnit = QString::fromStdString(dataset->measureUnit);
 		defaultLineEdit->setPlaceholderText(measureUnit);
@@ -125,6 +178,7 @@ void DatasetControlWidget::refreshViews(Dataset* dataset)
 		maxValueLineEdit->setPlaceholderText(measureUnit);
 		
 		resolutionSpinBox->setValue(dataset->resolution);
+		aggregationComboBox->setCurrentIndex(aggregationComboBox->findData((int)dataset->aggregation));
 		
 		if(dataset->hasDensity())
 		{
@@ -155,20 +209,27 @@ void DatasetControlWidget::refreshViews(Dataset* dataset)
 			minValueLineEdit->setText(QString::number(dataset->minValue.real,    'f', minValueDecimals));
 			maxValueLineEdit->setText(QString::number(dataset->maxValue.real,    'f', maxValueDecimals));
 		}
+		
+		refreshStatistics(dataset);
 	}
 	else
 	{
 		resolutionSpinBox->clear();
+		aggregationComboBox->setCurrentIndex(-1);
 		defaultLineEdit->clear();
 		densityLineEdit->clear();
 		minValueLineEdit->clear();
 		maxValueLineEdit->clear();
 		
 		resolutionSpinBox->setEnabled(false);
+		aggregationComboBox->setEnabled(false);
 		defaultLineEdit->setEnabled(false);
 		densityLineEdit->setEnabled(false);
 		minValueLineEdit->setEnabled(false);
 		maxValueLineEdit->setEnabled(false);
+		fitRangeButton->setEnabled(false);
+		statisticsLabel->clear();
+		statisticsLabel->setToolTip("");
 	}
 	
 //	resolutionSpinBox->blockSignals(false);
@@ -179,27 +240,160 @@ void DatasetControlWidget::refreshViews(Dataset* dataset)
 }
 
 
+void DatasetControlWidget::refreshStatistics(Dataset* dataset)
+{
+	if(!dataset || dataset != this->dataset)
+		return;
+	
+	const Dataset::Statistics& stats = dataset->statistics();
+	if(stats.count == 0)
+	{
+		statisticsLabel->setText(tr("No values"));
+		statisticsLabel->setToolTip("");
+		return;
+	}
+	
+	int precision = dataset->isInteger ? 0 : minValueDecimals;
+	statisticsLabel->setText(tr("%1 cells\nMean %2\nStd. dev. %3")
+		.arg(stats.count)
+		.arg(QString::number(stats.mean(), 'f', precision))
+		.arg(QString::number(stats.standardDeviation(), 'f', precision)));
+	
+	// NOTE: The first and last bins also count the values edited in outside of the range, see Dataset::Statistics
+	QStringList lines;
+	double binWidth = (stats.histogramMax - stats.histogramMin) / Dataset::Statistics::HISTOGRAM_BINS;
+	for(int i = 0; i < Dataset::Statistics::HISTOGRAM_BINS; ++i)
+	{
+		if(stats.histogram[i] == 0)
+			continue;
+		lines.append(tr("%1 to %2: %3")
+			.arg(QString::number(stats.histogramMin + binWidth * i,       'g', 6))
+			.arg(QString::number(stats.histogramMin + binWidth * (i + 1), 'g', 6))
+			.arg(stats.histogram[i]));
+	}
+	statisticsLabel->setToolTip(lines.join('\n'));
+}
+
+
 void DatasetControlWidget::onResolutionSpinboxChanged(int newResolution)
 {
 	assert(dataset);
 	assert(IS_VALID_RESOLUTION(newResolution));
 	
 	if(dataset->resolution != newResolution)
+		changeResolutionBegin(newResolution);
+}
+
+
+void DatasetControlWidget::changeResolutionBegin(int newResolution)
+{
+	assert(dataset);
+	assert(!isResolutionChangePending());
+	
+	// NOTE: The worker takes a sorted snapshot of sparse values itself, see Dataset::sortedGeoValues(). Sorting here would
+	// stall the window, and the dataset stays read-only until changeResolutionEnd() anyway
+	resolutionChangeDataset  = dataset;
+	resolutionChangeOldValue = dataset->resolution;
+	resolutionChangeNewValue = newResolution;
+	resolutionChangeFailed   = false;
+	resolutionChangePercent  = 0;
+	resolutionSpinBox->setEnabled(false);
+	aggregationComboBox->setEnabled(false); // The worker reads it
+	emit resolutionChangeStarted(dataset);
+	
+	Dataset* source = dataset;
+	int oldResolution = dataset->resolution;
+	QFuture<void> future = QtConcurrent::run([this, source, oldResolution, newResolution]()
 	{
-		int oldResolution = dataset->resolution;
+		auto progress = [this, source](double fraction)
+		{
+			// Only forward whole percent steps, the event queue does not need thousands of them
+			int percent = int(fraction * 100.0);
+			int oldPercent = resolutionChangePercent.load();
+			while(percent > oldPercent)
+			{
+				if(resolutionChangePercent.compare_exchange_weak(oldPercent, percent))
+				{
+					QMetaObject::invokeMethod(this, [this, source, percent](){ emit resolutionChangeProgress(source, percent); }, Qt::QueuedConnection);
+					break;
+				}
+			}
+		};
+		
 		try
 		{
-			if(newResolution < oldResolution)
-				dataset->decreaseResolution(newResolution);
+			if(newResolution > oldResolution)
+				resolutionChangeResult = source->childGeoValues(newResolution, progress);
 			else
-				dataset->increaseResolution(newResolution);
+				resolutionChangeResult = source->parentGeoValues(newResolution, progress);
 		}
 		catch(std::bad_alloc& ex)
 		{
-			QMessageBox::critical(this, tr("Memory allocation error"), tr("Not enough memory to store new values"));
-			// TODO: Let application crash? Data consistency is not enforced anyway
+			resolutionChangeResult = SortedArrayMap<H3Index, GeoValue>();
+			resolutionChangeFailed = true;
 		}
-		emit resolutionChanged(dataset, oldResolution);
+	});
+	resolutionChangeWatcher.setFuture(future);
+}
+
+
+void DatasetControlWidget::changeResolutionEnd()
+{
+	// NOTE: Runs twice when waitForResolutionChange() gets there before the watcher signal
+	Dataset* dataset = resolutionChangeDataset;
+	if(!dataset)
+		return;
+	
+	if(!resolutionChangeFailed)
+	{
+		emit resolutionAboutToChange(dataset);
+		dataset->replaceGeoValues(resolutionChangeNewValue, std::move(resolutionChangeResult));
+	}
+	else
+	{
+		QMessageBox::critical(this, tr("Memory allocation error"), tr("Not enough memory to store new values"));
+	}
+	resolutionChangeResult  = SortedArrayMap<H3Index, GeoValue>();
+	resolutionChangeDataset = nullptr;
+	
+	resolutionSpinBox->blockSignals(true);
+	resolutionSpinBox->setValue(dataset->resolution);
+	resolutionSpinBox->setEnabled(this->dataset != nullptr);
+	resolutionSpinBox->blockSignals(false);
+	aggregationComboBox->setEnabled(this->dataset != nullptr);
+	
+	emit resolutionChanged(dataset, resolutionChangeOldValue);
+}
+
+
+bool DatasetControlWidget::isResolutionChangePending()
+{
+	bool result = resolutionChangeDataset != nullptr;
+	return result;
+}
+
+
+// Blocks until a pending resolution change is done and applies it. Call this before deleting datasets
+void DatasetControlWidget::waitForResolutionChange()
+{
+	if(!isResolutionChangePending())
+		return;
+	resolutionChangeWatcher.waitForFinished();
+	changeResolutionEnd();
+}
+
+
+void DatasetControlWidget::onAggregationComboBoxChanged(int index)
+{
+	if(!dataset || index < 0)
+		return;
+	
+	Dataset::Aggregation newAggregation = (Dataset::Aggregation)aggregationComboBox->itemData(index).toInt();
+	if(dataset->aggregation != newAggregation)
+	{
+		Dataset::Aggregation oldAggregation = dataset->aggregation;
+		dataset->aggregation = newAggregation;
+		emit aggregationChanged(dataset, oldAggregation);
 	}
 }
 
@@ -355,3 +549,17 @@ void DatasetControlWidget::onMaxValueEditFinished()
 		}
 	}
 }
+
+
+void DatasetControlWidget::onFitRangeClicked()
+{
+	assert(dataset);
+	
+	GeoValue oldMinValue = dataset->minValue;
+	GeoValue oldMaxValue = dataset->maxValue;
+	dataset->fitValueRange();
+	refreshViews(dataset);
+	
+	if(!dataset->geoValuesAreEqual(oldMinValue, dataset->minValue) || !dataset->geoValuesAreEqual(oldMaxValue, dataset->maxValue))
+		emit valueRangeChanged(dataset, oldMinValue, oldMaxValue);
+}
@@ -2,13 +2,18 @@
 #define GIAGUI_DATASETCONTROLWIDGET_HPP
 
 
+#include <atomic>
+#include <QFutureWatcher>
 #include <QWidget>
 #include <QValidator>
 
 #include "Dataset.hpp"
 
 
+class QComboBox;
+class QLabel;
 class QLineEdit;
+class QPushButton;
 class QSpinBox;
 struct Dataset;
 
@@ -23,11 +28,15 @@ public:
 	QIntValidator    integerValidator;
 	QDoubleValidator doubleValidator;
 	
-	QSpinBox*  resolutionSpinBox = nullptr;
-	QLineEdit* defaultLineEdit   = nullptr;
-	QLineEdit* densityLineEdit   = nullptr;
-	QLineEdit* minValueLineEdit  = nullptr;
-	QLineEdit* maxValueLineEdit  = nullptr;
+	QSpinBox*  resolutionSpinBox  = nullptr;
+	QComboBox* aggregationComboBox = nullptr;
+	QLineEdit* defaultLineEdit    = nullptr;
+	QLineEdit* densityLineEdit    = nullptr;
+	QLineEdit* minValueLineEdit   = nullptr;
+	QLineEdit* maxValueLineEdit   = nullptr;
+	
+	QPushButton* fitRangeButton  = nullptr;
+	QLabel*      statisticsLabel = nullptr;
 	
 	// NOTE: These were an attempt at preserving the input just as the user typed it
 	// They are not really used for anything useful now
@@ -36,22 +45,43 @@ public:
 	int minValueDecimals = 6;
 	int maxValueDecimals = 6;
 	
+	// Resolution changes run on the thread pool. The dataset is only read until the result is swapped in on the GUI thread
+	QFutureWatcher<void>              resolutionChangeWatcher;
+	Dataset*                          resolutionChangeDataset  = nullptr;
+	int                               resolutionChangeOldValue = 0;
+	int                               resolutionChangeNewValue = 0;
+	bool                              resolutionChangeFailed   = false;
+	std::atomic<int>                  resolutionChangePercent;
+	SortedArrayMap<H3Index, GeoValue> resolutionChangeResult;
+	
 	
 	explicit DatasetControlWidget(QWidget* parent = nullptr);
+	~DatasetControlWidget() override;
 	
 	void setDataSource(Dataset* dataset);
 	void refreshViews(Dataset* dataset);
+	void refreshStatistics(Dataset* dataset); // Call after editing the values of the dataset
 	
 	
 	void onResolutionSpinboxChanged(int newResolution);
+	void changeResolutionBegin(int newResolution);
+	void changeResolutionEnd();
+	bool isResolutionChangePending();
+	void waitForResolutionChange();
+	void onAggregationComboBoxChanged(int index);
 	void onDefaultEditFinished();
 	void onDensityEditFinished();
 	void onMinValueEditFinished();
 	void onMaxValueEditFinished();
+	void onFitRangeClicked();
 	
 	
 signals:
+	void resolutionChangeStarted(Dataset* dataset);
+	void resolutionChangeProgress(Dataset* dataset, int percent);
+	void resolutionAboutToChange(Dataset* dataset); // The dataset still holds the values at the old resolution
 	void resolutionChanged(Dataset* dataset, int newResolution);
+	void aggregationChanged(Dataset* dataset, Dataset::Aggregation oldAggregation);
 	void defaultChanged(Dataset* dataset, GeoValue newDefault);
 	void densityChanged(Dataset* dataset, double newDensity);
 	void valueRangeChanged(Dataset* dataset, GeoValue min, GeoValue max);
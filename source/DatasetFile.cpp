@@ -0,0 +1,821 @@
+#include "DatasetFile.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <cpptoml.h>
+
+#include "BufferedWriter.hpp"
+#include "Dataset.hpp"
+#include "H3bFormat.hpp"
+#include "Parallel.hpp"
+
+
+// How many values are read between checks of the cancellation flag
+#define CANCELLATION_CHECK_INTERVAL 4096
+
+// Cells checked by checkIndices() on one thread
+#define CHECK_INDICES_RANGE_SIZE 65536
+
+// Pairs of neighbouring cells checked when a file is mapped, the rest is left to checkDatasetIndices()
+#define CHECK_INDICES_SAMPLES    4096
+
+
+enum class ParseResult
+{
+	Ok,
+	Error,       // The file is broken, `outError` says why
+	Unsupported, // The file may be fine, but it uses TOML features the fast parser does not know about
+};
+
+
+inline const char* skipSpaces(const char* p, const char* end)
+{
+	while(p < end && (*p == ' ' || *p == '\t'))
+		p += 1;
+	return p;
+}
+
+
+// True if only spaces and maybe a comment are left
+inline bool isLineTail(const char* p, const char* end)
+{
+	p = skipSpaces(p, end);
+	return p == end || *p == '#';
+}
+
+
+inline const char* parseBareKey(const char* p, const char* end, std::string_view* outKey)
+{
+	const char* begin = p;
+	while(p < end && (std::isalnum((unsigned char)*p) || *p == '_' || *p == '-'))
+		p += 1;
+	*outKey = std::string_view(begin, p - begin);
+	return p > begin ? p : nullptr;
+}
+
+
+// Literal strings ('...') and basic strings without escapes ("...")
+inline const char* parseSimpleString(const char* p, const char* end, std::string* outString)
+{
+	if(p == end || (*p != '\'' && *p != '"'))
+		return nullptr;
+	char quote = *p;
+	const char* begin = p + 1;
+	const char* close = std::find(begin, end, quote);
+	if(close == end || std::find(begin, close, '\\') != close)
+		return nullptr;
+	outString->assign(begin, close);
+	return close + 1;
+}
+
+
+// NOTE: std::from_chars does not take the leading '+' that TOML allows
+template<typename T>
+inline const char* parseNumber(const char* p, const char* end, T* outValue)
+{
+	if(p < end && *p == '+')
+		p += 1;
+	std::from_chars_result result;
+	if constexpr(std::is_integral_v<T>)
+		result = std::from_chars(p, end, *outValue, 10);
+	else
+		result = std::from_chars(p, end, *outValue);
+	return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+
+// Fails unless each index is a valid cell at `resolution` and, with `mustAscend`, greater than the one before it
+// NOTE: Datasets assume both, dense storage in particular computes array positions straight from the index digits
+static bool checkIndices(const H3Index* indices, size_t count, int resolution, bool mustAscend, const QString& path, QString* outError)
+{
+	std::atomic<size_t> firstInvalid(count);
+	std::atomic<size_t> firstUnsorted(count);
+	parallelFor(count, CHECK_INDICES_RANGE_SIZE, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+		{
+			if(!h3IsValid(indices[i]) || h3GetResolution(indices[i]) != resolution)
+			{
+				size_t first = firstInvalid;
+				while(i < first && !firstInvalid.compare_exchange_weak(first, i));
+				return;
+			}
+			if(mustAscend && i > 0 && indices[i-1] >= indices[i])
+			{
+				size_t first = firstUnsorted;
+				while(i < first && !firstUnsorted.compare_exchange_weak(first, i));
+				return;
+			}
+		}
+	});
+	
+	if(firstInvalid < count)
+	{
+		*outError = QObject::tr("Cell %1 in '%2' is not a valid cell at resolution %3").arg(indices[firstInvalid], 0, 16).arg(path).arg(resolution);
+		return false;
+	}
+	if(firstUnsorted < count)
+	{
+		*outError = QObject::tr("Cells in '%1' are not in ascending order at cell %2").arg(path).arg(indices[firstUnsorted], 0, 16);
+		return false;
+	}
+	return true;
+}
+
+
+// checkIndices() on evenly spaced pairs of neighbours, the last one included. Catches files written for another
+// resolution or with unsorted cells while paging in at most one page of the index column per pair
+static bool checkIndexSample(const H3Index* indices, size_t count, int resolution, const QString& path, QString* outError)
+{
+	if(count <= 2 * CHECK_INDICES_SAMPLES)
+		return checkIndices(indices, count, resolution, true, path, outError);
+	
+	size_t step = count / CHECK_INDICES_SAMPLES;
+	for(size_t i = 0; i + 1 < count; i += step)
+	{
+		if(!checkIndices(indices + i, 2, resolution, true, path, outError))
+			return false;
+	}
+	return checkIndices(indices + count - 2, 2, resolution, true, path, outError);
+}
+
+
+// Single pass parser for the files written by writeDatasetFile(), which reads `hex = number` lines straight into
+// sorted arrays. Anything it does not expect makes it give up with Unsupported, so that the caller can fall back to the
+// general TOML parser. The dataset is only touched on success
+static ParseResult parseDatasetText(const char* begin, const char* end, const QString& path, Dataset* dataset, QString* outError, const std::atomic<bool>* cancelled)
+{
+	enum class Section
+	{
+		Root,
+		Giagui,
+		H3,
+		H3Values,
+	};
+	
+	Section     section     = Section::Root;
+	bool        tablesSeen[4] = {true, false, false, false}; // By Section
+	
+	// NOTE: TOML does not allow defining a table or a key twice, cpptoml reports those
+	std::vector<std::string_view> keysSeen; // Of the current table
+	std::string name        = QFileInfo(path).baseName().toStdString();
+	std::string aggregation = "mean";
+	std::string type        = "1f";
+	bool        typeSeen    = false;
+	int         resolution  = 0;
+	double      density     = Dataset::NO_DENSITY;
+	std::string defaultText = "0";
+	
+	// NOTE: Written files are sorted, so usually the values can go to frozen storage as they are
+	SortedArrayMap<H3Index, GeoValue> values;
+	values.keys.reserve((end - begin) / 24);
+	values.values.reserve((end - begin) / 24);
+	bool     sorted   = true;
+	
+	size_t linesCount = 0;
+	for(const char* line = begin; line < end; )
+	{
+		const char* lineEnd = (const char*)std::memchr(line, '\n', end - line);
+		if(!lineEnd)
+			lineEnd = end;
+		const char* next = lineEnd + (lineEnd < end ? 1 : 0);
+		if(lineEnd > line && lineEnd[-1] == '\r')
+			lineEnd -= 1;
+		
+		if(cancelled && ++linesCount % CANCELLATION_CHECK_INTERVAL == 0 && *cancelled)
+		{
+			*outError = QObject::tr("Loading of '%1' was cancelled").arg(path);
+			return ParseResult::Error;
+		}
+		
+		const char* p = skipSpaces(line, lineEnd);
+		line = next;
+		if(isLineTail(p, lineEnd))
+			continue;
+		
+		
+		if(*p == '[')
+		{
+			const char* close = std::find(p, lineEnd, ']');
+			if(close == lineEnd || !isLineTail(close + 1, lineEnd))
+				return ParseResult::Unsupported;
+			
+			std::string_view table(p + 1, close - p - 1);
+			if(table == "giagui")
+				section = Section::Giagui;
+			else if(table == "h3")
+				section = Section::H3;
+			else if(table == "h3.values" && typeSeen)
+				section = Section::H3Values;
+			else
+				return ParseResult::Unsupported;
+			
+			if(tablesSeen[(int)section])
+				return ParseResult::Unsupported;
+			tablesSeen[(int)section] = true;
+			keysSeen.clear();
+			continue;
+		}
+		
+		
+		if(section == Section::H3Values)
+		{
+			char quote = *p == '\'' || *p == '"' ? *p : 0;
+			if(quote)
+				p += 1;
+			
+			H3Index index = H3_INVALID_INDEX;
+			std::from_chars_result result = std::from_chars(p, lineEnd, index, 16);
+			if(result.ec != std::errc() || index == H3_INVALID_INDEX)
+				return ParseResult::Unsupported;
+			p = result.ptr;
+			if(quote)
+			{
+				if(p == lineEnd || *p != quote)
+					return ParseResult::Unsupported;
+				p += 1;
+			}
+			
+			p = skipSpaces(p, lineEnd);
+			if(p == lineEnd || *p != '=')
+				return ParseResult::Unsupported;
+			p = skipSpaces(p + 1, lineEnd);
+			
+			GeoValue geoValue = {0};
+			if(type.back() == 'i')
+			{
+				p = parseNumber(p, lineEnd, &geoValue.integer);
+				if(!p || !isLineTail(p, lineEnd))
+					return ParseResult::Unsupported;
+			}
+			else
+			{
+				p = parseNumber(p, lineEnd, &geoValue.real);
+				if(!p || !isLineTail(p, lineEnd))
+					return ParseResult::Unsupported;
+			}
+			
+			sorted = sorted && (values.empty() || values.keys.back() < index);
+			values.keys.push_back(index);
+			values.values.push_back(geoValue);
+			continue;
+		}
+		
+		
+		std::string_view key;
+		p = parseBareKey(p, lineEnd, &key);
+		if(!p)
+			return ParseResult::Unsupported;
+		if(std::find(keysSeen.begin(), keysSeen.end(), key) != keysSeen.end())
+			return ParseResult::Unsupported;
+		keysSeen.push_back(key);
+		p = skipSpaces(p, lineEnd);
+		if(p == lineEnd || *p != '=')
+			return ParseResult::Unsupported;
+		p = skipSpaces(p + 1, lineEnd);
+		
+		if(section == Section::Giagui && key == "name")
+		{
+			p = parseSimpleString(p, lineEnd, &name);
+		}
+		else if(section == Section::Giagui && key == "aggregation")
+		{
+			p = parseSimpleString(p, lineEnd, &aggregation);
+		}
+		else if(section == Section::H3 && key == "resolution")
+		{
+			p = parseNumber(p, lineEnd, &resolution);
+		}
+		else if(section == Section::H3 && key == "type")
+		{
+			p = parseSimpleString(p, lineEnd, &type);
+			typeSeen = p && !type.empty();
+		}
+		else if(section == Section::H3 && key == "density")
+		{
+			p = parseNumber(p, lineEnd, &density);
+		}
+		else if(section == Section::H3 && key == "default")
+		{
+			// NOTE: The type may come later, so this is parsed at the end
+			const char* valueEnd = p;
+			while(valueEnd < lineEnd && *valueEnd != ' ' && *valueEnd != '\t' && *valueEnd != '#')
+				valueEnd += 1;
+			defaultText.assign(p, valueEnd);
+			p = valueEnd;
+		}
+		else
+		{
+			return ParseResult::Unsupported;
+		}
+		
+		if(!p || !isLineTail(p, lineEnd))
+			return ParseResult::Unsupported;
+	}
+	
+	
+	// A file without values is not a dataset, the general parser reports it
+	if(!tablesSeen[(int)Section::H3Values])
+		return ParseResult::Unsupported;
+	
+	bool     isInteger    = type.back() == 'i';
+	GeoValue defaultValue = {0};
+	const char* defaultEnd = defaultText.data() + defaultText.size();
+	if(isInteger ? parseNumber(defaultText.data(), defaultEnd, &defaultValue.integer) != defaultEnd
+	             : parseNumber(defaultText.data(), defaultEnd, &defaultValue.real)    != defaultEnd)
+		return ParseResult::Unsupported;
+	
+	Dataset::Aggregation aggregationValue;
+	if(!Dataset::aggregationFromName(aggregation, &aggregationValue))
+	{
+		*outError = QObject::tr("Unknown aggregation '%1' in '%2'").arg(QString::fromStdString(aggregation)).arg(path);
+		return ParseResult::Error;
+	}
+	
+	if(!IS_VALID_RESOLUTION(resolution))
+	{
+		*outError = QObject::tr("Unsupported resolution %1 in '%2'").arg(resolution).arg(path);
+		return ParseResult::Error;
+	}
+	
+	if(!sorted)
+	{
+		std::vector<std::pair<H3Index, GeoValue>> entries;
+		entries.reserve(values.size());
+		for(size_t i = 0; i < values.size(); ++i)
+			entries.push_back({values.keys[i], values.values[i]});
+		values.assign(std::move(entries));
+		
+		for(size_t i = 1; i < values.size(); ++i)
+		{
+			if(values.keys[i-1] == values.keys[i])
+			{
+				*outError = QObject::tr("Cell %1 appears more than once in '%2'").arg(values.keys[i], 0, 16).arg(path);
+				return ParseResult::Error;
+			}
+		}
+	}
+	
+	if(!checkIndices(values.keys.data(), values.size(), resolution, false, path, outError))
+		return ParseResult::Error;
+	
+	
+	dataset->id           = std::move(name);
+	dataset->isInteger    = isInteger;
+	dataset->density      = density;
+	dataset->measureUnit  = ""; // TODO: This is not really useful. Remove it?
+	dataset->aggregation  = aggregationValue;
+	dataset->defaultValue = defaultValue;
+	dataset->replaceGeoValues(resolution, std::move(values));
+	
+	// NOTE: Text files do not store a color scale, it starts as the range of the values
+	dataset->fitValueRange();
+	return ParseResult::Ok;
+}
+
+
+// Hexadecimal cell index, as keys of [h3.values] are written
+static bool parseCellKey(const std::string& key, int resolution, H3Index* outIndex)
+{
+	const char* end = key.data() + key.size();
+	std::from_chars_result result = std::from_chars(key.data(), end, *outIndex, 16);
+	return result.ec == std::errc() && result.ptr == end && h3IsValid(*outIndex) && h3GetResolution(*outIndex) == resolution;
+}
+
+
+// General TOML parser, for files the fast parser does not support
+static ParseResult parseDatasetToml(std::istream& stream, const QString& path, Dataset* dataset, QString* outError, const std::atomic<bool>* cancelled)
+{
+	std::shared_ptr<cpptoml::table> root = nullptr;
+	try
+	{
+		cpptoml::parser parser(stream);
+		root = parser.parse();
+	}
+	catch(cpptoml::parse_exception& ex)
+	{
+		*outError = QObject::tr("Cannot parse '%1': %2").arg(path).arg(ex.what());
+		return ParseResult::Error;
+	}
+	
+	
+	dataset->id          = root->get_qualified_as<std::string>("giagui.name").value_or(QFileInfo(path).baseName().toStdString());
+	dataset->resolution  = root->get_qualified_as<int>("h3.resolution").value_or(0);
+	dataset->isInteger   = root->get_qualified_as<std::string>("h3.type").value_or("1f").back() == 'i';
+	dataset->density     = root->get_qualified_as<double>("h3.density").value_or(Dataset::NO_DENSITY);
+	dataset->measureUnit = ""; // TODO: This is not really useful. Remove it?
+	dataset->aggregation = Dataset::Aggregation::Mean;
+	
+	std::string aggregationName = root->get_qualified_as<std::string>("giagui.aggregation").value_or("mean");
+	if(!Dataset::aggregationFromName(aggregationName, &dataset->aggregation))
+	{
+		*outError = QObject::tr("Unknown aggregation '%1' in '%2'").arg(QString::fromStdString(aggregationName)).arg(path);
+		return ParseResult::Error;
+	}
+	
+	if(!IS_VALID_RESOLUTION(dataset->resolution))
+	{
+		*outError = QObject::tr("Unsupported resolution %1 in '%2'").arg(dataset->resolution).arg(path);
+		return ParseResult::Error;
+	}
+	
+	std::shared_ptr<cpptoml::table> values = root->get_table_qualified("h3.values");
+	if(!values)
+	{
+		*outError = QObject::tr("Missing [h3.values] table in '%1'").arg(path);
+		return ParseResult::Error;
+	}
+	
+	size_t valuesCount = 0;
+	if(dataset->isInteger)
+	{
+		dataset->defaultValue.integer = root->get_qualified_as<int64_t>("h3.default").value_or(0);
+		
+		for(auto& [key, val] : *values)
+		{
+			std::shared_ptr<cpptoml::value<int64_t>> integer = val->as<int64_t>();
+			if(!integer)
+			{
+				*outError = QObject::tr("Value of cell %1 in '%2' is not an integer").arg(QString::fromStdString(key)).arg(path);
+				return ParseResult::Error;
+			}
+			
+			H3Index index = H3_INVALID_INDEX;
+			if(!parseCellKey(key, dataset->resolution, &index))
+			{
+				*outError = QObject::tr("Key '%1' in '%2' is not a valid cell at resolution %3").arg(QString::fromStdString(key)).arg(path).arg(dataset->resolution);
+				return ParseResult::Error;
+			}
+			
+			GeoValue geoValue = {0};
+			geoValue.integer = integer->get();
+			dataset->geoValues.insert({index, geoValue});
+			
+			if(cancelled && ++valuesCount % CANCELLATION_CHECK_INTERVAL == 0 && *cancelled)
+			{
+				*outError = QObject::tr("Loading of '%1' was cancelled").arg(path);
+				return ParseResult::Error;
+			}
+		}
+	}
+	else
+	{
+		dataset->defaultValue.real = root->get_qualified_as<double>("h3.default").value_or(0);
+		
+		for(auto& [key, val] : *values)
+		{
+			std::shared_ptr<cpptoml::value<double>> real = val->as<double>();
+			if(!real)
+			{
+				*outError = QObject::tr("Value of cell %1 in '%2' is not a float").arg(QString::fromStdString(key)).arg(path);
+				return ParseResult::Error;
+			}
+			
+			H3Index index = H3_INVALID_INDEX;
+			if(!parseCellKey(key, dataset->resolution, &index))
+			{
+				*outError = QObject::tr("Key '%1' in '%2' is not a valid cell at resolution %3").arg(QString::fromStdString(key)).arg(path).arg(dataset->resolution);
+				return ParseResult::Error;
+			}
+			
+			GeoValue geoValue = {0};
+			geoValue.real = real->get();
+			dataset->geoValues.insert({index, geoValue});
+			
+			if(cancelled && ++valuesCount % CANCELLATION_CHECK_INTERVAL == 0 && *cancelled)
+			{
+				*outError = QObject::tr("Loading of '%1' was cancelled").arg(path);
+				return ParseResult::Error;
+			}
+		}
+	}
+	
+	// Loaded datasets are mostly read, keep them in the compact representation until the user edits them
+	dataset->freeze();
+	
+	// NOTE: Values went straight into the hash map, so they were not counted
+	dataset->recomputeStatistics();
+	dataset->fitValueRange();
+	return ParseResult::Ok;
+}
+
+
+// Binary files are two columns. When the indices are stored raw the file is memory-mapped and the dataset reads the
+// columns in place, otherwise they are read straight into frozen storage. Either way there is no per-cell work
+// NOTE: Read cells are checked to be valid and sorted. Of mapped ones only a sample is, so that opening a file does not
+// page in its whole index column, see checkDatasetIndices()
+static ParseResult parseDatasetBinary(std::istream& stream, const QString& path, Dataset* dataset, QString* outError)
+{
+	H3bHeader   header;
+	std::string name;
+	std::string error;
+	if(!h3bReadHeader(stream, &header, &name, &error))
+	{
+		*outError = QObject::tr("Cannot read '%1': %2").arg(path).arg(QString::fromStdString(error));
+		return ParseResult::Error;
+	}
+	
+	std::string type(header.type);
+	if(type != "1i" && type != "1f")
+	{
+		*outError = QObject::tr("Unsupported value type '%1' in '%2'").arg(QString::fromStdString(type)).arg(path);
+		return ParseResult::Error;
+	}
+	
+	if(!IS_VALID_RESOLUTION(header.resolution))
+	{
+		*outError = QObject::tr("Unsupported resolution %1 in '%2'").arg((int)header.resolution).arg(path);
+		return ParseResult::Error;
+	}
+	
+	if(header.aggregation > (uint8_t)Dataset::Aggregation::Mode)
+	{
+		*outError = QObject::tr("Unknown aggregation %1 in '%2'").arg((int)header.aggregation).arg(path);
+		return ParseResult::Error;
+	}
+	
+	// NOTE: The sizes come from the file, make sure they are not made up before allocating or mapping for them
+	// Each one is compared to what is left of the file, so that a huge one cannot overflow the sum
+	stream.seekg(0, std::ios::end);
+	uint64_t fileSize      = stream.tellg();
+	uint64_t indicesOffset = h3bIndicesOffset(header);
+	stream.seekg(indicesOffset);
+	if(indicesOffset > fileSize || header.indicesSize > fileSize - indicesOffset || header.count > (fileSize - indicesOffset - header.indicesSize) / sizeof(GeoValue))
+	{
+		*outError = QObject::tr("Cannot read '%1': %2").arg(path).arg("file is truncated");
+		return ParseResult::Error;
+	}
+	
+	dataset->id           = name.empty() ? QFileInfo(path).baseName().toStdString() : std::move(name);
+	dataset->isInteger    = type == "1i";
+	dataset->density      = header.density;
+	dataset->measureUnit  = ""; // TODO: This is not really useful. Remove it?
+	dataset->aggregation  = (Dataset::Aggregation)header.aggregation;
+	std::memcpy(&dataset->defaultValue, header.defaultValue, sizeof(GeoValue));
+	std::memcpy(&dataset->minValue,     header.minValue,     sizeof(GeoValue));
+	std::memcpy(&dataset->maxValue,     header.maxValue,     sizeof(GeoValue));
+	
+	// NOTE: GeoValue is a union of int64_t and double, so the value column has exactly its layout
+	static_assert(sizeof(GeoValue) == 8, "GeoValue must match the value column of .h3b files");
+	
+	if((header.flags & H3B_FLAG_DELTA_INDICES) == 0)
+	{
+		// NOTE: The mapping lives as long as the QFile. Mapping can fail on some file systems, then the file is read
+		// NOTE: Truncating the file while it is mapped crashes the program. Saving over it is fine, that replaces the file
+		std::shared_ptr<QFile> file = std::make_shared<QFile>(path);
+		uchar* data = file->open(QIODevice::ReadOnly) ? file->map(0, fileSize) : nullptr;
+		if(data)
+		{
+			SortedArrayView<H3Index, GeoValue> values;
+			values.keys   = (const H3Index*) (data + h3bIndicesOffset(header));
+			values.values = (const GeoValue*)(data + h3bValuesOffset(header));
+			values.count  = header.count;
+			values.owner  = std::move(file);
+			if(!checkIndexSample(values.keys, values.count, header.resolution, path, outError))
+				return ParseResult::Error;
+			dataset->mapGeoValues(header.resolution, std::move(values));
+			return ParseResult::Ok;
+		}
+	}
+	
+	SortedArrayMap<H3Index, GeoValue> values;
+	values.keys.resize(header.count);
+	values.values.resize(header.count);
+	if(!h3bReadIndices(stream, header, values.keys.data(), &error) || !h3bReadValues(stream, header, values.values.data(), &error))
+	{
+		*outError = QObject::tr("Cannot read '%1': %2").arg(path).arg(QString::fromStdString(error));
+		return ParseResult::Error;
+	}
+	if(!checkIndices(values.keys.data(), values.size(), header.resolution, true, path, outError))
+		return ParseResult::Error;
+	dataset->replaceGeoValues(header.resolution, std::move(values));
+	return ParseResult::Ok;
+}
+
+
+bool readDatasetFile(const QString& path, Dataset* dataset, QString* outError, const std::atomic<bool>* cancelled)
+{
+	assert(dataset);
+	assert(outError);
+	
+	std::ifstream stream(path.toStdString(), std::ios::binary);
+	if(!stream.is_open())
+	{
+		char* errString = strerror(errno);
+		*outError = QObject::tr("Cannot open '%1' for reading: %2").arg(path).arg(errString);
+		return false;
+	}
+	
+	if(h3bIsBinary(stream))
+		return parseDatasetBinary(stream, path, dataset, outError) == ParseResult::Ok;
+	
+	std::string text;
+	stream.seekg(0, std::ios::end);
+	text.resize(stream.tellg());
+	stream.seekg(0, std::ios::beg);
+	stream.read(text.data(), text.size());
+	if(stream.fail())
+	{
+		char* errString = strerror(errno);
+		*outError = QObject::tr("Cannot read '%1': %2").arg(path).arg(errString);
+		return false;
+	}
+	stream.close();
+	
+	
+	ParseResult result = parseDatasetText(text.data(), text.data() + text.size(), path, dataset, outError, cancelled);
+	if(result == ParseResult::Unsupported)
+	{
+		std::istringstream textStream(std::move(text));
+		result = parseDatasetToml(textStream, path, dataset, outError, cancelled);
+	}
+	return result == ParseResult::Ok;
+}
+
+
+static void writeDatasetBinary(std::ostream& stream, Dataset* dataset)
+{
+	SortedArrayMap<H3Index, GeoValue>  buffer;
+	SortedArrayView<H3Index, GeoValue> values = dataset->sortedGeoValues(&buffer);
+	
+	H3bHeader header = h3bMakeHeader(dataset->isInteger ? "1i" : "1f", dataset->resolution, values.size());
+	header.aggregation = (uint8_t)dataset->aggregation;
+	header.density     = dataset->density;
+	std::memcpy(header.defaultValue, &dataset->defaultValue, sizeof(GeoValue));
+	std::memcpy(header.minValue,     &dataset->minValue,     sizeof(GeoValue));
+	std::memcpy(header.maxValue,     &dataset->maxValue,     sizeof(GeoValue));
+	
+	h3bWrite(stream, header, dataset->id, values.keys, values.values);
+}
+
+
+static void writeDatasetText(std::ostream& stream, Dataset* dataset)
+{
+	BufferedWriter writer(&stream);
+	
+	
+	writer.write("[giagui]\n");
+	writer.write("name = '");
+	writer.write(dataset->id);
+	writer.write("'\n");
+	writer.write("aggregation = '");
+	writer.write(Dataset::aggregationName(dataset->aggregation));
+	writer.write("'\n");
+	writer.write("\n");
+	
+	
+	writer.write("[h3]\n");
+	writer.write("resolution = ");
+	writer.writeInteger(dataset->resolution);
+	writer.write("\n");
+	
+	if(dataset->isInteger)
+	{
+		writer.write("type = '1i'\n");
+		writer.write("default = ");
+		writer.writeInteger(dataset->defaultValue.integer);
+		writer.write("\n");
+	}
+	else
+	{
+		writer.write("type = '1f'\n");
+		writer.write("default = ");
+		writer.writeFixed(dataset->defaultValue.real);
+		writer.write("\n");
+	}
+	
+	if(dataset->hasDensity())
+	{
+		writer.write("density = ");
+		writer.writeFixed(dataset->density);
+		writer.write("\n");
+	}
+	writer.write("\n");
+	
+	
+	// NOTE: Values go out sorted by index, so saving the same data always produces the same file
+	SortedArrayMap<H3Index, GeoValue>  buffer;
+	SortedArrayView<H3Index, GeoValue> values = dataset->sortedGeoValues(&buffer);
+	
+	writer.write("[h3.values]\n");
+	if(dataset->isInteger)
+	{
+		for(size_t i = 0; i < values.size(); ++i)
+		{
+			writer.writeHex(values.keys[i]);
+			writer.write(" = ");
+			writer.writeInteger(values.values[i].integer);
+			writer.write("\n");
+		}
+	}
+	else
+	{
+		for(size_t i = 0; i < values.size(); ++i)
+		{
+			writer.writeHex(values.keys[i]);
+			writer.write(" = ");
+			writer.writeFixed(values.values[i].real);
+			writer.write("\n");
+		}
+	}
+}
+
+
+bool writeDatasetFile(const QString& path, Dataset* dataset, QString* outError)
+{
+	assert(dataset);
+	assert(outError);
+	
+	if(path.size() == 0)
+	{
+		*outError = QObject::tr("No file name given");
+		return false;
+	}
+	
+	// NOTE: The data goes to a temporary file that then replaces `path`. Truncating `path` in place would pull it out
+	// from under the datasets that have it memory-mapped, including `dataset` itself
+	bool    binary   = QFileInfo(path).suffix() == "h3b";
+	QString tempPath = path + ".part";
+	std::ofstream fileStream(tempPath.toStdString(), binary ? std::ios::binary : std::ios::out);
+	if(!fileStream.is_open())
+	{
+		char* errString = strerror(errno);
+		*outError = QObject::tr("Cannot open '%1' for writing: %2").arg(tempPath).arg(errString);
+		return false;
+	}
+	
+	if(binary)
+		writeDatasetBinary(fileStream, dataset);
+	else
+		writeDatasetText(fileStream, dataset);
+	
+	fileStream.close();
+	if(fileStream.fail())
+	{
+		char* errString = strerror(errno);
+		*outError = QObject::tr("Cannot write data to '%1': %2").arg(tempPath).arg(errString);
+		QFile::remove(tempPath);
+		return false;
+	}
+	
+	// NOTE: std::rename() replaces `path` in one step, so it holds either the old or the new file even if this fails
+	if(std::rename(tempPath.toStdString().c_str(), path.toStdString().c_str()) != 0)
+	{
+		char* errString = strerror(errno);
+		*outError = QObject::tr("Cannot replace '%1' with '%2': %3").arg(path).arg(tempPath).arg(errString);
+		QFile::remove(tempPath);
+		return false;
+	}
+	return true;
+}
+
+
+bool checkDatasetIndices(Dataset* dataset, QString* outError)
+{
+	assert(dataset);
+	assert(outError);
+	
+	if(!dataset->indicesUnchecked)
+		return true;
+	
+	SortedArrayMap<H3Index, GeoValue>  buffer;
+	SortedArrayView<H3Index, GeoValue> values = dataset->sortedGeoValues(&buffer);
+	if(!checkIndices(values.keys, values.count, dataset->resolution, true, QString::fromStdString(dataset->id), outError))
+		return false;
+	dataset->indicesUnchecked = false;
+	return true;
+}
+
+
+QStringList projectDatasetFiles(const QString& directoryPath)
+{
+	QStringList result;
+	for(const QFileInfo& fileInfo : QDir(directoryPath).entryInfoList(QDir::Filter::Files, QDir::SortFlag::NoSort))
+	{
+		if(fileInfo.suffix() == "h3" || fileInfo.suffix() == "h3b")
+			result.append(fileInfo.filePath());
+	}
+	return result;
+}
+
+
+QString projectDatasetPath(const QString& directoryPath, const Dataset* dataset, const QString& sourcePath)
+{
+	QString suffix = QFileInfo(sourcePath).suffix() == "h3b" ? ".h3b" : ".h3";
+	return QDir(directoryPath).filePath(QString::fromStdString(dataset->id) + suffix);
+}
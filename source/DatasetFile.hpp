@@ -0,0 +1,35 @@
+#ifndef GIAGUI_DATASETFILE_HPP
+#define GIAGUI_DATASETFILE_HPP
+
+
+#include <atomic>
+#include <QString>
+#include <QStringList>
+
+
+struct Dataset;
+
+
+// Reading and writing of dataset files, TOML+H3 text (.h3) or binary (.h3b, see H3bFormat.hpp)
+// These do not touch any widget, so they can run on a worker thread. On failure they return false and put a message
+// for the user in `outError`
+
+
+// Fills `dataset`, which should be freshly constructed. `cancelled` is polled while reading, and aborts the read when set
+bool readDatasetFile(const QString& path, Dataset* dataset, QString* outError, const std::atomic<bool>* cancelled = nullptr);
+
+bool writeDatasetFile(const QString& path, Dataset* dataset, QString* outError);
+
+// Checks every cell of a dataset that readDatasetFile() memory-mapped, where it only checked a sample of them. Must
+// pass before anything indexes arrays by the cells, does nothing the second time
+bool checkDatasetIndices(Dataset* dataset, QString* outError);
+
+// Files of a project directory that hold datasets, in either format
+QStringList projectDatasetFiles(const QString& directoryPath);
+
+// Where saving a project to `directoryPath` writes `dataset`: a file named after it, in the format of `sourcePath`, the
+// file the dataset was loaded from or last saved to. Text unless that one is a .h3b
+QString projectDatasetPath(const QString& directoryPath, const Dataset* dataset, const QString& sourcePath);
+
+
+#endif //GIAGUI_DATASETFILE_HPP
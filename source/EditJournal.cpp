@@ -0,0 +1,317 @@
+#include "EditJournal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <new>
+
+#include "Dataset.hpp"
+#include "Parallel.hpp"
+
+
+// Cells whose current state apply() reads on one thread
+static constexpr size_t APPLY_MIN_RANGE_CELLS = 16384;
+
+// NOTE: Sorted indices differ by little, so their deltas compress well even at the fastest level
+static constexpr int COMPRESSION_LEVEL = 1;
+
+
+void EditJournal::recordRemoval(Dataset* dataset, const H3Index* indices, size_t count)
+{
+	record(dataset, indices, count, nullptr);
+}
+
+
+void EditJournal::recordUpdate(Dataset* dataset, const H3Index* indices, size_t count, GeoValue newValue)
+{
+	record(dataset, indices, count, &newValue);
+}
+
+
+void EditJournal::recordResolutionChange(Dataset* dataset)
+{
+	assert(dataset);
+	
+	SortedArrayMap<H3Index, GeoValue>  buffer;
+	SortedArrayView<H3Index, GeoValue> geoValues = dataset->sortedGeoValues(&buffer);
+	push(pack(dataset, dataset->resolution, true, geoValues.keys, geoValues.values, nullptr, geoValues.size()));
+}
+
+
+EditJournal::Change EditJournal::undo()
+{
+	return applyLast(&undoEntries, &redoEntries);
+}
+
+
+EditJournal::Change EditJournal::redo()
+{
+	return applyLast(&redoEntries, &undoEntries);
+}
+
+
+void EditJournal::forget(Dataset* dataset)
+{
+	auto isOfDataset = [dataset](const Entry& entry){ return entry.dataset == dataset; };
+	undoEntries.erase(std::remove_if(undoEntries.begin(), undoEntries.end(), isOfDataset), undoEntries.end());
+	redoEntries.erase(std::remove_if(redoEntries.begin(), redoEntries.end(), isOfDataset), redoEntries.end());
+	
+	byteCount = 0;
+	for(const Entry& entry : undoEntries)
+		byteCount += entry.byteCount;
+	for(const Entry& entry : redoEntries)
+		byteCount += entry.byteCount;
+}
+
+
+void EditJournal::clear()
+{
+	undoEntries.clear();
+	redoEntries.clear();
+	byteCount = 0;
+}
+
+
+// `newValue` is null for removals
+void EditJournal::record(Dataset* dataset, const H3Index* indices, size_t count, const GeoValue* newValue)
+{
+	assert(dataset);
+	
+	std::vector<H3Index> sortedIndices(indices, indices + count);
+	std::sort(sortedIndices.begin(), sortedIndices.end());
+	
+	CellStates oldStates;
+	for(H3Index index : sortedIndices)
+	{
+		GeoValue oldValue = {0};
+		bool     present  = dataset->findGeoValue(index, &oldValue);
+		if(newValue ? present && dataset->geoValuesAreEqual(oldValue, *newValue) : !present)
+			continue;
+		
+		oldStates.indices.push_back(index);
+		oldStates.values.push_back(oldValue);
+		oldStates.present.push_back(present);
+	}
+	if(oldStates.indices.empty())
+		return;
+	
+	push(pack(dataset, dataset->resolution, false, oldStates.indices.data(), oldStates.values.data(), oldStates.present.data(), oldStates.indices.size()));
+}
+
+
+void EditJournal::push(Entry&& entry)
+{
+	for(const Entry& redoEntry : redoEntries)
+		byteCount -= redoEntry.byteCount;
+	redoEntries.clear();
+	
+	byteCount += entry.byteCount;
+	undoEntries.push_back(std::move(entry));
+	trim();
+}
+
+
+// Drops the entries farthest from the current state until the journal fits in `maxByteCount`
+// NOTE: An entry only applies to the state left by the entries between it and the current state, so those go last
+void EditJournal::trim()
+{
+	while(byteCount > maxByteCount && !undoEntries.empty())
+	{
+		byteCount -= undoEntries.front().byteCount;
+		undoEntries.pop_front();
+	}
+	while(byteCount > maxByteCount && !redoEntries.empty())
+	{
+		byteCount -= redoEntries.front().byteCount;
+		redoEntries.pop_front();
+	}
+}
+
+
+// Applies the back of `from` and moves it, now holding the states it replaced, to the back of `to`
+EditJournal::Change EditJournal::applyLast(std::deque<Entry>* from, std::deque<Entry>* to)
+{
+	if(from->empty())
+		return Change();
+	
+	Entry entry = std::move(from->back());
+	from->pop_back();
+	byteCount -= entry.byteCount;
+	
+	Change change = apply(&entry);
+	byteCount += entry.byteCount;
+	to->push_back(std::move(entry));
+	trim();
+	return change;
+}
+
+
+EditJournal::Change EditJournal::apply(Entry* entry)
+{
+	Dataset* dataset = entry->dataset;
+	
+	Change change;
+	change.dataset       = dataset;
+	change.oldResolution = dataset->resolution;
+	
+	CellStates states = unpack(*entry);
+	
+	if(entry->complete)
+	{
+		SortedArrayMap<H3Index, GeoValue>  buffer;
+		SortedArrayView<H3Index, GeoValue> geoValues = dataset->sortedGeoValues(&buffer);
+		Entry replaced = pack(dataset, dataset->resolution, true, geoValues.keys, geoValues.values, nullptr, geoValues.size());
+		
+		SortedArrayMap<H3Index, GeoValue> newGeoValues;
+		newGeoValues.keys   = std::move(states.indices);
+		newGeoValues.values = std::move(states.values);
+		dataset->replaceGeoValues(entry->resolution, std::move(newGeoValues));
+		*entry = std::move(replaced);
+		return change;
+	}
+	
+	assert(entry->resolution == dataset->resolution);
+	size_t count = states.indices.size();
+	
+	std::vector<GeoValue> currentValues(count, GeoValue{0});
+	std::vector<uint8_t>  currentPresent(count);
+	parallelFor(count, APPLY_MIN_RANGE_CELLS, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+			currentPresent[i] = dataset->findGeoValue(states.indices[i], &currentValues[i]);
+	});
+	Entry replaced = pack(dataset, dataset->resolution, false, states.indices.data(), currentValues.data(), currentPresent.data(), count);
+	
+	// Cells without a value are removed in one batch, the others are batched by value, so undoing an edit that set
+	// a single value takes a single batch
+	std::vector<H3Index> removedIndices;
+	std::vector<size_t>  updatedCells;
+	for(size_t i = 0; i < count; ++i)
+	{
+		if(states.present[i])
+			updatedCells.push_back(i);
+		else
+			removedIndices.push_back(states.indices[i]);
+	}
+	dataset->removeGeoValues(removedIndices.data(), removedIndices.size());
+	
+	// NOTE: Comparing the bits restores real values exactly
+	std::sort(updatedCells.begin(), updatedCells.end(), [&](size_t a, size_t b){ return states.values[a].integer < states.values[b].integer; });
+	std::vector<H3Index> batch;
+	for(size_t first = 0; first < updatedCells.size();)
+	{
+		GeoValue value = states.values[updatedCells[first]];
+		size_t   last  = first;
+		batch.clear();
+		while(last < updatedCells.size() && states.values[updatedCells[last]].integer == value.integer)
+			batch.push_back(states.indices[updatedCells[last++]]);
+		dataset->updateGeoValues(batch.data(), batch.size(), value);
+		first = last;
+	}
+	
+	*entry = std::move(replaced);
+	change.indices = std::move(states.indices);
+	return change;
+}
+
+
+// `indices` must be sorted. Null `present` means that every cell has a value
+EditJournal::Entry EditJournal::pack(Dataset* dataset, int resolution, bool complete, const H3Index* indices, const GeoValue* values, const uint8_t* present, size_t count)
+{
+	Entry entry;
+	entry.dataset    = dataset;
+	entry.resolution = resolution;
+	entry.complete   = complete;
+	entry.cellCount  = count;
+	entry.chunks.resize((count + CHUNK_CELLS - 1) / CHUNK_CELLS);
+	
+	bool compress = count >= COMPRESS_MIN_CELLS;
+	std::atomic<bool> failed(false);
+	parallelFor(entry.chunks.size(), 1, [&](size_t begin, size_t end)
+	{
+		for(size_t c = begin; c < end; ++c)
+		{
+			size_t first = c * CHUNK_CELLS;
+			size_t n     = std::min(CHUNK_CELLS, count - first);
+			
+			QByteArray bytes(int(n * (sizeof(H3Index) + sizeof(GeoValue)) + (n + 7) / 8), '\0');
+			char*      deltas = bytes.data();
+			char*      column = deltas + n * sizeof(H3Index);
+			char*      bits   = column + n * sizeof(GeoValue);
+			
+			H3Index previous = 0;
+			for(size_t i = 0; i < n; ++i)
+			{
+				H3Index delta = indices[first + i] - previous;
+				std::memcpy(deltas + i * sizeof(H3Index), &delta, sizeof(H3Index));
+				previous = indices[first + i];
+			}
+			std::memcpy(column, values + first, n * sizeof(GeoValue));
+			for(size_t i = 0; i < n; ++i)
+				if(!present || present[first + i])
+					bits[i / 8] |= char(1 << (i % 8));
+			
+			Chunk& chunk = entry.chunks[c];
+			chunk.count      = n;
+			chunk.compressed = compress;
+			chunk.bytes      = compress ? qCompress(bytes, COMPRESSION_LEVEL) : bytes;
+			if(chunk.bytes.isEmpty())
+				failed = true;
+		}
+	});
+	if(failed)
+		throw std::bad_alloc();
+	
+	entry.byteCount = sizeof(Entry);
+	for(const Chunk& chunk : entry.chunks)
+		entry.byteCount += sizeof(Chunk) + size_t(chunk.bytes.size());
+	return entry;
+}
+
+
+EditJournal::CellStates EditJournal::unpack(const Entry& entry)
+{
+	CellStates states;
+	states.indices.resize(entry.cellCount);
+	states.values.resize(entry.cellCount);
+	states.present.resize(entry.cellCount);
+	
+	std::atomic<bool> failed(false);
+	parallelFor(entry.chunks.size(), 1, [&](size_t begin, size_t end)
+	{
+		for(size_t c = begin; c < end; ++c)
+		{
+			const Chunk& chunk = entry.chunks[c];
+			size_t       first = c * CHUNK_CELLS;
+			size_t       n     = chunk.count;
+			
+			// NOTE: qUncompress() returns an empty array when it runs out of memory
+			QByteArray bytes = chunk.compressed ? qUncompress(chunk.bytes) : chunk.bytes;
+			if(size_t(bytes.size()) != n * (sizeof(H3Index) + sizeof(GeoValue)) + (n + 7) / 8)
+			{
+				failed = true;
+				continue;
+			}
+			const char* deltas = bytes.constData();
+			const char* column = deltas + n * sizeof(H3Index);
+			const char* bits   = column + n * sizeof(GeoValue);
+			
+			H3Index index = 0;
+			for(size_t i = 0; i < n; ++i)
+			{
+				H3Index delta;
+				std::memcpy(&delta, deltas + i * sizeof(H3Index), sizeof(H3Index));
+				index += delta;
+				states.indices[first + i] = index;
+			}
+			std::memcpy(states.values.data() + first, column, n * sizeof(GeoValue));
+			for(size_t i = 0; i < n; ++i)
+				states.present[first + i] = (bits[i / 8] >> (i % 8)) & 1;
+		}
+	});
+	if(failed)
+		throw std::bad_alloc();
+	
+	return states;
+}
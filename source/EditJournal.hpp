@@ -0,0 +1,103 @@
+#ifndef GIAGUI_EDITJOURNAL_HPP
+#define GIAGUI_EDITJOURNAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <QByteArray>
+#include <h3/h3api.h>
+
+#include "GeoValue.hpp"
+
+
+struct Dataset;
+
+
+// Undo and redo history of the values of datasets
+// An entry holds the state of each cell an edit changed, before the edit: whether the cell had a value, and which one.
+// Applying an entry writes those states back and keeps the states it overwrote in their place, so undoing an entry
+// turns it into its redo and vice versa, in time proportional to the number of cells in it
+struct EditJournal
+{
+	// Cells are packed in chunks of this many, each compressed on its own thread
+	static constexpr size_t CHUNK_CELLS        = 65536;
+	
+	// Entries with fewer cells are kept uncompressed, zlib would cost more time than the memory it saves is worth
+	static constexpr size_t COMPRESS_MIN_CELLS = 65536;
+	
+	static constexpr size_t DEFAULT_MAX_BYTES  = size_t(256) << 20;
+	
+	// Cell states as columns, in index order
+	struct CellStates
+	{
+		std::vector<H3Index>  indices;
+		std::vector<GeoValue> values;  // Undefined where `present` is 0
+		std::vector<uint8_t>  present;
+	};
+	
+	// Packed CellStates: index deltas, then values, then one presence bit per cell
+	struct Chunk
+	{
+		QByteArray bytes;
+		size_t     count      = 0;
+		bool       compressed = false;
+	};
+	
+	struct Entry
+	{
+		Dataset*           dataset    = nullptr;
+		int                resolution = 0;     // Resolution of the cells in the entry
+		bool               complete   = false; // Whether the cells are all the values of the dataset, see recordResolutionChange()
+		size_t             cellCount  = 0;
+		size_t             byteCount  = 0;
+		std::vector<Chunk> chunks;
+	};
+	
+	// What undo() or redo() did
+	struct Change
+	{
+		Dataset*             dataset       = nullptr; // Null if there was nothing to do
+		int                  oldResolution = 0;       // Differs from the resolution of the dataset when all of its values were replaced
+		std::vector<H3Index> indices;                 // Otherwise, the cells whose values changed
+	};
+	
+	
+	std::deque<Entry> undoEntries;                      // The next one to undo is at the back
+	std::deque<Entry> redoEntries;                      // The next one to redo is at the back
+	size_t            maxByteCount = DEFAULT_MAX_BYTES; // The farthest entries are dropped past this, see trim()
+	size_t            byteCount    = 0;
+	
+	
+	inline bool canUndo() const { return !undoEntries.empty(); }
+	inline bool canRedo() const { return !redoEntries.empty(); }
+	
+	// Call these right before the edit they describe, with the same arguments. Cells the edit does not change are left out
+	// NOTE: Recording a new edit drops the entries that could be redone
+	void recordRemoval(Dataset* dataset, const H3Index* indices, size_t count);
+	void recordUpdate(Dataset* dataset, const H3Index* indices, size_t count, GeoValue newValue);
+	
+	// Call right before all the values of the dataset are replaced by values at another resolution
+	void recordResolutionChange(Dataset* dataset);
+	
+	Change undo();
+	Change redo();
+	
+	// Drops the entries of a dataset, call it before deleting the dataset
+	void forget(Dataset* dataset);
+	void clear();
+
+
+protected:
+	void   record(Dataset* dataset, const H3Index* indices, size_t count, const GeoValue* newValue);
+	void   push(Entry&& entry);
+	void   trim();
+	Change applyLast(std::deque<Entry>* from, std::deque<Entry>* to);
+	Change apply(Entry* entry);
+	
+	static Entry      pack(Dataset* dataset, int resolution, bool complete, const H3Index* indices, const GeoValue* values, const uint8_t* present, size_t count);
+	static CellStates unpack(const Entry& entry);
+};
+
+
+#endif //GIAGUI_EDITJOURNAL_HPP
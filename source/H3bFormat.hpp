@@ -0,0 +1,255 @@
+#ifndef GIAGUI_H3BFORMAT_HPP
+#define GIAGUI_H3BFORMAT_HPP
+
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Binary dataset format (.h3b), the columnar counterpart of the TOML+H3 files
+// Loading is a bulk read of two arrays, no per-cell parsing. The layout is
+//
+//     H3bHeader
+//     name      `nameSize` bytes of UTF-8, zero padded to a multiple of 8
+//     indices   `count` uint64, ascending. With H3B_FLAG_DELTA_INDICES they are instead the differences between
+//               consecutive indices (the first from 0) as LEB128 varints, zero padded to a multiple of 8.
+//               Either way the column takes `indicesSize` bytes
+//     values    `count` values of `type`: int64 for "1i", double for "1f", 3 doubles for "3f"
+//
+// NOTE: Everything is little endian and read with memcpy, so this only builds on little endian hosts
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The .h3b format is only implemented for little endian hosts");
+
+
+#define H3B_MAGIC               "H3B\x1A"
+#define H3B_VERSION             2 // Version 1 had no color scale and an 80 byte header
+#define H3B_FLAG_DELTA_INDICES  0x01
+
+
+struct H3bHeader
+{
+	char     magic[4];        // H3B_MAGIC
+	uint32_t version;         // H3B_VERSION
+	char     type[4];         // Same as `h3.type` in TOML files, zero padded
+	uint8_t  resolution;
+	uint8_t  flags;           // H3B_FLAG_*
+	uint8_t  aggregation;     // Dataset::Aggregation, only meaningful to giagui
+	uint8_t  reserved0;
+	uint32_t nameSize;
+	uint32_t reserved1;
+	uint64_t count;
+	uint64_t indicesSize;
+	uint8_t  defaultValue[24]; // One value of `type`
+	double   density;          // NaN if the dataset has no density
+	uint8_t  minValue[8];      // Range of the color scale for "1i" and "1f", only meaningful to giagui
+	uint8_t  maxValue[8];
+};
+static_assert(sizeof(H3bHeader) == 88, "H3bHeader must not have padding");
+
+
+inline size_t h3bPadding(size_t size)
+{
+	return (8 - size % 8) % 8;
+}
+
+
+// Size in bytes of a value of `type`, 0 if the type is unknown
+inline size_t h3bValueSize(const char* type)
+{
+	if(std::strcmp(type, "1i") == 0 || std::strcmp(type, "1f") == 0)
+		return 8;
+	if(std::strcmp(type, "3f") == 0)
+		return 24;
+	return 0;
+}
+
+
+// Fills the fixed fields of a header, the others are left zeroed
+inline H3bHeader h3bMakeHeader(const char* type, int resolution, uint64_t count)
+{
+	H3bHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, H3B_MAGIC, 4);
+	std::strncpy(header.type, type, sizeof(header.type));
+	header.version    = H3B_VERSION;
+	header.resolution = (uint8_t)resolution;
+	header.count      = count;
+	header.density    = std::numeric_limits<double>::quiet_NaN();
+	return header;
+}
+
+
+// Offset of the index column from the start of the file, always a multiple of 8
+inline uint64_t h3bIndicesOffset(const H3bHeader& header)
+{
+	return sizeof(H3bHeader) + header.nameSize + h3bPadding(header.nameSize);
+}
+
+
+// Offset of the value column from the start of the file, always a multiple of 8
+inline uint64_t h3bValuesOffset(const H3bHeader& header)
+{
+	return h3bIndicesOffset(header) + header.indicesSize;
+}
+
+
+// True if the stream starts with H3B_MAGIC. The stream is rewound
+inline bool h3bIsBinary(std::istream& stream)
+{
+	char magic[4] = {0};
+	stream.read(magic, 4);
+	bool result = stream.gcount() == 4 && std::memcmp(magic, H3B_MAGIC, 4) == 0;
+	stream.clear();
+	stream.seekg(0);
+	return result;
+}
+
+
+// Reads the header and the name, and leaves the stream at the indices
+inline bool h3bReadHeader(std::istream& stream, H3bHeader* outHeader, std::string* outName, std::string* outError)
+{
+	H3bHeader& header = *outHeader;
+	stream.read((char*)&header, sizeof(header));
+	if(!stream || std::memcmp(header.magic, H3B_MAGIC, 4) != 0)
+	{
+		*outError = "not a .h3b file";
+		return false;
+	}
+	if(header.version != H3B_VERSION)
+	{
+		*outError = "unsupported .h3b version " + std::to_string(header.version);
+		return false;
+	}
+	header.type[sizeof(header.type) - 1] = 0;
+	if(h3bValueSize(header.type) == 0)
+	{
+		*outError = std::string("unsupported value type '") + header.type + "'";
+		return false;
+	}
+	// NOTE: The division keeps a huge count from overflowing into a matching size
+	if((header.flags & H3B_FLAG_DELTA_INDICES) == 0 && (header.indicesSize % sizeof(uint64_t) != 0 || header.indicesSize / sizeof(uint64_t) != header.count))
+	{
+		*outError = "index column size does not match the cell count";
+		return false;
+	}
+	
+	outName->resize(header.nameSize);
+	stream.read(outName->data(), header.nameSize);
+	stream.ignore(h3bPadding(header.nameSize));
+	if(!stream)
+	{
+		*outError = "file is truncated";
+		return false;
+	}
+	return true;
+}
+
+
+// Reads `header.count` indices into `outIndices`
+inline bool h3bReadIndices(std::istream& stream, const H3bHeader& header, uint64_t* outIndices, std::string* outError)
+{
+	if((header.flags & H3B_FLAG_DELTA_INDICES) == 0)
+	{
+		stream.read((char*)outIndices, header.count * sizeof(uint64_t));
+		if(!stream)
+		{
+			*outError = "file is truncated";
+			return false;
+		}
+		return true;
+	}
+	
+	std::vector<uint8_t> bytes(header.indicesSize);
+	stream.read((char*)bytes.data(), bytes.size());
+	if(!stream)
+	{
+		*outError = "file is truncated";
+		return false;
+	}
+	
+	const uint8_t* p   = bytes.data();
+	const uint8_t* end = bytes.data() + bytes.size();
+	uint64_t index = 0;
+	for(uint64_t i = 0; i < header.count; ++i)
+	{
+		uint64_t delta = 0;
+		for(int shift = 0; ; shift += 7)
+		{
+			if(p == end || shift > 63)
+			{
+				*outError = "index column is corrupted";
+				return false;
+			}
+			uint8_t byte = *p++;
+			delta |= uint64_t(byte & 0x7F) << shift;
+			if((byte & 0x80) == 0)
+				break;
+		}
+		index += delta;
+		outIndices[i] = index;
+	}
+	return true;
+}
+
+
+// Reads `header.count` values of `header.type` into `outValues`
+inline bool h3bReadValues(std::istream& stream, const H3bHeader& header, void* outValues, std::string* outError)
+{
+	stream.read((char*)outValues, header.count * h3bValueSize(header.type));
+	if(!stream)
+	{
+		*outError = "file is truncated";
+		return false;
+	}
+	return true;
+}
+
+
+// Writes a whole file. `indices` must be ascending, `values` holds `header.count` values of `header.type`
+// `header.nameSize` and `header.indicesSize` are filled in from the arguments
+inline void h3bWrite(std::ostream& stream, H3bHeader header, const std::string& name, const uint64_t* indices, const void* values)
+{
+	static const char zeros[8] = {0};
+	
+	std::vector<uint8_t> deltas;
+	if(header.flags & H3B_FLAG_DELTA_INDICES)
+	{
+		deltas.reserve(header.count * 3);
+		uint64_t previous = 0;
+		for(uint64_t i = 0; i < header.count; ++i)
+		{
+			uint64_t delta = indices[i] - previous;
+			previous = indices[i];
+			do
+			{
+				uint8_t byte = delta & 0x7F;
+				delta >>= 7;
+				deltas.push_back(byte | (delta ? 0x80 : 0));
+			} while(delta);
+		}
+		deltas.resize(deltas.size() + h3bPadding(deltas.size()), 0);
+		header.indicesSize = deltas.size();
+	}
+	else
+	{
+		header.indicesSize = header.count * sizeof(uint64_t);
+	}
+	header.nameSize = (uint32_t)name.size();
+	
+	stream.write((const char*)&header, sizeof(header));
+	stream.write(name.data(), name.size());
+	stream.write(zeros, h3bPadding(name.size()));
+	if(header.flags & H3B_FLAG_DELTA_INDICES)
+		stream.write((const char*)deltas.data(), deltas.size());
+	else
+		stream.write((const char*)indices, header.indicesSize);
+	stream.write((const char*)values, header.count * h3bValueSize(header.type));
+}
+
+
+#endif //GIAGUI_H3BFORMAT_HPP
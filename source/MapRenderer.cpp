@@ -0,0 +1,248 @@
+#include "MapRenderer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <QPainter>
+#include <QSvgRenderer>
+#include <QTransform>
+
+#include "Dataset.hpp"
+#include "MapUtils.hpp"
+#include "Parallel.hpp"
+
+
+#define LOD_MAX_CELL_PIXELS 1.0  // Area, in square pixels, below which cells are replaced by their parents
+#define STRIP_MIN_CELLS     4096 // Fewer cells are drawn on the calling thread, splitting them would cost more than it saves
+
+
+void MapRenderer::reset(QSizeF surfaceSize)
+{
+	this->surfaceSize = surfaceSize;
+	culler.reset(surfaceSize);
+}
+
+
+// NOTE: Cells are drawn with translucent colors, so a parent smaller than a pixel is indistinguishable from its children
+int MapRenderer::lodResolution(const Dataset* dataset, QSizeF surfaceSize, double pixelsPerUnit)
+{
+	double mapPixels = surfaceSize.width() * surfaceSize.height() * pixelsPerUnit * pixelsPerUnit;
+	
+	int result = dataset->resolution;
+	while(result > 0 && mapPixels / double(h3DenseSlotCount(result - 1)) < LOD_MAX_CELL_PIXELS)
+		result -= 1;
+	return result;
+}
+
+
+const SortedArrayMap<H3Index, GeoValue>* MapRenderer::prepareLod(Dataset* dataset, int lodResolution)
+{
+	if(lodResolution >= dataset->resolution)
+		return nullptr;
+	return &dataset->lodGeoValues(lodResolution);
+}
+
+
+void MapRenderer::getGeometry(H3Index index, CellGeometry* outGeometry)
+{
+	if(geometryCache)
+		geometryCache->get(index, outGeometry);
+	else
+		computeCellGeometry(index, surfaceSize, outGeometry);
+}
+
+
+void MapRenderer::bucketCells(const Dataset* dataset, const SortedArrayMap<H3Index, GeoValue>* lodValues, const QRectF& area)
+{
+	assert(colorLookup);
+	culler.setVisibleRect(area);
+	buckets.unsortedIndices.clear();
+	buckets.unsortedBins.clear();
+	
+	auto push = [&](H3Index index, int bin)
+	{
+		assert(index != H3_INVALID_INDEX);
+		if(!culler.isVisible(index))
+		{
+			culledCount += 1;
+			return;
+		}
+		
+		drawnCount += 1;
+		buckets.unsortedIndices.push_back(index);
+		buckets.unsortedBins.push_back(uint16_t(bin));
+	};
+	
+	// Values stored in contiguous arrays are binned in one vectorized pass, the others one at a time
+	SortedArrayView<H3Index, GeoValue> column;
+	if(lodValues)
+		column = lodValues->view();
+	else
+	if(dataset->storage == Dataset::Storage::Frozen || dataset->storage == Dataset::Storage::Mapped)
+		column = dataset->sortedGeoValues(nullptr);
+	
+	if(!column.empty())
+	{
+		buckets.columnBins.resize(column.size());
+		colorLookup->binValues(column.values, column.size(), dataset->isInteger, buckets.columnBins.data());
+		for(size_t i = 0; i < column.size(); ++i)
+			push(column.keys[i], buckets.columnBins[i]);
+	}
+	else
+	if(!lodValues && dataset->isInteger)
+	{
+		dataset->forEachGeoValue([&](H3Index index, GeoValue geoValue) { push(index, colorLookup->bin(double(geoValue.integer))); });
+	}
+	else
+	if(!lodValues)
+	{
+		dataset->forEachGeoValue([&](H3Index index, GeoValue geoValue) { push(index, colorLookup->bin(geoValue.real)); });
+	}
+	
+	// Counting sort by bin
+	std::fill(buckets.offsets, buckets.offsets + ColorLookup::BINS + 1, 0);
+	for(uint16_t bin : buckets.unsortedBins)
+		buckets.offsets[bin + 1] += 1;
+	for(int bin = 0; bin < ColorLookup::BINS; ++bin)
+		buckets.offsets[bin + 1] += buckets.offsets[bin];
+	
+	uint32_t cursors[ColorLookup::BINS];
+	std::copy(buckets.offsets, buckets.offsets + ColorLookup::BINS, cursors);
+	buckets.indices.resize(buckets.unsortedIndices.size());
+	for(size_t i = 0; i < buckets.unsortedIndices.size(); ++i)
+		buckets.indices[cursors[buckets.unsortedBins[i]]++] = buckets.unsortedIndices[i];
+}
+
+
+void MapRenderer::drawBuckets(QPainter* painter)
+{
+	painter->setPen(Qt::PenStyle::NoPen);
+	
+	CellGeometry geometry;
+	for(int bin = 0; bin < ColorLookup::BINS; ++bin)
+	{
+		uint32_t begin = buckets.offsets[bin];
+		uint32_t end   = buckets.offsets[bin + 1];
+		if(begin == end)
+			continue;
+		
+		painter->setBrush(colorLookup->brushes[bin]);
+		for(uint32_t i = begin; i < end; ++i)
+		{
+			getGeometry(buckets.indices[i], &geometry);
+			drawCellGeometry(painter, geometry);
+		}
+	}
+}
+
+
+void MapRenderer::drawCells(QPainter* painter, const Dataset* dataset, const SortedArrayMap<H3Index, GeoValue>* lodValues, const QRectF& area)
+{
+	bucketCells(dataset, lodValues, area);
+	drawBuckets(painter);
+}
+
+
+void MapRenderer::drawCellsInStrips(QPainter* painter, const Dataset* dataset, const SortedArrayMap<H3Index, GeoValue>* lodValues, const QRectF& area, int stripCount)
+{
+	bucketCells(dataset, lodValues, area);
+	
+	// NOTE: On high DPI displays the device pixel ratio is not part of the world transform
+	QPaintDevice* device           = painter->device();
+	double        devicePixelRatio = device->devicePixelRatioF();
+	QTransform    toDevice         = painter->worldTransform() * QTransform::fromScale(devicePixelRatio, devicePixelRatio);
+	QRect         deviceRect       = toDevice.mapRect(area).toAlignedRect() & QRect(0, 0, int(std::ceil(device->width() * devicePixelRatio)), int(std::ceil(device->height() * devicePixelRatio)));
+	
+	stripCount = std::min(stripCount, deviceRect.height());
+	if(stripCount <= 1 || buckets.indices.size() < STRIP_MIN_CELLS)
+	{
+		drawBuckets(painter);
+		return;
+	}
+	
+	// NOTE: Strip threads can only find() outlines, so the ones that are missing are stored up front
+	if(geometryCache)
+		geometryCache->fill(buckets.indices.data(), buckets.indices.size());
+	
+	// Each strip is drawn into its own image. Cells on the border between strips are drawn by both, each clipped
+	QTransform             toMap       = toDevice.inverted();
+	QPainter::RenderHints  renderHints = painter->renderHints();
+	std::vector<QImage>    strips(size_t(stripCount));
+	auto stripTop = [&](size_t strip) { return deviceRect.top() + int(size_t(deviceRect.height()) * strip / size_t(stripCount)); };
+	parallelFor(size_t(stripCount), 1, [&](size_t begin, size_t end)
+	{
+		CellCuller   stripCuller = culler;
+		CellGeometry geometry;
+		for(size_t strip = begin; strip < end; ++strip)
+		{
+			QRect stripRect(deviceRect.left(), stripTop(strip), deviceRect.width(), stripTop(strip + 1) - stripTop(strip));
+			stripCuller.setVisibleRect(toMap.mapRect(QRectF(stripRect)) & area);
+			strips[strip] = QImage(stripRect.size(), QImage::Format_ARGB32_Premultiplied);
+			strips[strip].fill(Qt::transparent);
+			
+			QPainter stripPainter(&strips[strip]);
+			stripPainter.setRenderHints(renderHints);
+			stripPainter.setTransform(toDevice * QTransform::fromTranslate(-stripRect.left(), -stripRect.top()));
+			stripPainter.setPen(Qt::PenStyle::NoPen);
+			for(int bin = 0; bin < ColorLookup::BINS; ++bin)
+			{
+				bool brushIsSet = false;
+				for(uint32_t i = buckets.offsets[bin]; i < buckets.offsets[bin + 1]; ++i)
+				{
+					H3Index index = buckets.indices[i];
+					if(!stripCuller.isVisible(index))
+						continue;
+					
+					if(!brushIsSet)
+					{
+						stripPainter.setBrush(colorLookup->brushes[bin]);
+						brushIsSet = true;
+					}
+					if(!geometryCache || !geometryCache->find(index, &geometry))
+						computeCellGeometry(index, surfaceSize, &geometry);
+					drawCellGeometry(&stripPainter, geometry);
+				}
+			}
+		}
+	});
+	
+	// Strips are in device pixels, so they are drawn without the world transform
+	painter->save();
+	painter->resetTransform();
+	for(int strip = 0; strip < stripCount; ++strip)
+	{
+		strips[strip].setDevicePixelRatio(devicePixelRatio);
+		painter->drawImage(QPointF(deviceRect.left(), stripTop(strip)) / devicePixelRatio, strips[strip]);
+	}
+	painter->restore();
+}
+
+
+QImage renderDatasetImage(Dataset* dataset, QSize size, Colormap colormap, int stripCount)
+{
+	assert(!size.isEmpty());
+	
+	ColorLookup colorLookup;
+	colorLookup.setColormap(colormap);
+	double minValue;
+	double maxValue;
+	dataset->colorRange(&minValue, &maxValue);
+	colorLookup.setRange(minValue, maxValue);
+	
+	// One map unit is one pixel of the image
+	QSizeF surfaceSize   = QSizeF(size);
+	int    lodResolution = MapRenderer::lodResolution(dataset, surfaceSize, 1.0);
+	
+	MapRenderer renderer;
+	renderer.colorLookup = &colorLookup;
+	renderer.reset(surfaceSize);
+	
+	QImage image(size, QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::white);
+	
+	QPainter painter(&image);
+	QSvgRenderer(QString::fromUtf8(":/images/world.svg")).render(&painter, QRectF(QPointF(0, 0), surfaceSize));
+	renderer.drawCellsInStrips(&painter, dataset, MapRenderer::prepareLod(dataset, lodResolution), QRectF(QPointF(0, 0), surfaceSize), stripCount);
+	painter.end();
+	return image;
+}
@@ -0,0 +1,82 @@
+#ifndef GIAGUI_MAPRENDERER_HPP
+#define GIAGUI_MAPRENDERER_HPP
+
+#include <cstdint>
+#include <vector>
+#include <QImage>
+#include <QRectF>
+#include <QSize>
+#include <QSizeF>
+#include <h3/h3api.h>
+
+#include "CellCuller.hpp"
+#include "CellGeometryCache.hpp"
+#include "ColorLookup.hpp"
+#include "Containers.hpp"
+#include "GeoValue.hpp"
+
+
+class QPainter;
+
+struct Dataset;
+
+
+// Draws the cells of a dataset with QPainter, the same way on screen (see MapView) and into images
+// A renderer is used by one thread at a time. Threads drawing in parallel need one each, see renderDatasetImage()
+struct MapRenderer
+{
+	// Visible cells of the last bucketCells(), sorted by color bin. Kept to reuse the allocations
+	struct ColorBuckets
+	{
+		std::vector<H3Index>  indices;         // Cells of bin b are in [offsets[b], offsets[b+1])
+		uint32_t              offsets[ColorLookup::BINS + 1];
+		std::vector<H3Index>  unsortedIndices;
+		std::vector<uint16_t> unsortedBins;
+		std::vector<uint16_t> columnBins;
+	};
+	static_assert(ColorLookup::BINS <= 65536, "Bins are stored in 16 bits");
+	
+	
+	QSizeF             surfaceSize;
+	const ColorLookup* colorLookup   = nullptr;
+	CellGeometryCache* geometryCache = nullptr; // Optional. Outlines missing from it are projected every time
+	CellCuller         culler;
+	ColorBuckets       buckets;
+	size_t             drawnCount    = 0;       // Cells drawn and culled since these were last set to zero
+	size_t             culledCount   = 0;
+	
+	
+	void reset(QSizeF surfaceSize);
+	
+	// Coarsest resolution, no finer than the dataset, at which cells are still smaller than a pixel
+	static int lodResolution(const Dataset* dataset, QSizeF surfaceSize, double pixelsPerUnit);
+	
+	// Values to draw at `lodResolution`, or null to draw the values of the dataset itself
+	// NOTE: This brings the level of detail up to date, so call it once before handing the values to drawing threads
+	static const SortedArrayMap<H3Index, GeoValue>* prepareLod(Dataset* dataset, int lodResolution);
+	
+	void getGeometry(H3Index index, CellGeometry* outGeometry);
+	
+	// Groups the cells that may be visible in `area` by color bin, into `buckets`
+	void bucketCells(const Dataset* dataset, const SortedArrayMap<H3Index, GeoValue>* lodValues, const QRectF& area);
+	
+	// Draws the cells that may be visible in `area`, each color bin with a single brush change
+	void drawCells(QPainter* painter, const Dataset* dataset, const SortedArrayMap<H3Index, GeoValue>* lodValues, const QRectF& area);
+	
+	// Same as drawCells(), but the device pixels covering `area` are split in `stripCount` horizontal strips, each
+	// rasterized into its own image on the global thread pool and then drawn with `painter`
+	// NOTE: Cells are binned once on the calling thread. Strip threads only read the geometry cache, see CellGeometryCache::find()
+	void drawCellsInStrips(QPainter* painter, const Dataset* dataset, const SortedArrayMap<H3Index, GeoValue>* lodValues, const QRectF& area, int stripCount);
+
+protected:
+	// Draws the cells grouped by the last bucketCells() on the calling thread
+	void drawBuckets(QPainter* painter);
+};
+
+
+// Renders the world map and the cells of `dataset` into an image of `size` pixels, for use without any window
+// The image is split in `stripCount` horizontal strips, see MapRenderer::drawCellsInStrips()
+QImage renderDatasetImage(Dataset* dataset, QSize size, Colormap colormap, int stripCount);
+
+
+#endif //GIAGUI_MAPRENDERER_HPP
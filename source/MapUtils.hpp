@@ -63,6 +63,57 @@
 #define H3_INVALID_INDEX 0
 #endif
 
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/constants.h
+#ifndef MAX_H3_RES
+#define MAX_H3_RES 15
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_RES_OFFSET
+#define H3_RES_OFFSET 52
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_RES_MASK
+#define H3_RES_MASK 0b0000000011110000000000000000000000000000000000000000000000000000
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_PER_DIGIT_OFFSET
+#define H3_PER_DIGIT_OFFSET 3
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_DIGIT_MASK
+#define H3_DIGIT_MASK 7
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_SET_RESOLUTION
+#define H3_SET_RESOLUTION(i, r) ( ((i) & (~H3_RES_MASK)) | (((uint64_t)(r)) << H3_RES_OFFSET) )
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_GET_RESOLUTION
+#define H3_GET_RESOLUTION(i) ( (int)(((i) & H3_RES_MASK) >> H3_RES_OFFSET) )
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_GET_BASE_CELL
+#define H3_GET_BASE_CELL(i) ( (int)(((i) & H3_BC_MASK) >> H3_BC_OFFSET) )
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_GET_INDEX_DIGIT
+#define H3_GET_INDEX_DIGIT(i, r) ( (int)(((i) >> ((MAX_H3_RES - (r)) * H3_PER_DIGIT_OFFSET)) & H3_DIGIT_MASK) )
+#endif
+
+// https://github.com/uber/h3/blob/5a55394937466f6d8b50e2da62813db29f40bdd0/src/h3lib/include/h3Index.h
+#ifndef H3_SET_INDEX_DIGIT
+#define H3_SET_INDEX_DIGIT(i, r, d) ( ((i) & ~(((uint64_t)H3_DIGIT_MASK) << ((MAX_H3_RES - (r)) * H3_PER_DIGIT_OFFSET))) \
+                                    | (((uint64_t)(d)) << ((MAX_H3_RES - (r)) * H3_PER_DIGIT_OFFSET)) )
+#endif
+
 // https://uber.github.io/h3/#/documentation/core-library/resolution-table
 #ifndef MAX_SUPPORTED_RESOLUTION
 #define MAX_SUPPORTED_RESOLUTION 6
@@ -70,12 +121,13 @@
 
 
 #define IS_VALID_RESOLUTION(r) ( 0 <= (r) && (r) <= MAX_SUPPORTED_RESOLUTION )
-#define POLYFILL_INDEX_THRESHOLD 100000
+#define POLYFILL_CHUNK_INDICES 50000 // Cells polyfilled by each task of the grid tool, roughly
 #define UI_DOUBLE_PRECISION 6
 #define UI_MULTIPLE_GEOVALUES_STRING "—"
 
 
-constexpr double DOUBLE_MAX = std::numeric_limits<double>::max();
+constexpr double DOUBLE_MAX      = std::numeric_limits<double>::max();
+constexpr double DOUBLE_INFINITY = std::numeric_limits<double>::infinity();
 
 
 inline
@@ -138,6 +190,117 @@ uint64_t h3MaxChildrenCount(int parentRes, int childRes)
 }
 
 
+// Number of children `parent` actually has at `childRes`. Unlike h3MaxChildrenCount() this accounts for pentagons,
+// which have 6 children at each level instead of 7
+inline
+uint64_t h3ChildrenCount(H3Index parent, int childRes)
+{
+	uint64_t maxChildrenCount = h3MaxChildrenCount(h3GetResolution(parent), childRes);
+	if(h3IsPentagon(parent))
+		return 1 + 5 * (maxChildrenCount - 1) / 6;
+	return maxChildrenCount;
+}
+
+
+// Area of the cell on the unit sphere, in steradians. Multiply by the squared radius for an actual area
+// The boundary is split in triangles around the cell center, the area of each is its spherical excess
+// https://en.wikipedia.org/wiki/Spherical_trigonometry#Area_and_spherical_excess
+inline
+double h3CellArea(H3Index index)
+{
+	auto toVector = [](GeoCoord coord, double* v)
+	{
+		v[0] = std::cos(coord.lat) * std::cos(coord.lon);
+		v[1] = std::cos(coord.lat) * std::sin(coord.lon);
+		v[2] = std::sin(coord.lat);
+	};
+	
+	GeoCoord centerCoord;
+	h3ToGeo(index, &centerCoord);
+	GeoBoundary boundary;
+	h3ToGeoBoundary(index, &boundary);
+	
+	double a[3];
+	toVector(centerCoord, a);
+	
+	double area = 0;
+	for(int i = 0; i < boundary.numVerts; ++i)
+	{
+		double b[3];
+		double c[3];
+		toVector(boundary.verts[i], b);
+		toVector(boundary.verts[(i+1) % boundary.numVerts], c);
+		
+		// tan(E/2) = |a . (b x c)| / (1 + a.b + b.c + c.a)
+		double triple = a[0] * (b[1]*c[2] - b[2]*c[1])
+		              + a[1] * (b[2]*c[0] - b[0]*c[2])
+		              + a[2] * (b[0]*c[1] - b[1]*c[0]);
+		double denominator = 1 + (a[0]*b[0] + a[1]*b[1] + a[2]*b[2])
+		                       + (b[0]*c[0] + b[1]*c[1] + b[2]*c[2])
+		                       + (c[0]*a[0] + c[1]*a[1] + c[2]*a[2]);
+		area += 2 * std::atan2(std::abs(triple), denominator);
+	}
+	return area;
+}
+
+
+// Number of H3 base cells, i.e. res0IndexCount()
+#define H3_BASE_CELL_COUNT 122
+
+
+// Size of an array that has a slot for each cell at `resolution`, see h3ToDenseSlot()
+// NOTE: Pentagons have no children along the deleted K axis, so about 1.6% of the slots are never used
+inline
+uint64_t h3DenseSlotCount(int resolution)
+{
+	assert(IS_VALID_RESOLUTION(resolution));
+	return uint64_t(H3_BASE_CELL_COUNT) * uint64_t(powi(7, (int8_t)resolution));
+}
+
+
+// Whether h3ToDenseSlot() can place `index` in an array of `resolution` cells. Indices of another resolution have
+// unused digits, and corrupt ones bad digits or base cells, either would land outside of the array
+inline
+bool h3HasDenseSlot(H3Index index, int resolution)
+{
+	return h3IsValid(index) && h3GetResolution(index) == resolution;
+}
+
+
+// Position of `index` in an array that has a slot for each cell at the resolution of `index`
+// The position is the base cell followed by the index digits, read as a base 7 number. This is the same order as the
+// indices themselves, so iterating the array in order visits the cells in ascending index order
+inline
+uint64_t h3ToDenseSlot(H3Index index, int resolution)
+{
+	assert(IS_VALID_RESOLUTION(resolution));
+	assert(h3HasDenseSlot(index, resolution));
+	uint64_t slot = H3_GET_BASE_CELL(index);
+	for(int r = 1; r <= resolution; ++r)
+		slot = slot * 7 + H3_GET_INDEX_DIGIT(index, r);
+	return slot;
+}
+
+
+// Inverse of h3ToDenseSlot()
+inline
+H3Index h3FromDenseSlot(uint64_t slot, int resolution)
+{
+	assert(IS_VALID_RESOLUTION(resolution));
+	assert(slot < h3DenseSlotCount(resolution));
+	H3Index index = H3_INIT;
+	index = H3_SET_MODE(index, H3_HEXAGON_MODE);
+	index = H3_SET_RESOLUTION(index, resolution);
+	for(int r = resolution; r >= 1; --r)
+	{
+		index = H3_SET_INDEX_DIGIT(index, r, slot % 7);
+		slot /= 7;
+	}
+	index = H3_SET_BASE_CELL(index, slot);
+	return index;
+}
+
+
 inline
 bool edgeCrossesAntimeridian(double a_lon, double b_lon)
 {
@@ -2,17 +2,25 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <QKeyEvent>
 #include <QCloseEvent>
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QScrollBar>
+#include <QElapsedTimer>
 #include <QGraphicsSvgItem>
+#include <QPainter>
+#include <QThreadPool>
 
 #include "Dataset.hpp"
+#include "Parallel.hpp"
 
 
 #define POLYFILL_WIDTH_FACTOR 0.45
+#define REPAINT_MAX_CELLS     4096  // Past this many dirty cells the whole view is repainted, bounding each one would cost more
+#define REPAINT_MARGIN_PIXELS 8.0   // Covers the cosmetic pens of the highlighted cells, see drawForeground()
+#define INVALIDATE_MAX_CELLS  65536 // Past this many edited cells all tiles are dropped, bounding each one on every level would cost more
 
 
 inline
@@ -24,261 +32,113 @@ float getLineThickness(int resolution)
 }
 
 
-GeoCoord getEasternAntimeridianCrossingPoint(const GeoCoord& east, const GeoCoord& west)
+int MapView::lodResolution(double pixelsPerUnit) const
 {
-	assert(east.lon >= 0.0);
-	assert(west.lon <= 0.0);
-	
-	GeoCoord anti; // antimeridian crossing point
-	anti.lon = PI; // we always draw the eastern segment first because I like it this way
-	
-	// Compute longitude `WEST` (move `west` by one full globe in the direction of the prime meridian) 
-	// Basically, we remap the longitude of `west` from [-180, 0] to [180, 360]
-	// On the globe, `WEST` has the same angular distance from `east` as the original `west`, and computing the length by difference is correct
-	double WEST_lon = west.lon + 2*PI;
-	double east2anti_longitude_len = anti.lon - east.lon;
-	double east2west_longitude_len = WEST_lon - west.lon;
-	
-	// Compute latitude by linear interpolation
-	// c = a + t*(b-a)    =>    t = (c-a) / (b-a)
-	double t = east2anti_longitude_len / east2west_longitude_len;
-	anti.lat = east.lat + t * (west.lat - east.lat);
-	
-	return anti;
+	return MapRenderer::lodResolution(dataset, mapSize(), pixelsPerUnit);
 }
 
 
-void drawBoundaryEdgesAntimeridian(QPainter* painter, GeoBoundary* geoBoundary, QSizeF surfaceSize)
+void MapView::drawDatasetTiles(QPainter* painter, const QRectF& area, int level)
 {
-	for(int i = 0; i < geoBoundary->numVerts; ++i)
-	{
-		const GeoCoord& p = geoBoundary->verts[i];
-		const GeoCoord& q = geoBoundary->verts[(i+1) % geoBoundary->numVerts];
-		
-		if(edgeCrossesAntimeridian(p.lon, q.lon))
-		{
-			const GeoCoord& east = p.lon > 0 ? p : q;
-			const GeoCoord& west = p.lon > 0 ? q : p;
-			GeoCoord anti = getEasternAntimeridianCrossingPoint(east, west);
-			
-			painter->drawLine(QLineF(toMapCoord(east, surfaceSize), toMapCoord(anti, surfaceSize)));
-			anti.lon = -anti.lon;
-			painter->drawLine(QLineF(toMapCoord(west, surfaceSize), toMapCoord(anti, surfaceSize)));
-		}
-		else
-		{
-			QLineF line(toMapCoord(p, surfaceSize), toMapCoord(q, surfaceSize));
-			painter->drawLine(line);
-		}
-	}
-}
-
-
-void drawBoundaryEdges(QPainter* painter, GeoBoundary* geoBoundary, QSizeF surfaceSize)
-{
-	if(!polyCrossesAntimeridian(geoBoundary))
-	{
-		QPointF points[MAX_CELL_BNDRY_VERTS];
-		for(int i = 0; i < geoBoundary->numVerts; ++i)
-			points[i] = toMapCoord(geoBoundary->verts[i], surfaceSize);
-		painter->drawConvexPolygon(points, geoBoundary->numVerts);
-	}
-	else
+	double extent    = tileCache.tileExtent(level);
+	int    minColumn = std::max(0,                               int(std::floor(area.left()   / extent)));
+	int    maxColumn = std::min(tileCache.columnCount(level) - 1, int(std::floor(area.right()  / extent)));
+	int    minRow    = std::max(0,                               int(std::floor(area.top()    / extent)));
+	int    maxRow    = std::min(tileCache.rowCount(level) - 1,    int(std::floor(area.bottom() / extent)));
+	if(minColumn > maxColumn || minRow > maxRow)
+		return;
+	
+	// Tiles missing from the cache are rendered together: the dataset is bucketed once for all of them, then each tile
+	// is drawn on its own thread from the shared buckets
+	struct PendingTile
 	{
-		drawBoundaryEdgesAntimeridian(painter, geoBoundary, surfaceSize);
-	}
-}
-
-
-void drawBoundaryPolar(QPainter* painter, GeoBoundary* geoBoundary, QSizeF surfaceSize)
-{
-	QPointF points[MAX_CELL_BNDRY_VERTS+4];
-	int     pointsCount = 0;
-	for(int i = 0; i < geoBoundary->numVerts; ++i)
+		int    column;
+		int    row;
+		QImage image;
+	};
+	
+	std::vector<PendingTile> pending;
+	QRectF                   pendingArea;
+	for(int row = minRow; row <= maxRow; ++row)
 	{
-		const GeoCoord& p = geoBoundary->verts[i];
-		points[pointsCount++] = toMapCoord(p, surfaceSize);
-		
-		const GeoCoord& q = geoBoundary->verts[(i+1) % geoBoundary->numVerts];
-		if(edgeCrossesAntimeridian(p.lon, q.lon))
+		for(int column = minColumn; column <= maxColumn; ++column)
 		{
-#if 0
-			// c = p + t*(q-p) -> t = (c-p)/(q-p)
-			double t;
-			if(q.lon < 0)
-			{
-				double q_lon = q.lon + 2*PI;
-				t = ( PI - p.lon) / (q_lon - p.lon);
-			}
-			else
-			{
-				double q_lon = q.lon - 2*PI;
-				t = (-PI - p.lon) / (q_lon - p.lon);
-			}
-			
-			GeoCoord amCrossPoint = {
-				.lat = p.lat + t * (q.lat - p.lat),
-				.lon = isNorthern ? PI : -PI,
-			};
-			points[pointsCount++] = toMapCoord(amCrossPoint, surfaceSize);
+			if(tileCache.find(level, column, row))
+				continue;
 			
-			// All points are either above or below the equator, so check any one point
-			bool isNorthern = geoBoundary->verts[0].lat > 0;
-			if(isNorthern)
-			{
-				points[pointsCount++] = QPointF(surfaceSize.width(), 0); // top-right corner
-				points[pointsCount++] = QPointF(0, 0);                   // top-left corner
-			}
-			else
-			{
-				points[pointsCount++] = QPointF(0, surfaceSize.height());                   // bottom-left corner
-				points[pointsCount++] = QPointF(surfaceSize.width(), surfaceSize.height()); // bottom-right corner
-			}
-			
-			amCrossPoint.lon = -amCrossPoint.lon;
-			points[pointsCount++] = toMapCoord(amCrossPoint, surfaceSize);
-#else
-			const GeoCoord& east = p.lon > 0 ? p : q;
-			const GeoCoord& west = p.lon > 0 ? q : p;
-			GeoCoord anti = getEasternAntimeridianCrossingPoint(east, west);
-			
-			// All points are either above or below the equator, so check any one point
-			bool isNorthern = p.lat > 0;
-			// NOTE: Points must be added in counterclockwise order
-			if(isNorthern)
-			{
-				points[pointsCount++] = toMapCoord(anti, surfaceSize);   // eastern crossing point
-				points[pointsCount++] = QPointF(surfaceSize.width(), 0); // top-right corner
-				points[pointsCount++] = QPointF(0, 0);                   // top-left corner
-				anti.lon = -anti.lon;
-				points[pointsCount++] = toMapCoord(anti, surfaceSize);   // western crossing point
-			}
-			else
-			{
-				anti.lon = -anti.lon; // First point in ccw order is western, not eastern
-				points[pointsCount++] = toMapCoord(anti, surfaceSize);                      // western crossing point
-				points[pointsCount++] = QPointF(0, surfaceSize.height());                   // bottom-left corner
-				points[pointsCount++] = QPointF(surfaceSize.width(), surfaceSize.height()); // bottom-right corner
-				anti.lon = -anti.lon; // go back to eastern point
-				points[pointsCount++] = toMapCoord(anti, surfaceSize);                      // eastern crossing point
-			}
-#endif
+			pending.push_back({column, row, QImage()});
+			pendingArea |= tileCache.tileRect(level, column, row);
 		}
 	}
 	
-	// NOTE: Polygon can be concave
-	painter->drawPolygon(points, pointsCount);
-	
-#if ENABLE_DEBUG_DRAW_GEOBOUNDARY_VERTICES
-	QFont font = painter->font();
-	font.setPointSizeF(font.pointSizeF() * 0.4);
-	painter->setFont(font);
-	for(int i = 0; i < pointsCount; ++i)
+	if(!pending.empty())
 	{
-		painter->setPen(QPen(QColor(255, 0, 255, 255), 1));
-		painter->setBrush(QBrush(QColor(255, 0, 0, 63), Qt::BrushStyle::SolidPattern));
-		painter->drawPoint(points[i]);
+		double scale   = TileCache::TILE_SIZE / extent;
+		QSizeF mapSize = this->mapSize();
+		renderer.bucketCells(dataset, MapRenderer::prepareLod(dataset, lodResolution(scale)), pendingArea);
+		const MapRenderer::ColorBuckets& buckets = renderer.buckets;
 		
-		painter->setPen(QPen(QColor(0, 0, 0, 255), 1));
-		painter->setBrush(QBrush(QColor(0, 0, 0, 255), Qt::BrushStyle::SolidPattern));
-		painter->drawText(points[i], QString::number(i));
-	}
-#endif
-}
-
-
-void drawBoundaryAntimeridian(QPainter* painter, GeoBoundary* geoBoundary, QSizeF surfaceSize)
-{
-	QPointF pointsEast[MAX_CELL_BNDRY_VERTS];
-	int     pointsEastCount = 0;
-	QPointF pointsWest[MAX_CELL_BNDRY_VERTS];
-	int     pointsWestCount = 0;
-	
-	for(int i = 0; i < geoBoundary->numVerts; ++i)
-	{
-		const GeoCoord& p = geoBoundary->verts[i];
-		if(p.lon > 0)
-			pointsEast[pointsEastCount++] = toMapCoord(p, surfaceSize);
-		else
-			pointsWest[pointsWestCount++] = toMapCoord(p, surfaceSize);
+		// NOTE: Tile threads can only find() outlines, so the ones that are missing are stored up front
+		geometryCache.fill(buckets.indices.data(), buckets.indices.size());
 		
-		const GeoCoord& q = geoBoundary->verts[(i+1) % geoBoundary->numVerts];
-		if(edgeCrossesAntimeridian(p.lon, q.lon))
+		parallelFor(pending.size(), 1, [&](size_t begin, size_t end)
 		{
-#if 0
-			// c = p + t*(q-p) -> t = (c-p)/(q-p)
-			double t;
-			if(q.lon < 0)
+			CellCuller   tileCuller = renderer.culler;
+			CellGeometry geometry;
+			for(size_t t = begin; t < end; ++t)
 			{
-				double q_lon = q.lon + 2*PI;
-				t = ( PI - p.lon) / (q_lon - p.lon);
-			}
-			else
-			{
-				double q_lon = q.lon - 2*PI;
-				t = (-PI - p.lon) / (q_lon - p.lon);
+				PendingTile& tile     = pending[t];
+				QRectF       tileRect = tileCache.tileRect(level, tile.column, tile.row);
+				tileCuller.setVisibleRect(tileRect);
+				tile.image = QImage(TileCache::TILE_SIZE, TileCache::TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+				tile.image.fill(Qt::transparent);
+				
+				QPainter tilePainter(&tile.image);
+				tilePainter.scale(scale, scale);
+				tilePainter.translate(-tileRect.topLeft());
+				tilePainter.setPen(Qt::PenStyle::NoPen);
+				for(int bin = 0; bin < ColorLookup::BINS; ++bin)
+				{
+					bool brushIsSet = false;
+					for(uint32_t i = buckets.offsets[bin]; i < buckets.offsets[bin + 1]; ++i)
+					{
+						H3Index index = buckets.indices[i];
+						if(!tileCuller.isVisible(index))
+							continue;
+						
+						if(!geometryCache.find(index, &geometry))
+							computeCellGeometry(index, mapSize, &geometry);
+						
+						// NOTE: The culler is conservative, the bounds of the outline tell if the cell really touches the tile
+						if(!geometry.boundingRect(0).intersects(tileRect) && !(geometry.isSplit() && geometry.boundingRect(1).intersects(tileRect)))
+							continue;
+						
+						if(!brushIsSet)
+						{
+							tilePainter.setBrush(colorLookup.brushes[bin]);
+							brushIsSet = true;
+						}
+						drawCellGeometry(&tilePainter, geometry);
+					}
+				}
 			}
-			
-			GeoCoord amCrossPoint = {
-				.lat = p.lat + t * (q.lat - p.lat),
-				.lon = PI,
-			};
-			pointsEast[pointsEastCount++] = toMapCoord(amCrossPoint, surfaceSize);
-			amCrossPoint.lon = -amCrossPoint.lon;
-			pointsWest[pointsWestCount++] = toMapCoord(amCrossPoint, surfaceSize);
-#else
-			const GeoCoord& east = p.lon > 0 ? p : q;
-			const GeoCoord& west = p.lon > 0 ? q : p;
-			GeoCoord anti = getEasternAntimeridianCrossingPoint(east, west);
-			
-			pointsEast[pointsEastCount++] = toMapCoord(anti, surfaceSize);
-			anti.lon = -anti.lon;
-			pointsWest[pointsWestCount++] = toMapCoord(anti, surfaceSize);
-			
-#endif
-		}
+		});
+		
+		for(PendingTile& tile : pending)
+			tileCache.insert(level, tile.column, tile.row, std::move(tile.image));
+		renderedTilesCount += pending.size();
 	}
 	
-	assert(pointsEastCount > 0);
-	assert(pointsWestCount > 0);
-	painter->drawConvexPolygon(pointsEast, pointsEastCount);
-	painter->drawConvexPolygon(pointsWest, pointsWestCount);
-}
-
-
-void drawBoundary(QPainter* painter, GeoBoundary* geoBoundary, QSizeF surfaceSize)
-{
-	int crossPointsCount = countEdgesCrossingAntimeridian(geoBoundary);
-	if(crossPointsCount == 0)
+	painter->setRenderHint(QPainter::SmoothPixmapTransform);
+	for(int row = minRow; row <= maxRow; ++row)
 	{
-		QPointF points[MAX_CELL_BNDRY_VERTS];
-		for(int i = 0; i < geoBoundary->numVerts; ++i)
-			points[i] = toMapCoord(geoBoundary->verts[i], surfaceSize);
-		painter->drawConvexPolygon(points, geoBoundary->numVerts);
-
-#if ENABLE_DEBUG_DRAW_GEOBOUNDARY_VERTICES
-		QFont font = painter->font();
-		font.setPointSizeF(font.pointSizeF() * 0.4);
-		painter->setFont(font);
-		for(int i = 0; i < geoBoundary->numVerts; ++i)
+		for(int column = minColumn; column <= maxColumn; ++column)
 		{
-			painter->setPen(QPen(QColor(255, 0, 255, 255), 1));
-			painter->setBrush(QBrush(QColor(255, 0, 0, 63), Qt::BrushStyle::SolidPattern));
-			painter->drawPoint(points[i]);
-			
-			painter->setPen(QPen(QColor(0, 0, 0, 255), 1));
-			painter->setBrush(QBrush(QColor(0, 0, 0, 255), Qt::BrushStyle::SolidPattern));
-			painter->drawText(points[i], QString::number(i));
+			const QImage* image = tileCache.find(level, column, row);
+			assert(image);
+			painter->drawImage(tileCache.tileRect(level, column, row), *image);
+			blittedTilesCount += 1;
 		}
-#endif
-	}
-	else if(crossPointsCount == 1)
-	{
-		drawBoundaryPolar(painter, geoBoundary, surfaceSize);
-	}
-	else
-	{
-		drawBoundaryAntimeridian(painter, geoBoundary, surfaceSize);
 	}
 }
 
@@ -288,41 +148,35 @@ void MapView::drawForeground(QPainter* painter, const QRectF& exposed)
 	if(!dataset)
 		return;
 	
+	// NOTE: Map coordinates do not change with zoom or scroll, so cells are only projected again when the resolution changes
 	QSizeF mapSize = this->mapSize();
-	GeoBoundary geoBoundary;
+	geometryCache.reset(dataset->resolution, mapSize);
+	renderer.reset(mapSize);
+	tileCache.reset(dataset, dataset->resolution, mapSize);
 	
-	painter->setPen(datasetPen);
+#if ENABLE_DEBUG_DRAW_CULLING_STATS
+	QElapsedTimer frameTimer;
+	frameTimer.start();
+#endif
 	
-	if(dataset->isInteger)
-	{
-		for(auto [index, geoValue] : dataset->geoValues)
-		{
-			assert(index != H3_INVALID_INDEX);
-			
-			QColor color = getGeoValueColor(geoValue.integer);
-			datasetBrush.setColor(color);
-			painter->setBrush(datasetBrush);
-			
-			h3ToGeoBoundary(index, &geoBoundary);
-			drawBoundary(painter, &geoBoundary, mapSize);
-		}
-	}
+	renderer.drawnCount  = 0;
+	renderer.culledCount = 0;
+	renderedTilesCount   = 0;
+	blittedTilesCount    = 0;
+	
+	// NOTE: On high DPI displays one unit of the view is several pixels of the device
+	double pixelsPerUnit = painter->worldTransform().m11() * painter->device()->devicePixelRatioF();
+	int    level         = tileCache.levelForScale(pixelsPerUnit);
+	if(level >= 0)
+		drawDatasetTiles(painter, exposed, level);
 	else
-	{
-		for(auto [index, geoValue] : dataset->geoValues)
-		{
-			assert(index != H3_INVALID_INDEX);
-			
-			QColor color = getGeoValueColor(geoValue.real);
-			datasetBrush.setColor(color);
-			painter->setBrush(datasetBrush);
-			
-			h3ToGeoBoundary(index, &geoBoundary);
-			drawBoundary(painter, &geoBoundary, mapSize);
-		}
-	}
+		renderer.drawCellsInStrips(painter, dataset, MapRenderer::prepareLod(dataset, lodResolution(pixelsPerUnit)), exposed, QThreadPool::globalInstance()->maxThreadCount());
+	tileCache.endFrame();
 	
 	
+	CellCuller& culler = renderer.culler;
+	culler.setVisibleRect(exposed);
+	
 	if(gridIndices)
 	{
 		painter->setPen(gridPen);
@@ -332,9 +186,8 @@ void MapView::drawForeground(QPainter* painter, const QRectF& exposed)
 		for(H3Index index : *gridIndices)
 		{
 			assert(index != H3_INVALID_INDEX);
-			
-			h3ToGeoBoundary(index, &geoBoundary);
-			drawBoundaryEdges(painter, &geoBoundary, mapSize);
+			if(culler.isVisible(index))
+				geometryCache.drawCellEdges(painter, index);
 		}
 	}
 	
@@ -348,9 +201,8 @@ void MapView::drawForeground(QPainter* painter, const QRectF& exposed)
 		for(H3Index index : *highlightIndices)
 		{
 			assert(index != H3_INVALID_INDEX);
-			
-			h3ToGeoBoundary(index, &geoBoundary);
-			drawBoundary(painter, &geoBoundary, mapSize);
+			if(culler.isVisible(index))
+				geometryCache.drawCell(painter, index);
 		}
 		
 #if !DISABLE_DRAW_HIGHLIGHTED_INDICES_CENTER
@@ -363,21 +215,31 @@ void MapView::drawForeground(QPainter* painter, const QRectF& exposed)
 #endif
 		painter->setPen(highlightPen);
 		
+		std::vector<QPointF> centers;
 		for(H3Index index : *highlightIndices)
 		{
 			assert(index != H3_INVALID_INDEX);
-			
-			GeoCoord geoCenter;
-			h3ToGeo(index, &geoCenter);
-			QPointF center = toMapCoord(geoCenter, mapSize);
-			painter->drawPoint(center);
+			if(culler.isVisible(index))
+				centers.push_back(geometryCache.center(index));
 		}
+		painter->drawPoints(centers.data(), int(centers.size()));
 #endif
 	}
+	
+	
+#if ENABLE_DEBUG_DRAW_CULLING_STATS
+	painter->save();
+	painter->resetTransform();
+	painter->setPen(QPen(QColor(0, 0, 0, 255), 1));
+	painter->drawText(QPointF(8, 16), QString("Drawn: %1  Culled: %2  Tiles: %3 rendered, %4 blitted (level %5)  LOD: %6  Frame: %7 ms")
+		.arg(renderer.drawnCount).arg(renderer.culledCount).arg(renderedTilesCount).arg(blittedTilesCount).arg(level).arg(lodResolution(pixelsPerUnit))
+		.arg(frameTimer.nsecsElapsed() / 1e6, 0, 'f', 2));
+	painter->restore();
+#endif
 }
 
 
-MapView::MapView(HashSet<H3Index>* highlightIndices, HashSet<H3Index>* gridIndices, QWidget* parent) : QGraphicsView(parent)
+MapView::MapView(CompactCellSet* highlightIndices, CompactCellSet* gridIndices, QWidget* parent) : QGraphicsView(parent)
 {
 	this->highlightIndices = highlightIndices;
 	this->gridIndices      = gridIndices;
@@ -393,6 +255,9 @@ MapView::MapView(HashSet<H3Index>* highlightIndices, HashSet<H3Index>* gridIndic
 	gridPen.setDashPattern({8, 8});
 	
 	highlightPen.setCosmetic(true);
+	
+	renderer.colorLookup   = &colorLookup;
+	renderer.geometryCache = &geometryCache;
 }
 
 
@@ -407,6 +272,10 @@ void MapView::setDataSource(Dataset* dataset)
 	if(this->dataset == dataset)
 		return;
 	this->dataset = dataset;
+	updateColorRange();
+	
+	// NOTE: A new dataset can be allocated where a deleted one was, so the tiles cannot be told apart by address
+	tileCache.clear();
 	scene()->invalidate();
 }
 
@@ -431,63 +300,162 @@ void MapView::requestRepaint()
 }
 
 
+void MapView::requestRepaint(const CompactCellSet& indices)
+{
+	if(!dataset || indices.size() > REPAINT_MAX_CELLS)
+	{
+		requestRepaint();
+		return;
+	}
+	
+	geometryCache.reset(dataset->resolution, mapSize());
+	
+	// Cells smaller than a pixel are drawn as their parents, which may stick out of them (see lodResolution())
+	double pixelsPerUnit = transform().m11() * devicePixelRatioF();
+	int    level         = tileCache.levelForScale(pixelsPerUnit);
+	int    lodResolution = this->lodResolution(level >= 0 ? TileCache::TILE_SIZE / tileCache.tileExtent(level) : pixelsPerUnit);
+	double margin        = REPAINT_MARGIN_PIXELS / transform().m11();
+	
+	QRectF       dirtyRect;
+	CellGeometry geometry;
+	auto addCell = [&](H3Index index)
+	{
+		geometryCache.get(index, &geometry);
+		for(int polygon = 0; polygon < (geometry.isSplit() ? 2 : 1); ++polygon)
+		{
+			QRectF bounds = geometry.boundingRect(polygon).adjusted(-margin, -margin, margin, margin);
+			
+			// NOTE: The halves of a split cell are on opposite sides of the map, their union would cover all of it
+			if(geometry.isSplit())
+				scene()->invalidate(bounds, QGraphicsScene::ForegroundLayer);
+			else
+				dirtyRect |= bounds;
+		}
+	};
+	
+	for(H3Index index : indices)
+	{
+		assert(index != H3_INVALID_INDEX);
+		addCell(index);
+		if(lodResolution < H3_GET_RESOLUTION(index))
+			addCell(h3ToParent(index, lodResolution));
+	}
+	
+	if(!dirtyRect.isNull())
+		scene()->invalidate(dirtyRect, QGraphicsScene::ForegroundLayer);
+}
+
+
+void MapView::invalidateCells(const CompactCellSet& indices)
+{
+	if(!dataset)
+		return;
+	
+	if(indices.size() > INVALIDATE_MAX_CELLS)
+	{
+		invalidateTiles();
+		return;
+	}
+	
+	QSizeF mapSize = this->mapSize();
+	geometryCache.reset(dataset->resolution, mapSize);
+	tileCache.reset(dataset, dataset->resolution, mapSize);
+	if(tileCache.tiles.empty())
+		return;
+	
+	// Tiles of coarse levels show the parents of the cells (see lodResolution()), and parents cover more tiles
+	CellGeometry geometry;
+	for(int level = 0; level <= TileCache::MAX_LEVEL; ++level)
+	{
+		int lodResolution = this->lodResolution(TileCache::TILE_SIZE / tileCache.tileExtent(level));
+		for(H3Index index : indices)
+		{
+			H3Index drawnIndex = lodResolution < H3_GET_RESOLUTION(index) ? h3ToParent(index, lodResolution) : index;
+			geometryCache.get(drawnIndex, &geometry);
+			tileCache.invalidate(geometry.boundingRect(0), level);
+			if(geometry.isSplit())
+				tileCache.invalidate(geometry.boundingRect(1), level);
+		}
+	}
+}
+
+
+void MapView::invalidateTiles()
+{
+	tileCache.clear();
+}
+
+
 void MapView::redrawValuesRange()
 {
 	assert(dataset);
 	
 	// TODO: Find out how to draw a screen-space floating rect with a gradient
 //	QLinearGradient gradient = QLinearGradient(QPointF(), QPointF());
-//	QColor minColor = dataset->isInteger ? getGeoValueColor(dataset->minValue.integer) : getGeoValueColor(dataset->minValue.real);
-//	QColor maxColor = dataset->isInteger ? getGeoValueColor(dataset->maxValue.integer) : getGeoValueColor(dataset->maxValue.real);
+//	QColor minColor = colorLookup.brushes[0].color();
+//	QColor maxColor = colorLookup.brushes[ColorLookup::BINS - 1].color();
 //	gradient.setColorAt(0, minColor);
 //	gradient.setColorAt(1, maxColor);
 	
+	// Every cell may change color
+	updateColorRange();
+	invalidateTiles();
 	scene()->invalidate();
 }
 
 
-QSizeF MapView::mapSize() const
+// Call after editing values. The color scale follows the values of datasets without a range of their own, see Dataset::colorRange()
+void MapView::refreshValuesRange()
 {
-	return mapGraphicsItem->boundingRect().size();
-//	return sceneRect().size();
+	if(!dataset)
+		return;
+	
+	double oldScale  = colorLookup.scale;
+	double oldOffset = colorLookup.offset;
+	updateColorRange();
+	if(colorLookup.scale != oldScale || colorLookup.offset != oldOffset)
+	{
+		invalidateTiles();
+		scene()->invalidate();
+	}
 }
 
 
-QColor MapView::getGeoValueColor(int64_t geoValue)
+void MapView::setColormap(Colormap colormap)
 {
-	assert(dataset);
-	int64_t minValue = dataset->minValue.integer;
-	int64_t maxValue = dataset->maxValue.integer;
-	assert(minValue <= maxValue);
-	if(minValue == maxValue)
-		return QColor(255, 0, 0, 64);
-	
-	geoValue = std::clamp(geoValue, minValue, maxValue);
-	double t = double(geoValue - minValue) / double(maxValue - minValue);
-	
-	// NOTE: 0 = red, 240 = somewhere in the middle of blue hue; we want the opposite, i.e. red high values, hence 1-t
-	int hue = int((1.0-t) * 240.0);
-	QColor result = QColor::fromHsv(hue, 255, 255, 64);
-	return result;
+	if(colorLookup.colormap == colormap)
+		return;
+	
+	// NOTE: Diverging colormaps center the range on zero, so the bins move too
+	colorLookup.setColormap(colormap);
+	updateColorRange();
+	invalidateTiles();
+	scene()->invalidate();
 }
 
 
-QColor MapView::getGeoValueColor(double geoValue)
+Colormap MapView::colormap() const
 {
-	assert(dataset);
-	double minValue = dataset->minValue.real;
-	double maxValue = dataset->maxValue.real;
-	assert(minValue <= maxValue);
-	if(minValue == maxValue)
-		return QColor(255, 0, 0, 64);
-	
-	geoValue = std::clamp(geoValue, minValue, maxValue);
-	double t = (geoValue - minValue) / (maxValue - minValue);
-	
-	// NOTE: 0 = red, 240 = somewhere in the middle of blue hue; we want the opposite, i.e. red high values, hence 1-t
-	int hue = int((1.0-t) * 240.0);
-	QColor result = QColor::fromHsv(hue, 255, 255, 64);
-	return result;
+	return colorLookup.colormap;
+}
+
+
+void MapView::updateColorRange()
+{
+	if(!dataset)
+		return;
+	
+	double minValue;
+	double maxValue;
+	dataset->colorRange(&minValue, &maxValue);
+	colorLookup.setRange(minValue, maxValue);
+}
+
+
+QSizeF MapView::mapSize() const
+{
+	return mapGraphicsItem->boundingRect().size();
+//	return sceneRect().size();
 }
 
 
@@ -5,8 +5,13 @@
 #include <QRubberBand>
 #include <h3/h3api.h>
 
+#include "CellGeometryCache.hpp"
+#include "ColorLookup.hpp"
+#include "CompactCellSet.hpp"
 #include "Containers.hpp"
+#include "MapRenderer.hpp"
 #include "MapUtils.hpp"
+#include "TileCache.hpp"
 
 
 class QMouseEvent;
@@ -32,10 +37,10 @@ protected:
 	Dataset*          dataset          = nullptr;
 	
 	// Data source to draw user-selected polygons
-	HashSet<H3Index>* highlightIndices = nullptr;
+	CompactCellSet*   highlightIndices = nullptr;
 	
 	// Data source to draw polygon boundaries
-	HashSet<H3Index>* gridIndices      = nullptr;
+	CompactCellSet*   gridIndices      = nullptr;
 	
 	// Interaction mode with map widget
 	InteractionMode   interactionMode  = InteractionMode::Cell;
@@ -49,9 +54,6 @@ protected:
 	QPoint vsMouseRightDownPos = QPoint();
 	QRubberBand rubberband = QRubberBand(QRubberBand::Rectangle, this);
 	
-	QPen   datasetPen   = QPen(Qt::PenStyle::NoPen);
-	QBrush datasetBrush = QBrush(Qt::BrushStyle::SolidPattern);
-	
 	QPen   gridPen   = QPen(QColor(0, 0, 0), 1.0);
 	QBrush gridBrush = QBrush(Qt::BrushStyle::NoBrush);
 	
@@ -60,21 +62,49 @@ protected:
 	
 	QGraphicsItem* mapGraphicsItem = nullptr;
 	
+	// Projected outlines of the dataset, grid and highlighted cells
+	CellGeometryCache geometryCache;
+	
+	// Colors of the dataset values, for the current colormap and value range
+	ColorLookup       colorLookup;
+	
+	// Draws the dataset cells with the cache and colors above, and skips the cells outside of the area being repainted
+	MapRenderer       renderer;
+	
+	// Dataset layer rendered to images, so that panning and zooming do not draw cells again
+	TileCache         tileCache;
+	
+	// What the last repaint did, see ENABLE_DEBUG_DRAW_CULLING_STATS
+	size_t renderedTilesCount = 0;
+	size_t blittedTilesCount  = 0;
+
 	
 public:
-	explicit MapView(HashSet<H3Index>* highlightIndices, HashSet<H3Index>* gridIndices, QWidget* parent = nullptr);
+	explicit MapView(CompactCellSet* highlightIndices, CompactCellSet* gridIndices, QWidget* parent = nullptr);
 	
 	void   setDataSource(Dataset* dataset);
 	void   setInteractionMode(InteractionMode mode);
 	void   zoom(QPoint vsAnchor, double steps);
 	void   redrawValuesRange();
+	void   refreshValuesRange();
+	void   setColormap(Colormap colormap);
+	Colormap colormap() const;
 	void   requestRepaint();
+	
+	// Repaints only the parts of the view covered by these cells, e.g. after editing their values or highlighting them
+	void   requestRepaint(const CompactCellSet& indices);
+	
 	QSizeF mapSize() const;
 	
+	// Drops the rendered tiles under these cells, or all tiles for large edits. Call after changing their values
+	void   invalidateCells(const CompactCellSet& indices);
+	void   invalidateTiles();
+	
 	
 protected:
-	QColor getGeoValueColor(int64_t geoValue);
-	QColor getGeoValueColor(double  geoValue);
+	void updateColorRange();
+	int  lodResolution(double pixelsPerUnit) const;
+	void drawDatasetTiles(QPainter* painter, const QRectF& area, int level);
 	void drawForeground(QPainter* painter, const QRectF& exposed) override;
 
 	void mousePressEvent(QMouseEvent* event) override;
@@ -1,6 +1,8 @@
 #include "MapWindow.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 
 #include <QApplication>
 #include <QKeyEvent>
@@ -16,11 +18,14 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QInputDialog>
+#include <QPushButton>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include "MapView.hpp"
 #include "GeoValueValidator.hpp"
 #include "DatasetListWidget.hpp"
 #include "DatasetControlWidget.hpp"
+#include "DatasetFile.hpp"
 #include "models/DatasetListModel.hpp"
 #include "dialogs/SimulationConfigDialog.hpp"
 #include "dialogs/DatasetCreateDialog.hpp"
@@ -32,10 +37,17 @@ static SimulationConfig globalSimulationConfig;
 
 
 
-MapWindow::MapWindow(QWidget* parent) : QMainWindow(parent)
+MapWindow::MapWindow(QWidget* parent) : QMainWindow(parent), datasetLoadCancelled(false)
 {
 	datasets = new DatasetListModel(this);
 	
+	QObject::connect(&datasetLoadWatcher, &QFutureWatcher<DatasetLoadResult>::progressValueChanged, this, &MapWindow::onDatasetLoadProgress);
+	QObject::connect(&datasetLoadWatcher, &QFutureWatcher<DatasetLoadResult>::finished,             this, &MapWindow::loadDatasetsEnd);
+	
+	QObject::connect(&gridPolyfillWatcher, &QFutureWatcher<GridPolyfillResult>::resultReadyAt,        this, &MapWindow::onGridPolyfillResultReady);
+	QObject::connect(&gridPolyfillWatcher, &QFutureWatcher<GridPolyfillResult>::progressValueChanged, this, &MapWindow::onGridPolyfillProgress);
+	QObject::connect(&gridPolyfillWatcher, &QFutureWatcher<GridPolyfillResult>::finished,             this, &MapWindow::onGridPolyfillFinished);
+	
 #if !DISABLE_CREATE_INNER_AND_OUTER_DATASETS_AT_STARTUP
 	datasets->appendItem(new Dataset("inner", false, true));
 	datasets->appendItem(new Dataset("outer", false, true));
@@ -72,6 +84,11 @@ MapWindow::MapWindow(QWidget* parent) : QMainWindow(parent)
 	
 	statusLabel = new QLabel();
 	statusBar->addPermanentWidget(statusLabel);
+	
+	cancelLoadButton = new QPushButton(tr("Cancel"));
+	cancelLoadButton->setVisible(false);
+	QObject::connect(cancelLoadButton, &QPushButton::clicked, this, &MapWindow::onActionCancelLoad);
+	statusBar->addPermanentWidget(cancelLoadButton);
 }
 
 
@@ -86,10 +103,14 @@ void MapWindow::addWidgetsToCentralWidget(QWidget* centralWidget)
 		QObject::connect(datasetListWidget, &DatasetListWidget::itemDeleted,  this, &MapWindow::onDatasetListItemDeleted);
 		
 		datasetControlWidget = new DatasetControlWidget(group);
-		QObject::connect(datasetControlWidget, &DatasetControlWidget::resolutionChanged, this, &MapWindow::onDatasetResolutionChanged);
-		QObject::connect(datasetControlWidget, &DatasetControlWidget::defaultChanged,    this, &MapWindow::onDatasetDefaultChanged);
-		QObject::connect(datasetControlWidget, &DatasetControlWidget::densityChanged,    this, &MapWindow::onDatasetDensityChanged);
-		QObject::connect(datasetControlWidget, &DatasetControlWidget::valueRangeChanged, this, &MapWindow::onDatasetValueRangeChanged);
+		QObject::connect(datasetControlWidget, &DatasetControlWidget::resolutionChangeStarted,  this, &MapWindow::onDatasetResolutionChangeStarted);
+		QObject::connect(datasetControlWidget, &DatasetControlWidget::resolutionChangeProgress, this, &MapWindow::onDatasetResolutionChangeProgress);
+		QObject::connect(datasetControlWidget, &DatasetControlWidget::resolutionAboutToChange,  this, &MapWindow::onDatasetResolutionAboutToChange);
+		QObject::connect(datasetControlWidget, &DatasetControlWidget::resolutionChanged,        this, &MapWindow::onDatasetResolutionChanged);
+		QObject::connect(datasetControlWidget, &DatasetControlWidget::aggregationChanged,       this, &MapWindow::onDatasetAggregationChanged);
+		QObject::connect(datasetControlWidget, &DatasetControlWidget::defaultChanged,           this, &MapWindow::onDatasetDefaultChanged);
+		QObject::connect(datasetControlWidget, &DatasetControlWidget::densityChanged,           this, &MapWindow::onDatasetDensityChanged);
+		QObject::connect(datasetControlWidget, &DatasetControlWidget::valueRangeChanged,        this, &MapWindow::onDatasetValueRangeChanged);
 		
 		group->setStretchFactor(0, 0);
 		group->setStretchFactor(1, 1);
@@ -178,6 +199,26 @@ void MapWindow::addActionsToMenuBar(QMenuBar* menuBar)
 	}
 	
 	
+	QMenu* menuEdit = new QMenu(tr("Edit"), this);
+	{
+		undoAction = new QAction(this);
+		undoAction->setIcon(QIcon::fromTheme(QString::fromUtf8("edit-undo")));
+		undoAction->setText(tr("Undo"));
+		undoAction->setShortcuts(QKeySequence::StandardKey::Undo);
+		undoAction->setEnabled(false);
+		QObject::connect(undoAction, &QAction::triggered, this, &MapWindow::onActionUndo);
+		menuEdit->addAction(undoAction);
+	} {
+		redoAction = new QAction(this);
+		redoAction->setIcon(QIcon::fromTheme(QString::fromUtf8("edit-redo")));
+		redoAction->setText(tr("Redo"));
+		redoAction->setShortcuts(QKeySequence::StandardKey::Redo);
+		redoAction->setEnabled(false);
+		QObject::connect(redoAction, &QAction::triggered, this, &MapWindow::onActionRedo);
+		menuEdit->addAction(redoAction);
+	}
+	
+	
 	QMenu* menuTools = new QMenu(tr("Tools"), this);
 	{
 		QAction* action = new QAction(this);
@@ -188,7 +229,26 @@ void MapWindow::addActionsToMenuBar(QMenuBar* menuBar)
 	}
 	
 	
+	QMenu* menuView = new QMenu(tr("View"), this);
+	{
+		QMenu*        menuColormap = menuView->addMenu(tr("Colormap"));
+		QActionGroup* actionGroup  = new QActionGroup(this);
+		for(Colormap colormap : {Colormap::Hue, Colormap::Viridis, Colormap::Diverging})
+		{
+			QAction* action = new QAction(this);
+			action->setText(tr(ColorLookup::colormapName(colormap)));
+			action->setActionGroup(actionGroup);
+			action->setCheckable(true);
+			action->setChecked(colormap == mapView->colormap());
+			QObject::connect(action, &QAction::triggered, this, [this, colormap]() { mapView->setColormap(colormap); });
+			menuColormap->addAction(action);
+		}
+	}
+	
+	
 	menuBar->addAction(menuFile->menuAction());
+	menuBar->addAction(menuEdit->menuAction());
+	menuBar->addAction(menuView->menuAction());
 	menuBar->addAction(menuTools->menuAction());
 }
 
@@ -196,7 +256,7 @@ void MapWindow::addActionsToMenuBar(QMenuBar* menuBar)
 void MapWindow::addActionsToToolBar(QToolBar* toolBar)
 {
 	{	QActionGroup* actionGroup = new QActionGroup(this);
-		
+	
 		QAction* actionZoomOut = new QAction();
 		actionZoomOut->setIcon(QIcon::fromTheme(QString::fromUtf8("zoom-out")));
 		actionZoomOut->setText(tr("Zoom Out"));
@@ -219,7 +279,7 @@ void MapWindow::addActionsToToolBar(QToolBar* toolBar)
 	toolBar->addSeparator();
 	
 	{	QActionGroup* actionGroup = new QActionGroup(this);
-	
+		
 		QAction* actionMark = new QAction();
 		actionMark->setIcon(QIcon(QString::fromUtf8(":/images/icon-cell-mark.svg")));
 		actionMark->setText(tr("Mark"));
@@ -334,6 +394,14 @@ void MapWindow::closeEvent(QCloseEvent* event)
 	
 	if(confirmed)
 	{
+		cancelGridPolyfill();
+		datasetControlWidget->waitForResolutionChange();
+		if(isLoadingDatasets())
+		{
+			onActionCancelLoad();
+			datasetLoadWatcher.waitForFinished();
+			loadDatasetsEnd();
+		}
 		event->accept();
 	}
 	else
@@ -347,7 +415,7 @@ void MapWindow::onActionOpenFile()
 {
 	QFileDialog* dialog = new QFileDialog(this);
 	dialog->setWindowTitle(tr("Open File"));
-	dialog->setNameFilter(tr("TOML+H3 (*.h3);;All Files (*)"));
+	dialog->setNameFilter(tr("H3 datasets (*.h3 *.h3b);;TOML+H3 (*.h3);;H3 binary (*.h3b);;All Files (*)"));
 	dialog->setAcceptMode(QFileDialog::AcceptOpen);
 	dialog->setAttribute(Qt::WA_DeleteOnClose);
 	QObject::connect(dialog, &QFileDialog::accepted, this, &MapWindow::onOpenFileDialogAccepted);
@@ -358,48 +426,35 @@ void MapWindow::onActionOpenFile()
 void MapWindow::onOpenFileDialogAccepted()
 {
 	QFileDialog* fileDialog = static_cast<QFileDialog*>(sender());
+	loadDatasetsBegin(fileDialog->selectedFiles(), "");
+}
+
+
+void MapWindow::openFilesEnd(std::list<Dataset*>&& datasetList, const std::list<QString>& paths)
+{
+	assert(datasetList.size() == paths.size());
 	
-	try
+	auto path = paths.begin();
+	for(Dataset* dataset : datasetList)
 	{
-		for(const QString& path : fileDialog->selectedFiles())
+		if(datasets->appendItem(dataset))
 		{
-			assert(path.size() > 0);
+			datasetSaveStates[dataset].path     = path->toStdString();
+			datasetSaveStates[dataset].modified = false;
+		}
+		else
+		{
+			QString datasetName = QString::fromStdString(dataset->id);
 			
-			Dataset* dataset = new Dataset();
-			bool success = deserializeDataset(path, dataset);
-			if(success)
-			{
-				if(datasets->appendItem(dataset))
-				{
-					datasetSaveStates[dataset].path     = path.toStdString();
-					datasetSaveStates[dataset].modified = false;
-				}
-				else
-				{
-					QString datasetName = QString::fromStdString(dataset->id);
-					
-					QMessageBox* dialog = new QMessageBox(this);
-					dialog->setWindowTitle(tr("Error"));
-					dialog->setText(tr("Error while adding %1 to the datasets list").arg(datasetName));
-					dialog->setAttribute(Qt::WA_DeleteOnClose);
-					dialog->open();
-					
-					delete dataset;
-				}
-			}
-			else
-			{
-				// TODO: Error dialog?
-			}
+			QMessageBox* dialog = new QMessageBox(this);
+			dialog->setWindowTitle(tr("Error"));
+			dialog->setText(tr("Error while adding %1 to the datasets list").arg(datasetName));
+			dialog->setAttribute(Qt::WA_DeleteOnClose);
+			dialog->open();
+			
+			delete dataset;
 		}
-	}
-	catch(std::bad_alloc& ex)
-	{
-		QMessageBox* dialog = new QMessageBox(this);
-		dialog->setWindowTitle(tr("Error"));
-		dialog->setText(__FILE__ ":" STR(__LINE__) " Memory allocation error");
-		dialog->setAttribute(Qt::WA_DeleteOnClose);
-		dialog->open();
+		++path;
 	}
 }
 
@@ -443,47 +498,23 @@ void MapWindow::onOpenProjectDialogAccepted()
 
 
 void MapWindow::openProject(const QString& directoryPath)
+{
+	loadDatasetsBegin(projectDatasetFiles(directoryPath), directoryPath);
+}
+
+
+void MapWindow::openProjectEnd(const QString& directoryPath, std::list<Dataset*>&& datasetList)
 {
 	QDir    directory = QDir(directoryPath);
 	QString filePath;
 	bool    success = true;
 	
 	
-	std::list<Dataset*> datasetList;
-	try
-	{
-		for(QFileInfo& fileInfo : directory.entryInfoList(QDir::Filter::Files, QDir::SortFlag::NoSort))
-		{
-			if(fileInfo.suffix() != "h3")
-				continue;
-			
-			filePath = fileInfo.filePath();
-			Dataset* dataset = new Dataset();
-			success = deserializeDataset(filePath, dataset);
-			if(success)
-				datasetList.push_back(dataset);
-			else
-				break;
-		}
-	}
-	catch(std::bad_alloc& ex)
-	{
-		QMessageBox* dialog = new QMessageBox(this);
-		dialog->setWindowTitle(tr("Error"));
-		dialog->setText(__FILE__ ":" STR(__LINE__) " Memory allocation error");
-		dialog->setAttribute(Qt::WA_DeleteOnClose);
-		dialog->open();
-	}
-	
-	
 	SimulationConfig config;
 	try
 	{
-		if(success)
-		{
-			filePath = directory.filePath("_project.toml");
-			success  = deserializeSimulationConfig(filePath, &config, datasetList);
-		}
+		filePath = directory.filePath("_project.toml");
+		success  = deserializeSimulationConfig(filePath, &config, datasetList);
 	}
 	catch(std::bad_alloc& ex)
 	{
@@ -492,12 +523,18 @@ void MapWindow::openProject(const QString& directoryPath)
 		dialog->setText(__FILE__ ":" STR(__LINE__) " Memory allocation error");
 		dialog->setAttribute(Qt::WA_DeleteOnClose);
 		dialog->open();
+		success = false;
 	}
 	
 	
 	if(success)
 	{
+		// The current datasets are deleted by the reset, do not pull them from under the worker
+		datasetControlWidget->waitForResolutionChange();
+		
 		datasets->reset(std::move(datasetList));
+		journal.clear();
+		updateUndoActions();
 		globalSimulationConfig = std::move(config);
 		
 		setWindowFilePath(directoryPath);
@@ -518,6 +555,132 @@ void MapWindow::openProject(const QString& directoryPath)
 }
 
 
+// Reads the files on the thread pool, one dataset per task. loadDatasetsEnd() gets the results on this thread
+// Datasets are added to the list when `projectPath` is empty, otherwise they replace the project
+void MapWindow::loadDatasetsBegin(const QStringList& paths, const QString& projectPath)
+{
+	if(isLoadingDatasets())
+	{
+		statusBar()->showMessage(tr("Wait for the current loading to finish"), 5000);
+		return;
+	}
+	
+	datasetLoadPending     = true;
+	datasetLoadCancelled   = false;
+	datasetLoadProjectPath = projectPath;
+	
+	// NOTE: Cancelled tasks still report a result, cancelling the future itself would drop the datasets already read
+	std::function<DatasetLoadResult(const QString&)> load = [this](const QString& path)
+	{
+		DatasetLoadResult result;
+		result.path = path;
+		if(datasetLoadCancelled)
+			return result;
+		
+		Dataset* dataset = nullptr;
+		try
+		{
+			dataset = new Dataset();
+			if(readDatasetFile(path, dataset, &result.error, &datasetLoadCancelled))
+				result.dataset = dataset;
+			else
+				delete dataset;
+		}
+		catch(std::bad_alloc& ex)
+		{
+			delete dataset;
+			result.error = tr("Not enough memory to load '%1'").arg(path);
+		}
+		return result;
+	};
+	
+	onDatasetLoadProgress(0);
+	datasetLoadWatcher.setFuture(QtConcurrent::mapped(paths, load));
+	cancelLoadButton->setVisible(true);
+}
+
+
+void MapWindow::onDatasetLoadProgress(int loadedCount)
+{
+	int totalCount = datasetLoadWatcher.progressMaximum();
+	statusBar()->showMessage(tr("Loading datasets... %1 of %2").arg(loadedCount).arg(totalCount));
+}
+
+
+void MapWindow::onActionCancelLoad()
+{
+	datasetLoadCancelled = true;
+	statusBar()->showMessage(tr("Cancelling..."));
+}
+
+
+void MapWindow::loadDatasetsEnd()
+{
+	// NOTE: Runs twice when closeEvent() gets there before the watcher signal
+	if(!isLoadingDatasets())
+		return;
+	datasetLoadPending = false;
+	
+	cancelLoadButton->setVisible(false);
+	statusBar()->clearMessage();
+	
+	std::list<Dataset*> datasetList;
+	std::list<QString>  paths;
+	QString             error;
+	for(const DatasetLoadResult& result : datasetLoadWatcher.future().results())
+	{
+		if(result.dataset)
+		{
+			datasetList.push_back(result.dataset);
+			paths.push_back(result.path);
+		}
+		else if(error.isEmpty())
+		{
+			error = result.error;
+		}
+	}
+	datasetLoadWatcher.setFuture(QFuture<DatasetLoadResult>());
+	
+	
+	if(datasetLoadCancelled)
+	{
+		for(Dataset* dataset : datasetList)
+			delete dataset;
+		statusBar()->showMessage(tr("Loading cancelled"), 5000);
+		return;
+	}
+	
+	if(!error.isEmpty())
+	{
+		QMessageBox* dialog = new QMessageBox(this);
+		dialog->setWindowTitle(tr("File error"));
+		dialog->setText(error);
+		dialog->setAttribute(Qt::WA_DeleteOnClose);
+		dialog->open();
+		
+		// A project is all or nothing, single files that loaded fine are still added
+		if(!datasetLoadProjectPath.isEmpty())
+		{
+			for(Dataset* dataset : datasetList)
+				delete dataset;
+			return;
+		}
+	}
+	
+	if(datasetLoadProjectPath.isEmpty())
+		openFilesEnd(std::move(datasetList), paths);
+	else
+		openProjectEnd(datasetLoadProjectPath, std::move(datasetList));
+}
+
+
+bool MapWindow::isLoadingDatasets()
+{
+	bool result = datasetLoadPending;
+	return result;
+}
+
+
 void MapWindow::onActionSaveFile()
 {
 	Dataset* dataset = datasetListWidget->selection();
@@ -558,12 +721,17 @@ void MapWindow::saveFileBegin(Dataset* dataset, const QString& path)
 		
 		QFileDialog* dialog = new QFileDialog(this);
 		dialog->setWindowTitle(tr("Save File"));
-		dialog->setNameFilter(tr("TOML+H3 (*.h3);;All Files (*)"));
+		dialog->setNameFilter(tr("TOML+H3 (*.h3);;H3 binary (*.h3b);;All Files (*)"));
 		dialog->setAcceptMode(QFileDialog::AcceptSave);
 		dialog->setAttribute(Qt::WA_DeleteOnClose);
 		dialog->setProperty("dataset", QVariant::fromValue(dataset));
 		dialog->selectFile(filename);
 		dialog->setDefaultSuffix("h3");
+		// NOTE: writeDatasetFile() picks the format from the suffix
+		QObject::connect(dialog, &QFileDialog::filterSelected, dialog, [dialog](const QString& filter)
+		{
+			dialog->setDefaultSuffix(filter.contains("*.h3b") ? "h3b" : "h3");
+		});
 		QObject::connect(dialog, &QFileDialog::accepted, this, &MapWindow::onSaveFileDialogAccepted);
 		dialog->open();
 	}
@@ -655,14 +823,18 @@ void MapWindow::saveProjectEnd(const QString& directoryPath)
 	
 	for(Dataset* dataset : *datasets)
 	{
-		QString filename = QString::fromStdString(dataset->id) + ".h3";
-		filePath = directory.filePath(filename);
+		DatasetSaveState& saveState = datasetSaveStates[dataset];
+		filePath = projectDatasetPath(directoryPath, dataset, QString::fromStdString(saveState.path));
 		success = serializeDataset(filePath, dataset);
 		if(!success)
 			break;
 		
-		datasetSaveStates[dataset].path     = filePath.toStdString();
-		datasetSaveStates[dataset].modified = false;
+		// NOTE: A file of the dataset in the other format would be loaded along with this one when the project is opened
+		QString otherSuffix = QFileInfo(filePath).suffix() == "h3b" ? ".h3" : ".h3b";
+		QFile::remove(directory.filePath(QString::fromStdString(dataset->id) + otherSuffix));
+		
+		saveState.path     = filePath.toStdString();
+		saveState.modified = false;
 	}
 	
 	if(success)
@@ -766,6 +938,86 @@ void MapWindow::onActionConfigureSimulation()
 }
 
 
+void MapWindow::onActionUndo()
+{
+	// NOTE: Both modify datasets, which may be read by the resolution change worker
+	if(datasetControlWidget->isResolutionChangePending() || !journal.canUndo())
+		return;
+	
+	cancelGridPolyfill();
+	try
+	{
+		onEditJournalApplied(journal.undo());
+	}
+	catch(std::bad_alloc& ex)
+	{
+		QMessageBox::critical(this, tr("Memory allocation error"), tr("Not enough memory to undo, the edit history was cleared"));
+		journal.clear();
+	}
+	updateUndoActions();
+}
+
+
+void MapWindow::onActionRedo()
+{
+	if(datasetControlWidget->isResolutionChangePending() || !journal.canRedo())
+		return;
+	
+	cancelGridPolyfill();
+	try
+	{
+		onEditJournalApplied(journal.redo());
+	}
+	catch(std::bad_alloc& ex)
+	{
+		QMessageBox::critical(this, tr("Memory allocation error"), tr("Not enough memory to redo, the edit history was cleared"));
+		journal.clear();
+	}
+	updateUndoActions();
+}
+
+
+void MapWindow::onEditJournalApplied(const EditJournal::Change& change)
+{
+	Dataset* dataset = change.dataset;
+	if(!dataset)
+		return;
+	setWindowModified(true);
+	
+	// NOTE: The journal holds entries of every dataset, only the selected one is on the map
+	if(dataset != datasetListWidget->selection())
+		return;
+	
+	mapView->refreshValuesRange();
+	if(dataset->resolution != change.oldResolution)
+	{
+		if(dataset->resolution < change.oldResolution)
+			onDatasetResolutionDecreased(dataset->resolution, change.oldResolution);
+		else
+			onDatasetResolutionIncreased(dataset->resolution, change.oldResolution);
+		datasetControlWidget->refreshViews(dataset);
+		mapView->requestRepaint();
+	}
+	else
+	{
+		CompactCellSet changedIndices;
+		changedIndices.reset(dataset->resolution);
+		changedIndices.insert(change.indices.begin(), change.indices.end());
+		datasetControlWidget->refreshStatistics(dataset);
+		mapView->invalidateCells(changedIndices);
+		mapView->requestRepaint(changedIndices);
+	}
+	writeHighlightedGeoValuesIntoLineEdit();
+}
+
+
+void MapWindow::updateUndoActions()
+{
+	undoAction->setEnabled(journal.canUndo());
+	redoAction->setEnabled(journal.canRedo());
+}
+
+
 void MapWindow::onActionZoomOut()
 {
 	QPoint vsAnchor = mapView->viewport()->rect().center();
@@ -810,10 +1062,36 @@ void MapWindow::onDatasetListItemCreated(Dataset* dataset)
 
 void MapWindow::onDatasetListItemSelected(Dataset* currentDataset, Dataset* previousDataset)
 {
+	cancelGridPolyfill();
+	
+	// NOTE: Only a sample of the cells of mapped files was checked when they were opened. The map and the dense slots
+	// index arrays by the cells, so a dataset with a bad one is dropped here, before anything draws it
+	QString error;
+	if(currentDataset && !checkDatasetIndices(currentDataset, &error))
+	{
+		QMessageBox* dialog = new QMessageBox(this);
+		dialog->setWindowTitle(tr("Error"));
+		dialog->setText(error);
+		dialog->setAttribute(Qt::WA_DeleteOnClose);
+		dialog->open();
+		
+		// NOTE: The list is in the middle of changing its selection, it is safer to remove the item once it is done
+		Dataset* brokenDataset = currentDataset;
+		QMetaObject::invokeMethod(this, [this, brokenDataset]()
+		{
+			if(datasets->removeItem(brokenDataset))
+			{
+				onDatasetListItemDeleted(brokenDataset);
+				delete brokenDataset;
+			}
+		}, Qt::QueuedConnection);
+		currentDataset = nullptr;
+	}
+	
 	if(currentDataset)
 	{
-		highlightedIndices.clear();
-		gridIndices.clear();
+		highlightedIndices.reset(currentDataset->resolution);
+		gridIndices.reset(currentDataset->resolution);
 		
 		geoValueEditLine->setPlaceholderText(QString::fromStdString(currentDataset->measureUnit));
 		writeHighlightedGeoValuesIntoLineEdit();
@@ -840,6 +1118,8 @@ void MapWindow::onDatasetListItemSelected(Dataset* currentDataset, Dataset* prev
 void MapWindow::onDatasetListItemDeleted(Dataset* dataset)
 {
 	datasetSaveStates.erase(dataset);
+	journal.forget(dataset);
+	updateUndoActions();
 	
 	for(SimulationConfig::Load::HistoryEntry& entry : globalSimulationConfig.load.history)
 		if(entry.datasets.count(dataset) > 0)
@@ -847,10 +1127,54 @@ void MapWindow::onDatasetListItemDeleted(Dataset* dataset)
 }
 
 
+void MapWindow::onDatasetResolutionChangeStarted(Dataset* dataset)
+{
+	// NOTE: The grid is converted to the new resolution, so it must be complete before then
+	cancelGridPolyfill();
+	
+	// The dataset is being read on another thread. Nothing may modify or delete it until onDatasetResolutionChanged()
+	datasetListWidget->setEnabled(false);
+	geoValueEditLine->setEnabled(false);
+	statusBar()->showMessage(tr("Changing resolution..."));
+}
+
+
+void MapWindow::onDatasetResolutionChangeProgress(Dataset* dataset, int percent)
+{
+	statusBar()->showMessage(tr("Changing resolution... %1%").arg(percent));
+}
+
+
+void MapWindow::onDatasetResolutionAboutToChange(Dataset* dataset)
+{
+	try
+	{
+		journal.recordResolutionChange(dataset);
+	}
+	catch(std::bad_alloc& ex)
+	{
+		// NOTE: The older entries expect the values that are about to be replaced, they cannot be applied anymore
+		journal.clear();
+		statusBar()->showMessage(tr("Not enough memory to keep the edit history"), 5000);
+	}
+	updateUndoActions();
+}
+
+
 void MapWindow::onDatasetResolutionChanged(Dataset* dataset, int oldResolution)
 {
 	assert(IS_VALID_RESOLUTION(dataset->resolution));
 	
+	datasetListWidget->setEnabled(true);
+	statusBar()->clearMessage();
+	
+	// NOTE: A failed change leaves the dataset as it was
+	if(dataset->resolution == oldResolution)
+	{
+		writeHighlightedGeoValuesIntoLineEdit();
+		return;
+	}
+	
 	try
 	{
 		if(dataset->resolution < oldResolution)
@@ -864,6 +1188,8 @@ void MapWindow::onDatasetResolutionChanged(Dataset* dataset, int oldResolution)
 			onDatasetResolutionIncreased(dataset->resolution, oldResolution);
 		}
 		
+		datasetControlWidget->refreshStatistics(dataset);
+		mapView->refreshValuesRange();
 		mapView->requestRepaint();
 		setWindowModified(true);
 	}
@@ -872,62 +1198,43 @@ void MapWindow::onDatasetResolutionChanged(Dataset* dataset, int oldResolution)
 		QMessageBox::critical(this, tr("Memory allocation error"), tr("Not enough memory to store new values"));
 		// TODO: Let application crash? Data consistency is not enforced anyway
 	}
+	writeHighlightedGeoValuesIntoLineEdit();
 }
 
 
+// NOTE: Both selections are compacted, so this only touches their stored cells, not every selected cell
 void MapWindow::onDatasetResolutionDecreased(int newResolution, int oldResolution)
 {
-	HashSet<H3Index> hlIndices;
-	for(H3Index childIndex : highlightedIndices)
-	{
-		H3Index parentIndex = h3ToParent(childIndex, newResolution);
-		assert(parentIndex != H3_INVALID_INDEX);
-		hlIndices.insert(parentIndex);
-	}
-	this->highlightedIndices = std::move(hlIndices);
-	
-	
-	HashSet<H3Index> gIndices;
-	for(H3Index childIndex : gridIndices)
-	{
-		H3Index parentIndex = h3ToParent(childIndex, newResolution);
-		assert(parentIndex != H3_INVALID_INDEX);
-		gIndices.insert(parentIndex);
-	}
-	gridIndices = std::move(gIndices);
+	highlightedIndices.setResolution(newResolution);
+	gridIndices.setResolution(newResolution);
 }
 
 
 void MapWindow::onDatasetResolutionIncreased(int newResolution, int oldResolution)
 {
-	uint64_t childrenBufferLength = h3MaxChildrenCount(oldResolution, newResolution);
-	H3Index* childrenBuffer       = new H3Index[childrenBufferLength];
-	
-	HashSet<H3Index> newHighlightIndices;
-	for(H3Index parentIndex : highlightedIndices)
-	{
-		h3ToChildren(parentIndex, newResolution, childrenBuffer);
-		newHighlightIndices.insert(childrenBuffer, childrenBuffer + childrenBufferLength);
-	}
-	newHighlightIndices.erase(H3_INVALID_INDEX);
-	highlightedIndices = std::move(newHighlightIndices);
-	
-	
-	HashSet<H3Index> newGridIndices;
-	for(H3Index parentIndex : gridIndices)
-	{
-		h3ToChildren(parentIndex, newResolution, childrenBuffer);
-		newGridIndices.insert(childrenBuffer, childrenBuffer + childrenBufferLength);
-	}
-	newGridIndices.erase(H3_INVALID_INDEX);
-	gridIndices = std::move(newGridIndices);
-	
-	delete[] childrenBuffer;
+	highlightedIndices.setResolution(newResolution);
+	gridIndices.setResolution(newResolution);
+}
+
+
+void MapWindow::onDatasetAggregationChanged(Dataset* dataset, Dataset::Aggregation oldAggregation)
+{
+	// NOTE: Zoomed out maps draw values aggregated to coarser resolutions, see Dataset::lodGeoValues()
+	dataset->invalidateLod();
+	mapView->invalidateTiles();
+	mapView->requestRepaint();
+	setWindowModified(true);
 }
 
 
 void MapWindow::onDatasetDefaultChanged(Dataset* dataset, GeoValue oldDefaultValue)
 {
+	if(dataset->aggregation == Dataset::Aggregation::MeanWithDefault)
+	{
+		dataset->invalidateLod();
+		mapView->invalidateTiles();
+		mapView->requestRepaint();
+	}
 	setWindowModified(true);
 }
 
@@ -950,12 +1257,21 @@ void MapWindow::onGeoValueEditFinished()
 	Dataset* dataset = datasetListWidget->selection();
 	assert(dataset);
 	
+	if(datasetControlWidget->isResolutionChangePending())
+		return;
+	
 	size_t affectedCellsCount = 0;
 	if(geoValueEditLine->text().isEmpty())
 	{
-		for(H3Index hlIndex : highlightedIndices)
+		try
+		{
+			std::vector<H3Index> indices = expandHighlightedIndices();
+			journal.recordRemoval(dataset, indices.data(), indices.size());
+			affectedCellsCount = dataset->removeGeoValues(indices.data(), indices.size());
+		}
+		catch(std::bad_alloc& ex)
 		{
-			affectedCellsCount += dataset->removeGeoValue(hlIndex);
+			QMessageBox::critical(this, tr("Memory allocation error"), tr("Not enough memory to store new values"));
 		}
 	}
 	else
@@ -971,10 +1287,9 @@ void MapWindow::onGeoValueEditFinished()
 		{
 			try
 			{
-				for(H3Index hlIndex : highlightedIndices)
-				{
-					affectedCellsCount += dataset->updateGeoValue(hlIndex, geoValue);
-				}
+				std::vector<H3Index> indices = expandHighlightedIndices();
+				journal.recordUpdate(dataset, indices.data(), indices.size(), geoValue);
+				affectedCellsCount = dataset->updateGeoValues(indices.data(), indices.size(), geoValue);
 			}
 			catch(std::bad_alloc& ex)
 			{
@@ -990,14 +1305,29 @@ void MapWindow::onGeoValueEditFinished()
 //		setWindowModified(saveState.modified);
 		
 		setWindowModified(true);
-		mapView->requestRepaint();
+		datasetControlWidget->refreshStatistics(dataset);
+		mapView->refreshValuesRange();
+		mapView->invalidateCells(highlightedIndices);
+		mapView->requestRepaint(highlightedIndices);
 	}
+	updateUndoActions();
+}
+
+
+// The highlighted cells one by one, for the bulk edits of Dataset
+std::vector<H3Index> MapWindow::expandHighlightedIndices() const
+{
+	std::vector<H3Index> result;
+	result.reserve(highlightedIndices.size());
+	for(H3Index index : highlightedIndices)
+		result.push_back(index);
+	return result;
 }
 
 
 void MapWindow::writeHighlightedGeoValuesIntoLineEdit()
 {
-	if(highlightedIndices.size() > 0)
+	if(!highlightedIndices.empty())
 	{
 		Dataset* dataset = datasetListWidget->selection();
 		assert(dataset);
@@ -1095,6 +1425,11 @@ void MapWindow::onMapViewCellSelected(H3Index index)
 	if(!dataset)
 		return;
 	
+	// Cells whose highlight changes, the only ones to repaint
+	CompactCellSet dirtyIndices;
+	dirtyIndices.reset(dataset->resolution);
+	dirtyIndices.insert(index);
+	
 #if ENABLE_CELL_SELECTION_TOOLS
 	if(mapTool == MapTool::Mark)
 		highlightedIndices.insert(index);
@@ -1105,14 +1440,16 @@ void MapWindow::onMapViewCellSelected(H3Index index)
 	Qt::KeyboardModifiers ctrl = QApplication::keyboardModifiers() & Qt::ControlModifier;
 	if(ctrl)
 	{
-		if(highlightedIndices.count(index) == 0)
+		if(!highlightedIndices.contains(index))
 			highlightedIndices.insert(index);
 		else
 			highlightedIndices.erase(index);
 	}
 	else
 	{
-		highlightedIndices.clear();
+		// NOTE: The previous highlights are moved out rather than cleared, they need a repaint too
+		std::swap(dirtyIndices, highlightedIndices);
+		dirtyIndices.insert(index);
 		highlightedIndices.insert(index);
 	}
 	
@@ -1121,10 +1458,13 @@ void MapWindow::onMapViewCellSelected(H3Index index)
 	writeHighlightedGeoValuesIntoLineEdit();
 	if(QApplication::focusWidget() == geoValueEditLine)
 		geoValueEditLine->selectAll();
-	mapView->requestRepaint();
+	mapView->requestRepaint(dirtyIndices);
 }
 
 
+// Polyfills the selected area on the thread pool, one tile of the area per task. Cells show up as the tiles finish
+// NOTE: Tile edges are lines of constant latitude or longitude, and H3 polyfill works in those coordinates too, so
+// every cell center of the area falls in one tile
 void MapWindow::onMapViewAreaSelected(QRectF area)
 {
 	assert(datasets);
@@ -1133,38 +1473,115 @@ void MapWindow::onMapViewAreaSelected(QRectF area)
 	if(!dataset)
 		return;
 	
-	GeoCoord geoCorners[4];
-	toGeoCoord(area, mapView->sceneRect().size(), geoCorners);
+	QSizeF sceneSize  = mapView->sceneRect().size();
+	int    resolution = dataset->resolution;
 	
-	GeoPolygon geoPolygon        = {};
-	geoPolygon.geofence.numVerts = 4;
-	geoPolygon.geofence.verts    = geoCorners;
-	uint64_t polyfillIndicesCount = maxPolyfillSize(&geoPolygon, dataset->resolution);
+	cancelGridPolyfill();
+	gridIndices.reset(resolution);
+	auto toGeoPolygon = [sceneSize](const QRectF& area, GeoCoord* geoCorners)
+	{
+		toGeoCoord(area, sceneSize, geoCorners);
+		GeoPolygon geoPolygon        = {};
+		geoPolygon.geofence.numVerts = 4;
+		geoPolygon.geofence.verts    = geoCorners;
+		return geoPolygon;
+	};
+	
+	GeoCoord   geoCorners[4];
+	GeoPolygon geoPolygon  = toGeoPolygon(area, geoCorners);
+	uint64_t   chunksCount = maxPolyfillSize(&geoPolygon, resolution) / POLYFILL_CHUNK_INDICES + 1;
+	int        tilesPerRow = int(std::ceil(std::sqrt(double(chunksCount))));
 	
-	if(polyfillIndicesCount < POLYFILL_INDEX_THRESHOLD)
+	std::vector<QRectF> tiles;
+	tiles.reserve(size_t(tilesPerRow) * tilesPerRow);
+	for(int row = 0; row < tilesPerRow; ++row)
 	{
+		for(int column = 0; column < tilesPerRow; ++column)
+		{
+			QPointF topLeft     = area.topLeft() + QPointF(area.width() * column       / tilesPerRow, area.height() * row       / tilesPerRow);
+			QPointF bottomRight = area.topLeft() + QPointF(area.width() * (column + 1) / tilesPerRow, area.height() * (row + 1) / tilesPerRow);
+			tiles.push_back(QRectF(topLeft, bottomRight));
+		}
+	}
+	
+	std::function<GridPolyfillResult(const QRectF&)> polyfillTile = [toGeoPolygon, resolution](const QRectF& tile)
+	{
+		GridPolyfillResult result;
 		try
 		{
-			H3Index* buffer = new H3Index[polyfillIndicesCount];
-			polyfill(&geoPolygon, dataset->resolution, buffer);
-			gridIndices.clear();
-			gridIndices.insert(buffer, buffer+polyfillIndicesCount);
-			gridIndices.erase(H3_INVALID_INDEX);
-			delete[] buffer;
+			GeoCoord   geoCorners[4];
+			GeoPolygon geoPolygon = toGeoPolygon(tile, geoCorners);
+			result.indices.resize(maxPolyfillSize(&geoPolygon, resolution), H3_INVALID_INDEX);
+			polyfill(&geoPolygon, resolution, result.indices.data());
+			result.indices.erase(std::remove(result.indices.begin(), result.indices.end(), H3_INVALID_INDEX), result.indices.end());
 		}
 		catch(std::bad_alloc& ex)
 		{
-			QMessageBox::critical(this, tr("Error"), tr("Not enough memory to polyfill the selected area"));
+			result.indices = std::vector<H3Index>();
+			result.outOfMemory = true;
 		}
-		
-		mapView->requestRepaint();
+		return result;
+	};
+	
+	gridPolyfillPending     = true;
+	gridPolyfillOutOfMemory = false;
+	gridPolyfillWatcher.setFuture(QtConcurrent::mapped(tiles, polyfillTile));
+	onGridPolyfillProgress(0);
+	mapView->requestRepaint();
+}
+
+
+void MapWindow::onGridPolyfillResultReady(int tile)
+{
+	GridPolyfillResult result = gridPolyfillWatcher.resultAt(tile);
+	gridPolyfillOutOfMemory |= result.outOfMemory;
+	
+	try
+	{
+		gridIndices.insert(result.indices.begin(), result.indices.end());
 	}
-	else
+	catch(std::bad_alloc& ex)
 	{
-		QString message      = tr("Area too large. Operation aborted to prevent application freeze");
-		int     milliseconds = 10000;
-		statusBar()->showMessage(message, milliseconds);
+		gridPolyfillOutOfMemory = true;
 	}
+	mapView->requestRepaint();
+}
+
+
+void MapWindow::onGridPolyfillProgress(int tilesCount)
+{
+	int totalCount = gridPolyfillWatcher.progressMaximum();
+	statusBar()->showMessage(tr("Filling grid... %1 of %2").arg(tilesCount).arg(totalCount));
+}
+
+
+void MapWindow::onGridPolyfillFinished()
+{
+	// NOTE: Also runs for the empty future set below and in cancelGridPolyfill()
+	if(!gridPolyfillPending)
+		return;
+	gridPolyfillPending = false;
+	
+	statusBar()->clearMessage();
+	gridPolyfillWatcher.setFuture(QFuture<GridPolyfillResult>());
+	
+	if(gridPolyfillOutOfMemory)
+		QMessageBox::critical(this, tr("Error"), tr("Not enough memory to polyfill the selected area"));
+}
+
+
+// Stops filling the grid, keeping the cells of the tiles that are already done
+void MapWindow::cancelGridPolyfill()
+{
+	if(!gridPolyfillPending)
+		return;
+	gridPolyfillPending = false;
+	
+	// NOTE: Setting a new future drops the signals of the old one that were not delivered yet
+	gridPolyfillWatcher.cancel();
+	gridPolyfillWatcher.waitForFinished();
+	gridPolyfillWatcher.setFuture(QFuture<GridPolyfillResult>());
+	statusBar()->clearMessage();
 }
 
 
@@ -1367,175 +1784,20 @@ bool MapWindow::serializeSimulationConfig(const QString& path, SimulationConfig*
 }
 
 
-bool MapWindow::deserializeDataset(const QString& path, Dataset* dataset)
-{
-	std::ifstream stream(path.toStdString());
-	if(!stream.is_open())
-	{
-		char*   errString = strerror(errno);
-		QString text      = tr("Cannot open '%1' for reading: %2").arg(path).arg(errString);
-		
-		QMessageBox* dialog = new QMessageBox(this);
-		dialog->setWindowTitle(tr("File error"));
-		dialog->setText(text);
-		dialog->setAttribute(Qt::WA_DeleteOnClose);
-		dialog->open();
-		return false;
-	}
-	
-	
-	std::shared_ptr<cpptoml::table> root = nullptr;
-	try
-	{
-		cpptoml::parser parser(stream);
-		root = parser.parse();
-		stream.close();
-	}
-	catch(cpptoml::parse_exception& ex)
-	{
-		stream.close();
-		
-		QMessageBox* dialog = new QMessageBox(this);
-		dialog->setWindowTitle(tr("File error"));
-		dialog->setText(tr("Cannot parse '%1'").arg(path));
-		dialog->setInformativeText(ex.what());
-		dialog->setAttribute(Qt::WA_DeleteOnClose);
-		dialog->open();
-		return false;
-	}
-	
-	
-	dataset->id          = root->get_qualified_as<std::string>("giagui.name").value_or(QFileInfo(path).baseName().toStdString());
-	dataset->resolution  = root->get_qualified_as<int>("h3.resolution").value_or(0);
-	dataset->isInteger   = root->get_qualified_as<std::string>("h3.type").value_or("1f").back() == 'i';
-	dataset->density     = root->get_qualified_as<double>("h3.density").value_or(Dataset::NO_DENSITY);
-	dataset->measureUnit = ""; // TODO: This is not really useful. Remove it?
-	dataset->minValue    = {0};
-	dataset->maxValue    = {0};
-	
-	if(dataset->isInteger)
-	{
-		dataset->defaultValue.integer = root->get_qualified_as<int64_t>("h3.default").value_or(0);
-		
-		for(auto& [key, val] : *root->get_table_qualified("h3.values"))
-		{
-			H3Index  index    = std::stoull(key, nullptr, 16);
-			GeoValue geoValue = {0};
-			geoValue.integer = val->as<int64_t>()->get();
-			dataset->geoValues.insert({index, geoValue});
-			
-			if(dataset->minValue.integer > geoValue.integer)
-				dataset->minValue.integer = geoValue.integer;
-			if(dataset->maxValue.integer < geoValue.integer)
-				dataset->maxValue.integer = geoValue.integer;
-		}
-	}
-	else
-	{
-		dataset->defaultValue.real = root->get_qualified_as<double>("h3.default").value_or(0);
-		
-		for(auto& [key, val] : *root->get_table_qualified("h3.values"))
-		{
-			H3Index  index    = std::stoull(key, nullptr, 16);
-			GeoValue geoValue = {0};
-			geoValue.real = val->as<double>()->get();
-			dataset->geoValues.insert({index, geoValue});
-			
-			if(dataset->minValue.real > geoValue.real)
-				dataset->minValue.real = geoValue.real;
-			if(dataset->maxValue.real < geoValue.real)
-				dataset->maxValue.real = geoValue.real;
-		}
-	}
-	
-	return true;
-}
-
-
 bool MapWindow::serializeDataset(const QString& path, Dataset* dataset)
 {
 	if(path.size() == 0)
 		return false;
 	
-	std::ofstream fileStream(path.toStdString());
-	if(!fileStream.is_open())
-	{
-		char*   errString = strerror(errno);
-		QString text      = tr("Cannot open '%1' for writing: %2").arg(path).arg(errString);
-		
-		QMessageBox* dialog = new QMessageBox(this);
-		dialog->setWindowTitle(tr("File error"));
-		dialog->setText(text);
-		dialog->setAttribute(Qt::WA_DeleteOnClose);
-		dialog->open();
-		return false;
-	}
-	
-	std::stringstream stream;
-	stream << std::fixed << std::showpoint;
-	
-	
-	stream << "[giagui]"                       << std::endl;
-	stream << "name = '" << dataset->id << "'" << std::endl;
-	stream << std::endl;
-	
-	
-	stream << "[h3]" << std::endl;
-	stream << "resolution = "  << dataset->resolution << std::endl;
-	
-	if(dataset->isInteger)
-	{
-		stream << "type = '1i'"                                 << std::endl;
-		stream << "default = " << dataset->defaultValue.integer << std::endl;
-	}
-	else
-	{
-		stream << "type = '1f'"                              << std::endl;
-		stream << "default = " << dataset->defaultValue.real << std::endl;
-	}
-	
-	if(dataset->hasDensity())
-	{
-		stream << "density = " << dataset->density << std::endl;
-	}
-	stream << std::endl;
-	
-	
-	stream << "[h3.values]" << std::endl;
-	if(dataset->isInteger)
-	{
-		for(auto [index, geoValue] : dataset->geoValues)
-		{
-			stream << std::hex << index;
-			stream << " = ";
-			stream << std::dec << geoValue.integer;
-			stream << std::endl;
-		}
-	}
-	else
-	{
-		for(auto [index, geoValue] : dataset->geoValues)
-		{
-			stream << std::hex << index;
-			stream << " = ";
-			stream << geoValue.real;
-			stream << std::endl;
-		}
-	}
-	
-	
-	fileStream << stream.str();
-	if(fileStream.fail())
+	QString error;
+	bool success = writeDatasetFile(path, dataset, &error);
+	if(!success)
 	{
-		char*   errString = strerror(errno);
-		QString text      = tr("Cannot write data to '%1': %2").arg(path).arg(errString);
-		
 		QMessageBox* dialog = new QMessageBox(this);
 		dialog->setWindowTitle(tr("File error"));
-		dialog->setText(text);
+		dialog->setText(error);
 		dialog->setAttribute(Qt::WA_DeleteOnClose);
 		dialog->open();
-		return false;
 	}
-	return true;
+	return success;
 }
@@ -2,11 +2,16 @@
 #define GIAGUI_MAPWINDOW_H
 
 
+#include <atomic>
 #include <utility>
 #include <queue>
+#include <vector>
+#include <QFutureWatcher>
 #include <QMainWindow>
 #include <cpptoml.h>
+#include "CompactCellSet.hpp"
 #include "Dataset.hpp"
+#include "EditJournal.hpp"
 #include "MapUtils.hpp"
 
 
@@ -16,10 +21,12 @@ class QKeyEvent;
 class QCloseEvent;
 class QMouseEvent;
 class QWidget;
+class QAction;
 class QMenuBar;
 class QToolBar;
 class QLabel;
 class QLineEdit;
+class QPushButton;
 class IntSpinBox;
 class DatasetListWidget;
 class DatasetControlWidget;
@@ -40,6 +47,19 @@ public:
 		Grid,
 	};
 	
+	struct DatasetLoadResult
+	{
+		QString  path;
+		Dataset* dataset = nullptr; // Null if the file could not be read
+		QString  error;
+	};
+	
+	struct GridPolyfillResult
+	{
+		std::vector<H3Index> indices;
+		bool                 outOfMemory = false;
+	};
+	
 	struct DatasetSaveState
 	{
 		std::string path     = "";
@@ -53,15 +73,29 @@ public:
 	DatasetListModel* datasets = nullptr;
 	
 	// Collection of user-selected cells to highlight in UI
-	HashSet<H3Index> highlightedIndices;
+	CompactCellSet highlightedIndices;
 	
 	// Collection of indices used to draw the grid
-	HashSet<H3Index> gridIndices;
+	CompactCellSet gridIndices;
 	
 	HashMap<Dataset*, DatasetSaveState> datasetSaveStates;
 	
+	// Edits and resolution changes of all datasets, see onActionUndo()
+	EditJournal journal;
+	
 	MapTool mapTool = MapTool::Mark;
 	
+	// Datasets are read on the thread pool, see loadDatasetsBegin()
+	QFutureWatcher<DatasetLoadResult> datasetLoadWatcher;
+	std::atomic<bool>                 datasetLoadCancelled;
+	bool                              datasetLoadPending = false;
+	QString                           datasetLoadProjectPath;
+	
+	// The grid tool fills the selected area on the thread pool, see onMapViewAreaSelected()
+	QFutureWatcher<GridPolyfillResult> gridPolyfillWatcher;
+	bool                               gridPolyfillPending     = false;
+	bool                               gridPolyfillOutOfMemory = false;
+	
 	// Hack to store file to load. Used when loading a project and the user chooses to save the old project before loading 
 	QString loadPath;
 	
@@ -73,6 +107,9 @@ public:
 	IntSpinBox*           resolutionSpinbox    = nullptr;
 	QLabel*               statusLabel          = nullptr;
 	QToolBar*             toolBar              = nullptr;
+	QPushButton*          cancelLoadButton     = nullptr;
+	QAction*              undoAction           = nullptr;
+	QAction*              redoAction           = nullptr;
 	
 	
 	explicit MapWindow(QWidget* parent = nullptr);
@@ -90,10 +127,18 @@ public:
 	
 	void onActionOpenFile();
 	void onOpenFileDialogAccepted();
+	void openFilesEnd(std::list<Dataset*>&& datasetList, const std::list<QString>& paths);
 	
 	void onActionOpenProject();
 	void onOpenProjectDialogAccepted();
 	void openProject(const QString& directoryPath);
+	void openProjectEnd(const QString& directoryPath, std::list<Dataset*>&& datasetList);
+	
+	void loadDatasetsBegin(const QStringList& paths, const QString& projectPath);
+	void onDatasetLoadProgress(int loadedCount);
+	void onActionCancelLoad();
+	void loadDatasetsEnd();
+	bool isLoadingDatasets();
 	
 	void onActionSaveFile();
 	void onActionSaveAs();
@@ -115,6 +160,11 @@ public:
 	
 	void onActionConfigureSimulation();
 	
+	void onActionUndo();
+	void onActionRedo();
+	void onEditJournalApplied(const EditJournal::Change& change);
+	void updateUndoActions();
+	
 	void onActionZoomOut();
 	void onActionZoomIn();
 	
@@ -126,9 +176,13 @@ public:
 	void onDatasetListItemSelected(Dataset* current, Dataset* previous);
 	void onDatasetListItemDeleted(Dataset* dataset);
 	
+	void onDatasetResolutionChangeStarted(Dataset* dataset);
+	void onDatasetResolutionChangeProgress(Dataset* dataset, int percent);
+	void onDatasetResolutionAboutToChange(Dataset* dataset);
 	void onDatasetResolutionChanged(Dataset* dataset, int oldResolution);
 	void onDatasetResolutionDecreased(int newResolution, int oldResolution);
 	void onDatasetResolutionIncreased(int newResolution, int oldResolution);
+	void onDatasetAggregationChanged(Dataset* dataset, Dataset::Aggregation oldAggregation);
 	void onDatasetDefaultChanged(Dataset* dataset, GeoValue oldDefaultValue);
 	void onDatasetDensityChanged(Dataset* dataset, double oldValue);
 	void onDatasetValueRangeChanged(Dataset* dataset, GeoValue oldMinValue, GeoValue oldMaxValue);
@@ -138,13 +192,17 @@ public:
 	void onMapViewMouseMove(QMouseEvent* event);
 	void onMapViewCellSelected(H3Index index);
 	void onMapViewAreaSelected(QRectF area);
+	void onGridPolyfillResultReady(int tile);
+	void onGridPolyfillProgress(int tilesCount);
+	void onGridPolyfillFinished();
+	void cancelGridPolyfill();
 	
+	std::vector<H3Index> expandHighlightedIndices() const;
 	void writeHighlightedGeoValuesIntoLineEdit();
 	
 	bool deserializeSimulationConfig(const QString& path, SimulationConfig* config, const std::list<Dataset*>& datasets);
 	bool serializeSimulationConfig(const QString& path, SimulationConfig* config);
 	
-	bool deserializeDataset(const QString& path, Dataset* dataset);
 	bool serializeDataset(const QString& path, Dataset* dataset);
 };
 
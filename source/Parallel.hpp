@@ -0,0 +1,43 @@
+#ifndef GIAGUI_PARALLEL_HPP
+#define GIAGUI_PARALLEL_HPP
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+
+// Splits [0, count) into ranges and calls `f(size_t begin, size_t end)` for each range on the global thread pool
+// Returns when all ranges are done. The calling thread takes part in the work, so this is safe to call from a pool thread
+// NOTE: Ranges are never shorter than `minRangeSize`, so small inputs run entirely on the calling thread
+template<typename F>
+void parallelFor(size_t count, size_t minRangeSize, F&& f)
+{
+	assert(minRangeSize > 0);
+	
+	// A few ranges per thread, so that threads that finish early can pick up more work
+	size_t threadCount = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+	size_t rangeCount  = std::min(threadCount * 4, (count + minRangeSize - 1) / minRangeSize);
+	if(rangeCount <= 1)
+	{
+		f(size_t(0), count);
+		return;
+	}
+	
+	std::vector<std::pair<size_t, size_t>> ranges;
+	ranges.reserve(rangeCount);
+	for(size_t i = 0; i < rangeCount; ++i)
+		ranges.push_back({count * i / rangeCount, count * (i+1) / rangeCount});
+	
+	QtConcurrent::blockingMap(ranges, [&f](std::pair<size_t, size_t>& range)
+	{
+		f(range.first, range.second);
+	});
+}
+
+
+#endif //GIAGUI_PARALLEL_HPP
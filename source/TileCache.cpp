@@ -0,0 +1,115 @@
+#include "TileCache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+
+static inline uint64_t tileKey(int level, int column, int row)
+{
+	return (uint64_t(level) << 56) | (uint64_t(row) << 28) | uint64_t(column);
+}
+
+
+void TileCache::reset(const Dataset* dataset, int resolution, QSizeF surfaceSize)
+{
+	if(this->dataset == dataset && this->resolution == resolution && this->surfaceSize == surfaceSize)
+		return;
+	
+	clear();
+	this->dataset     = dataset;
+	this->resolution  = resolution;
+	this->surfaceSize = surfaceSize;
+}
+
+
+void TileCache::clear()
+{
+	tiles.clear();
+}
+
+
+void TileCache::invalidate(const QRectF& area, int level)
+{
+	double extent    = tileExtent(level);
+	int    minColumn = std::max(0,                     int(std::floor(area.left()   / extent)));
+	int    maxColumn = std::min(columnCount(level) - 1, int(std::floor(area.right()  / extent)));
+	int    minRow    = std::max(0,                     int(std::floor(area.top()    / extent)));
+	int    maxRow    = std::min(rowCount(level) - 1,    int(std::floor(area.bottom() / extent)));
+	for(int row = minRow; row <= maxRow; ++row)
+		for(int column = minColumn; column <= maxColumn; ++column)
+			tiles.erase(tileKey(level, column, row));
+}
+
+
+int TileCache::levelForScale(double pixelsPerUnit) const
+{
+	// A tile of level L covers width/2^L units with TILE_SIZE pixels
+	double wanted = pixelsPerUnit * surfaceSize.width() / TILE_SIZE;
+	int    level  = wanted <= 1.0 ? 0 : int(std::ceil(std::log2(wanted)));
+	return level <= MAX_LEVEL ? level : -1;
+}
+
+
+double TileCache::tileExtent(int level) const
+{
+	assert(0 <= level && level <= MAX_LEVEL);
+	return surfaceSize.width() / double(1 << level);
+}
+
+
+int TileCache::columnCount(int level) const
+{
+	return 1 << level;
+}
+
+
+int TileCache::rowCount(int level) const
+{
+	return std::max(1, int(std::ceil(surfaceSize.height() / tileExtent(level))));
+}
+
+
+QRectF TileCache::tileRect(int level, int column, int row) const
+{
+	double extent = tileExtent(level);
+	return QRectF(column * extent, row * extent, extent, extent);
+}
+
+
+const QImage* TileCache::find(int level, int column, int row)
+{
+	auto it = tiles.find(tileKey(level, column, row));
+	if(it == tiles.end())
+		return nullptr;
+	it->second.lastUsedFrame = frame;
+	return &it->second.image;
+}
+
+
+void TileCache::insert(int level, int column, int row, QImage&& image)
+{
+	Tile& tile = tiles[tileKey(level, column, row)];
+	tile.image         = std::move(image);
+	tile.lastUsedFrame = frame;
+}
+
+
+void TileCache::endFrame()
+{
+	frame += 1;
+	if(tiles.size() <= MAX_TILES)
+		return;
+	
+	// NOTE: Evict down to 3/4 of the budget, so that the next few repaints do not have to sort again
+	std::vector<std::pair<uint64_t, uint64_t>> ages; // (last used frame, key)
+	ages.reserve(tiles.size());
+	for(const auto& [key, tile] : tiles)
+		ages.push_back({tile.lastUsedFrame, key});
+	std::sort(ages.begin(), ages.end());
+	
+	size_t evictCount = tiles.size() - MAX_TILES * 3 / 4;
+	for(size_t i = 0; i < evictCount; ++i)
+		tiles.erase(ages[i].second);
+}
@@ -0,0 +1,62 @@
+#ifndef GIAGUI_TILECACHE_HPP
+#define GIAGUI_TILECACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <QImage>
+#include <QRectF>
+#include <QSizeF>
+
+
+struct Dataset;
+
+
+// Rendered images of the dataset layer, so that panning and zooming only blit images
+// Tiles form a quadtree over the map: at level L the map is 2^L tiles wide, and every tile is TILE_SIZE pixels wide
+// whatever its level. MapView picks the smallest level whose tiles are at least as detailed as the screen
+// NOTE: Past MAX_LEVEL the cells are large and few of them are visible, so they are drawn directly instead
+struct TileCache
+{
+	static constexpr int    TILE_SIZE = 256;
+	static constexpr int    MAX_LEVEL = 6;
+	static constexpr size_t MAX_TILES = 512; // 128 MB of images. The least recently drawn tiles go first
+	
+	struct Tile
+	{
+		QImage   image;
+		uint64_t lastUsedFrame;
+	};
+	
+	
+	const Dataset*                     dataset    = nullptr;
+	int                                resolution = -1;
+	QSizeF                             surfaceSize;
+	uint64_t                           frame      = 0;
+	std::unordered_map<uint64_t, Tile> tiles;
+	
+	
+	// Drops all tiles if they were rendered for another dataset, resolution or map size
+	void reset(const Dataset* dataset, int resolution, QSizeF surfaceSize);
+	void clear();
+	
+	// Drops the tiles of `level` that overlap `area`, so that they are rendered again
+	void invalidate(const QRectF& area, int level);
+	
+	// Level at which a tile pixel is no larger than a screen pixel, or -1 if that is past MAX_LEVEL
+	int    levelForScale(double pixelsPerUnit) const;
+	double tileExtent(int level) const;
+	int    columnCount(int level) const;
+	int    rowCount(int level) const;
+	QRectF tileRect(int level, int column, int row) const;
+	
+	// Returns the tile, or null if it has to be rendered
+	const QImage* find(int level, int column, int row);
+	void          insert(int level, int column, int row, QImage&& image);
+	
+	// Marks the end of a repaint, and evicts tiles if there are too many
+	void endFrame();
+};
+
+
+#endif //GIAGUI_TILECACHE_HPP
@@ -1,6 +1,15 @@
+#include <cstdio>
+#include <cstring>
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QGuiApplication>
+#include <QImage>
+#include <QThread>
+#include <QThreadPool>
 
 #include "Dataset.hpp"
+#include "DatasetFile.hpp"
+#include "MapRenderer.hpp"
 #include "MapWindow.hpp"
 
 
@@ -9,8 +18,85 @@
  *********************************************************************/
 
 
+// Renders a dataset file to an image without opening any window, for batch jobs:
+//     giagui --render in.h3 out.png --size 4096x2048
+static int runRenderCommand(int argc, char *argv[])
+{
+	// NOTE: Batch nodes have no display. The offscreen platform still gives QPainter everything it needs
+	if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	QGuiApplication a(argc, argv);
+	
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QGuiApplication::tr("Renders a dataset on the world map into an image"));
+	parser.addHelpOption();
+	
+	QCommandLineOption renderOption("render", QGuiApplication::tr("Render <input> into <output> instead of opening a window."));
+	QCommandLineOption sizeOption("size", QGuiApplication::tr("Image size in pixels."), "WxH", "4096x2048");
+	QCommandLineOption threadsOption("threads", QGuiApplication::tr("Number of strips drawn in parallel."), "count", QString::number(QThread::idealThreadCount()));
+	QCommandLineOption colormapOption("colormap", QGuiApplication::tr("Hue, Viridis or Diverging."), "name", "Hue");
+	parser.addOptions({renderOption, sizeOption, threadsOption, colormapOption});
+	parser.addPositionalArgument("input",  QGuiApplication::tr("Dataset file, .h3 or .h3b."));
+	parser.addPositionalArgument("output", QGuiApplication::tr("Image file. The format follows the suffix, e.g. .png"));
+	parser.process(a);
+	
+	QStringList positional = parser.positionalArguments();
+	if(positional.size() != 2)
+	{
+		std::fprintf(stderr, "Expected an input and an output file\n");
+		return 1;
+	}
+	
+	QStringList sizeParts = parser.value(sizeOption).split('x');
+	bool widthIsValid  = false;
+	bool heightIsValid = false;
+	QSize size = sizeParts.size() == 2 ? QSize(sizeParts[0].toInt(&widthIsValid), sizeParts[1].toInt(&heightIsValid)) : QSize();
+	if(!widthIsValid || !heightIsValid || size.isEmpty())
+	{
+		std::fprintf(stderr, "Invalid size \"%s\", expected WIDTHxHEIGHT\n", qPrintable(parser.value(sizeOption)));
+		return 1;
+	}
+	
+	bool threadCountIsValid = false;
+	int  threadCount        = parser.value(threadsOption).toInt(&threadCountIsValid);
+	if(!threadCountIsValid || threadCount < 1)
+	{
+		std::fprintf(stderr, "Invalid thread count \"%s\"\n", qPrintable(parser.value(threadsOption)));
+		return 1;
+	}
+	
+	Colormap colormap;
+	if(!ColorLookup::colormapFromName(parser.value(colormapOption).toStdString(), &colormap))
+	{
+		std::fprintf(stderr, "Unknown colormap \"%s\"\n", qPrintable(parser.value(colormapOption)));
+		return 1;
+	}
+	
+	Dataset dataset;
+	QString error;
+	if(!readDatasetFile(positional[0], &dataset, &error) || !checkDatasetIndices(&dataset, &error))
+	{
+		std::fprintf(stderr, "%s\n", qPrintable(error));
+		return 1;
+	}
+	
+	QThreadPool::globalInstance()->setMaxThreadCount(threadCount);
+	QImage image = renderDatasetImage(&dataset, size, colormap, threadCount);
+	if(!image.save(positional[1]))
+	{
+		std::fprintf(stderr, "Could not write \"%s\"\n", qPrintable(positional[1]));
+		return 1;
+	}
+	return 0;
+}
+
+
 int main(int argc, char *argv[])
 {
+	for(int i = 1; i < argc; ++i)
+		if(std::strcmp(argv[i], "--render") == 0)
+			return runRenderCommand(argc, argv);
+	
 	QApplication a(argc, argv);
 	QApplication::setApplicationDisplayName(QApplication::tr("GIA gui"));
 	
@@ -19,4 +105,3 @@ int main(int argc, char *argv[])
 	
 	return QApplication::exec();
 }
-
@@ -1,8 +1,13 @@
 #include "preprocess/H3Map.hpp"
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 #include <vector>
 #include <cpptoml.h>
+#include "BufferedWriter.hpp"
+#include "H3bFormat.hpp"
 
 
 namespace poglar {
@@ -73,10 +78,124 @@ namespace poglar {
   } /* namespace <anon> */
 
 
+  namespace {
+    bool is_binary_filename(const std::string &filename)
+    {
+      const std::string suffix = ".h3b";
+      return filename.size() >= suffix.size() &&
+             filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+
+    /* Reads the value column of a .h3b file as Type. Integer datasets are
+     * accepted where doubles are expected, as cpptoml does for TOML files */
+    template <class Type>
+    struct binary_value_reader;
+
+    template <>
+    struct binary_value_reader<double> {
+      static bool get(std::istream &stream, const H3bHeader &header,
+                      std::vector<double> &values, std::string &error)
+      {
+        values.resize(header.count);
+        if (std::strcmp(header.type, "1f") == 0)
+          return h3bReadValues(stream, header, values.data(), &error);
+
+        if (std::strcmp(header.type, "1i") == 0) {
+          std::vector<int64_t> integers(header.count);
+          if (!h3bReadValues(stream, header, integers.data(), &error))
+            return false;
+          for (size_t i = 0; i < integers.size(); ++i)
+            values[i] = integers[i];
+          return true;
+        }
+
+        error = std::string("expected type 1f, found ") + header.type;
+        return false;
+      }
+
+      static double get_default(const H3bHeader &header)
+      {
+        if (std::strcmp(header.type, "1i") == 0) {
+          int64_t value;
+          std::memcpy(&value, header.defaultValue, sizeof(value));
+          return value;
+        }
+
+        double value;
+        std::memcpy(&value, header.defaultValue, sizeof(value));
+        return value;
+      }
+    };
+
+    template <>
+    struct binary_value_reader<vec3d> {
+      static bool get(std::istream &stream, const H3bHeader &header,
+                      std::vector<vec3d> &values, std::string &error)
+      {
+        static_assert(sizeof(vec3d) == 24, "vec3d must match the 3f value column");
+
+        if (std::strcmp(header.type, "3f") != 0) {
+          error = std::string("expected type 3f, found ") + header.type;
+          return false;
+        }
+
+        values.resize(header.count);
+        return h3bReadValues(stream, header, values.data(), &error);
+      }
+
+      static vec3d get_default(const H3bHeader &header)
+      {
+        vec3d value;
+        std::memcpy(&value, header.defaultValue, sizeof(value));
+        return value;
+      }
+    };
+
+
+    template <class Type>
+    void read_binary(std::istream &stream, const std::string &filename,
+                     int &resolution, Type &default_value,
+                     std::map<H3Index, Type> &values)
+    {
+      H3bHeader header;
+      std::string name, error;
+      std::vector<uint64_t> indices;
+      std::vector<Type> column;
+
+      bool ok = h3bReadHeader(stream, &header, &name, &error);
+      if (ok) {
+        indices.resize(header.count);
+        ok = h3bReadIndices(stream, header, indices.data(), &error) &&
+             binary_value_reader<Type>::get(stream, header, column, error);
+      }
+      if (!ok)
+        throw std::runtime_error(filename + ": " + error);
+
+      const double density = std::isnan(header.density) ? 1.0 : header.density;
+
+      resolution = header.resolution;
+      default_value = binary_value_reader<Type>::get_default(header);
+
+      /* indices are sorted, so every insertion goes at the end */
+      for (size_t i = 0; i < indices.size(); ++i)
+        values.emplace_hint(values.end(), indices[i], column[i] * density);
+    }
+  } /* namespace <anon> */
+
+
   template <class Type>
   void
   H3Map<Type>::read(const std::string &filename)
   {
+    {
+      std::ifstream ifile(filename, std::ios::binary);
+      if (ifile && h3bIsBinary(ifile)) {
+        read_binary(ifile, filename, resolution_, default_, values_);
+        return;
+      }
+    }
+
     std::shared_ptr<cpptoml::table> table = cpptoml::parse_file(filename);
     const std::string type = *(table->get_qualified_as<std::string>("h3.type"));
     // TODO check proper type
@@ -115,22 +234,21 @@ namespace poglar {
 
     template <>
     struct value_writer<double> {
-      static std::string get(const double &value) {
-        std::ostringstream os;
-        os << std::scientific << value;
-
-        return os.str();
+      static void put(BufferedWriter &writer, const double &value) {
+        writer.writeScientific(value);
       }
     };
 
     template <>
     struct value_writer<vec3d> {
-      static std::string get(const vec3d &value) {
-        std::ostringstream os;
-        os << std::scientific << "[" << value.x << ", " << value.y
-           << ", " << value.z << "]";
-
-        return os.str();
+      static void put(BufferedWriter &writer, const vec3d &value) {
+        writer.write("[");
+        writer.writeScientific(value.x);
+        writer.write(", ");
+        writer.writeScientific(value.y);
+        writer.write(", ");
+        writer.writeScientific(value.z);
+        writer.write("]");
       }
     };
   } /* namespace <anon> */
@@ -140,17 +258,45 @@ namespace poglar {
   void
   H3Map<Type>::write(const std::string &filename) const
   {
+    if (is_binary_filename(filename)) {
+      std::vector<uint64_t> indices;
+      std::vector<Type> column;
+      indices.reserve(values_.size());
+      column.reserve(values_.size());
+      for (const auto &kv: values_) {
+        indices.push_back(kv.first);
+        column.push_back(kv.second);
+      }
+
+      H3bHeader header = h3bMakeHeader(type_writer<Type>::get(), resolution(), values_.size());
+      std::memcpy(header.defaultValue, &default_, sizeof(Type));
+
+      std::ofstream ofile(filename, std::ios::binary);
+      h3bWrite(ofile, header, "", indices.data(), column.data());
+      return;
+    }
+
     std::ofstream ofile(filename);
-    ofile << "[h3]\r\n"
-             "resolution = " << resolution() << "\r\n"
-             "type = \"" << type_writer<Type>::get() << "\"\r\n"
-             "default = " << value_writer<Type>::get(default_) << "\r\n"
-             "\r\n"
-             "[h3.values]\r\n";
+    BufferedWriter writer(&ofile);
+
+    writer.write("[h3]\r\n"
+                 "resolution = ");
+    writer.writeInteger(resolution());
+    writer.write("\r\n"
+                 "type = \"");
+    writer.write(type_writer<Type>::get());
+    writer.write("\"\r\n"
+                 "default = ");
+    value_writer<Type>::put(writer, default_);
+    writer.write("\r\n"
+                 "\r\n"
+                 "[h3.values]\r\n");
 
     for (const auto &kv: values_) {
-      ofile << std::hex << kv.first << " = "
-            << value_writer<Type>::get(kv.second) << "\r\n";
+      writer.writeHex(kv.first);
+      writer.write(" = ");
+      value_writer<Type>::put(writer, kv.second);
+      writer.write("\r\n");
     }
   }
 
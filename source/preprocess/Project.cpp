@@ -2,6 +2,7 @@
 #include "preprocess/H3Map.hpp"
 #include <cpptoml.h>
 #include <QApplication> // tr()
+#include <QFile>
 #include <iostream>
 
 namespace poglar
@@ -25,6 +26,13 @@ namespace poglar
     {
       return -time * 1000 * 31536000 / 2e11;
     }
+
+    /* Suffix of the file giagui saved the dataset `name` to, ".h3" or ".h3b" */
+    std::string DatasetSuffix(const QDir &directory, const std::string &name)
+    {
+      QString binaryPath = directory.filePath(QString::fromStdString(name + ".h3b"));
+      return QFile::exists(binaryPath) ? ".h3b" : ".h3";
+    }
   } /* <anon> */
 	
 	
@@ -90,7 +98,8 @@ namespace poglar
 		if(auto name = root->get_qualified_as<std::string>("mesh.inner.input"))
 		{
 			// Copy content of input file into poglar directory 
-			QString sourcePath = path_.filePath(QString::fromStdString(*name + ".h3"));
+			std::string suffix = DatasetSuffix(path_, *name);
+			QString sourcePath = path_.filePath(QString::fromStdString(*name + suffix));
 			std::ifstream sourceFile(sourcePath.toStdString(), std::ios::binary);
 			if(!sourceFile.is_open())
 			{
@@ -99,7 +108,7 @@ namespace poglar
 				return false;
 			}
 			
-			QString targetPath = destination.filePath(QString::fromStdString("mesh/" + *name + ".h3"));
+			QString targetPath = destination.filePath(QString::fromStdString("mesh/" + *name + suffix));
 			std::ofstream targetFile(targetPath.toStdString(), std::ios::binary);
 			if(!targetFile.is_open())
 			{
@@ -117,7 +126,7 @@ namespace poglar
 				return false;
 			}
 			
-			stream << "input = \"mesh/" << *name << ".h3\"\n";
+			stream << "input = \"mesh/" << *name << suffix << "\"\n";
 		}
 		stream << "\n";
 		
@@ -127,7 +136,8 @@ namespace poglar
 		if(auto name = root->get_qualified_as<std::string>("mesh.outer.input"))
 		{
 			// Copy content of input file into poglar directory 
-			QString sourcePath = path_.filePath(QString::fromStdString(*name + ".h3"));
+			std::string suffix = DatasetSuffix(path_, *name);
+			QString sourcePath = path_.filePath(QString::fromStdString(*name + suffix));
 			std::ifstream sourceFile(sourcePath.toStdString(), std::ios::binary);
 			if(!sourceFile.is_open())
 			{
@@ -136,7 +146,7 @@ namespace poglar
 				return false;
 			}
 			
-			QString targetPath = destination.filePath(QString::fromStdString("mesh/" + *name + ".h3"));
+			QString targetPath = destination.filePath(QString::fromStdString("mesh/" + *name + suffix));
 			std::ofstream targetFile(targetPath.toStdString(), std::ios::binary);
 			if(!targetFile.is_open())
 			{
@@ -154,7 +164,7 @@ namespace poglar
 				return false;
 			}
 			
-			stream << "input = \"mesh/" << *name << ".h3\"\n";
+			stream << "input = \"mesh/" << *name << suffix << "\"\n";
 		}
 		stream << "\n";
 		
@@ -182,7 +192,7 @@ namespace poglar
 				H3Map<double> load;
 				for(const std::string &filename: entry.datasets)
 				{
-					QString sourcePath = path_.filePath(QString::fromStdString(filename + ".h3"));
+					QString sourcePath = path_.filePath(QString::fromStdString(filename + DatasetSuffix(path_, filename)));
 					H3Map<double> layer;
 					layer.read(sourcePath.toStdString());
 					
@@ -0,0 +1,324 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <unordered_map>
+#include <QImage>
+#include <QPainter>
+#include <QThreadPool>
+
+#include "CellGeometryCache.hpp"
+#include "ColorLookup.hpp"
+#include "Containers.hpp"
+#include "Dataset.hpp"
+#include "DatasetFile.hpp"
+#include "GeoValue.hpp"
+#include "MapRenderer.hpp"
+#include "TestUtils.hpp"
+
+
+// Benchmarks of the dataset code paths, run as `giagui_bench [name...]`, all of them without arguments
+// Each prints the best of a few runs, so compare numbers from the same machine only
+
+
+// Every cell at resolution 5, ~2M: the size at which datasets start to feel slow
+static const std::vector<H3Index>& benchmarkCells()
+{
+	static std::vector<H3Index> cells = cellsAt(5);
+	return cells;
+}
+
+
+// Value storage by container: building, point lookups in random order and iteration
+static void benchmarkContainers()
+{
+	const std::vector<H3Index>& cells = benchmarkCells();
+	std::vector<H3Index> shuffled = cells;
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(1));
+	
+	int64_t sum = 0;
+	auto report = [&](const char* name, double build, double lookup, double iterate)
+	{
+		std::printf("%-28s build %8.1f ms   lookup %8.1f ms   iterate %7.1f ms\n", name, build, lookup, iterate);
+	};
+	
+	{
+		std::unordered_map<H3Index, GeoValue> map;
+		double build   = measureMilliseconds(3, [&]{ map.clear(); for(H3Index index : cells) map.insert({index, GeoValue{int64_t(index)}}); });
+		double lookup  = measureMilliseconds(3, [&]{ for(H3Index index : shuffled) sum += map.find(index)->second.integer; });
+		double iterate = measureMilliseconds(3, [&]{ for(const auto& entry : map) sum += entry.second.integer; });
+		report("std::unordered_map", build, lookup, iterate);
+	}
+	{
+		FlatHashMap<H3Index, GeoValue> map;
+		double build   = measureMilliseconds(3, [&]{ map.clear(); for(H3Index index : cells) map.insert({index, GeoValue{int64_t(index)}}); });
+		double lookup  = measureMilliseconds(3, [&]{ for(H3Index index : shuffled) sum += map.get(index)->integer; });
+		double iterate = measureMilliseconds(3, [&]{ for(const auto& entry : map) sum += entry.second.integer; });
+		report("FlatHashMap", build, lookup, iterate);
+	}
+	{
+		SortedArrayMap<H3Index, GeoValue> map;
+		double build   = measureMilliseconds(3, [&]
+		{
+			std::vector<std::pair<H3Index, GeoValue>> entries;
+			for(H3Index index : shuffled)
+				entries.push_back({index, GeoValue{int64_t(index)}});
+			map.assign(std::move(entries));
+		});
+		double lookup  = measureMilliseconds(3, [&]{ for(H3Index index : shuffled) sum += map.get(index)->integer; });
+		double iterate = measureMilliseconds(3, [&]{ for(const GeoValue& value : map.values) sum += value.integer; });
+		report("SortedArrayMap", build, lookup, iterate);
+	}
+	{
+		DenseArrayMap<GeoValue> map;
+		double build   = measureMilliseconds(3, [&]{ map.resize(h3DenseSlotCount(5)); for(H3Index index : cells) map.set(h3ToDenseSlot(index, 5), GeoValue{int64_t(index)}); });
+		double lookup  = measureMilliseconds(3, [&]{ for(H3Index index : shuffled) sum += map.get(h3ToDenseSlot(index, 5))->integer; });
+		double iterate = measureMilliseconds(3, [&]{ map.forEach([&](size_t, const GeoValue& value){ sum += value.integer; }); });
+		report("DenseArrayMap", build, lookup, iterate);
+	}
+	
+	// NOTE: Printing the sum keeps the compiler from dropping the loops
+	std::printf("(checksum %lld)\n", (long long)sum);
+}
+
+
+// A real dataset with a value on every benchmark cell
+static Dataset makeBenchmarkDataset(bool isInteger)
+{
+	std::mt19937_64 random(2);
+	return makeDataset(benchmarkCells(), 5, isInteger, [&](H3Index)
+	{
+		GeoValue value;
+		if(isInteger)
+			value.integer = int64_t(random() % 100);
+		else
+			value.real = double(random() % 100000) / 100.0;
+		return value;
+	});
+}
+
+
+// Mean of the children through hash maps keyed by parent, then sorted: how decreaseResolution() worked before it
+// streamed over sorted values. Only there to compare against
+static SortedArrayMap<H3Index, GeoValue> hashMapParentGeoValues(const Dataset& dataset, int newResolution)
+{
+	FlatHashMap<H3Index, int>    childrenCount;
+	FlatHashMap<H3Index, double> sums;
+	dataset.forEachGeoValue([&](H3Index childIndex, GeoValue childGeoValue)
+	{
+		H3Index parentIndex = h3ToParent(childIndex, newResolution);
+		sums[parentIndex]          += childGeoValue.real;
+		childrenCount[parentIndex] += 1;
+	});
+	
+	std::vector<std::pair<H3Index, GeoValue>> entries;
+	entries.reserve(sums.size());
+	for(const auto& [parentIndex, sum] : sums)
+	{
+		GeoValue value;
+		value.real = sum / childrenCount[parentIndex];
+		entries.push_back({parentIndex, value});
+	}
+	SortedArrayMap<H3Index, GeoValue> result;
+	result.assign(std::move(entries));
+	return result;
+}
+
+
+// Decreasing the resolution by one and by three levels, with each aggregation. Then from resolution 6, ~14M cells, to
+// 3 against the hash map pass it replaced
+static void benchmarkDecreaseResolution()
+{
+	for(bool isInteger : {false, true})
+	{
+		Dataset dataset = makeBenchmarkDataset(isInteger);
+		for(Dataset::Aggregation aggregation : {Dataset::Aggregation::Mean, Dataset::Aggregation::MeanWithDefault, Dataset::Aggregation::AreaWeightedMean,
+		                                        Dataset::Aggregation::Min,  Dataset::Aggregation::Max,             Dataset::Aggregation::Mode})
+		{
+			dataset.aggregation = aggregation;
+			for(int newResolution : {4, 2})
+			{
+				size_t count  = 0;
+				double elapsed = measureMilliseconds(3, [&]{ count = dataset.parentGeoValues(newResolution).size(); });
+				std::printf("%-8s %-18s 5 -> %d   %8.1f ms   (%zu parents)\n", isInteger ? "integer" : "real", Dataset::aggregationName(aggregation), newResolution, elapsed, count);
+			}
+		}
+	}
+	
+	std::mt19937_64 random(4);
+	Dataset dataset = makeDataset(cellsAt(6), 6, false, [&](H3Index)
+	{
+		GeoValue value;
+		value.real = double(random() % 100000) / 100.0;
+		return value;
+	});
+	size_t streamedCount = 0;
+	size_t hashedCount   = 0;
+	double streamed = measureMilliseconds(3, [&]{ streamedCount = dataset.parentGeoValues(3).size(); });
+	double hashed   = measureMilliseconds(3, [&]{ hashedCount = hashMapParentGeoValues(dataset, 3).size(); });
+	std::printf("%-8s %-18s 6 -> 3   %8.1f ms   (%zu parents)\n", "real", "mean",          streamed, streamedCount);
+	std::printf("%-8s %-18s 6 -> 3   %8.1f ms   (%zu parents)\n", "real", "mean, hash map", hashed,   hashedCount);
+}
+
+
+// Loading text files through the single pass parser and through cpptoml for files it does not support, and .h3b files
+static void benchmarkParse()
+{
+	for(bool isInteger : {false, true})
+	{
+		Dataset dataset = makeBenchmarkDataset(isInteger);
+		QString path    = temporaryFilePath("giagui_bench.h3");
+		QString error;
+		if(!writeDatasetFile(path, &dataset, &error))
+		{
+			std::printf("%s\n", error.toStdString().c_str());
+			return;
+		}
+		
+		std::string text;
+		{
+			std::ifstream stream(path.toStdString());
+			text.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+		}
+		
+		// NOTE: Keys outside of any table are valid TOML, but the fast parser leaves them to cpptoml
+		QString fallbackPath = temporaryFilePath("giagui_bench_fallback.h3");
+		std::ofstream(fallbackPath.toStdString()) << "version = 1\n" << text;
+		
+		QString binaryPath = temporaryFilePath("giagui_bench.h3b");
+		if(!writeDatasetFile(binaryPath, &dataset, &error))
+		{
+			std::printf("%s\n", error.toStdString().c_str());
+			return;
+		}
+		
+		const std::pair<const char*, QString> files[] = {{"fast", path}, {"cpptoml", fallbackPath}, {"h3b", binaryPath}};
+		for(const auto& [parser, file] : files)
+		{
+			bool   loaded  = false;
+			double elapsed = measureMilliseconds(3, [&]
+			{
+				Dataset loadedDataset;
+				loaded = readDatasetFile(file, &loadedDataset, &error) && loadedDataset.geoValueCount() == dataset.geoValueCount();
+			});
+			double size    = double(std::filesystem::file_size(file.toStdString()));
+			std::printf("%-8s %-8s %6.1f MB   %8.1f ms%s\n", isInteger ? "integer" : "real", parser, size / 1e6, elapsed, loaded ? "" : "   (failed)");
+		}
+		for(const auto& [parser, file] : files)
+			std::filesystem::remove(file.toStdString());
+	}
+}
+
+
+// Saving text and .h3b files, the size of the text files shows how much of the time is formatting
+static void benchmarkWrite()
+{
+	for(bool isInteger : {false, true})
+	{
+		Dataset dataset = makeBenchmarkDataset(isInteger);
+		for(const char* name : {"giagui_bench.h3", "giagui_bench.h3b"})
+		{
+			QString path    = temporaryFilePath(name);
+			QString error;
+			bool    written = false;
+			double  elapsed = measureMilliseconds(3, [&]{ written = writeDatasetFile(path, &dataset, &error); });
+			if(!written)
+			{
+				std::printf("%s\n", error.toStdString().c_str());
+				return;
+			}
+			double size = double(std::filesystem::file_size(path.toStdString()));
+			std::printf("%-8s %-18s %6.1f MB   %8.1f ms\n", isInteger ? "integer" : "real", name, size / 1e6, elapsed);
+			std::filesystem::remove(path.toStdString());
+		}
+	}
+}
+
+
+// One frame of a resolution 4 dataset with a value on every cell, drawn into a full HD image: cell by cell with a
+// brush change each, as before cells were bucketed by color, then by MapRenderer without and with the geometry cache
+static void benchmarkDraw()
+{
+	std::mt19937_64 random(3);
+	Dataset dataset = makeDataset(cellsAt(4), 4, false, [&](H3Index)
+	{
+		GeoValue value;
+		value.real = double(random() % 100000) / 100.0;
+		return value;
+	});
+	
+	ColorLookup colorLookup;
+	colorLookup.setRange(0.0, 1000.0);
+	
+	QSize  size(1920, 1080);
+	QSizeF surfaceSize(size);
+	QRectF area(QPointF(0, 0), surfaceSize);
+	QImage image(size, QImage::Format_ARGB32_Premultiplied);
+	auto report = [&](const char* name, const std::function<void(QPainter* painter)>& draw)
+	{
+		double elapsed = measureMilliseconds(3, [&]
+		{
+			image.fill(Qt::white);
+			QPainter painter(&image);
+			painter.setRenderHint(QPainter::Antialiasing);
+			draw(&painter);
+		});
+		std::printf("%-24s %8.1f ms   (%zu cells)\n", name, elapsed, dataset.geoValueCount());
+	};
+	
+	report("brush per cell", [&](QPainter* painter)
+	{
+		QBrush       brush(Qt::BrushStyle::SolidPattern);
+		CellGeometry geometry;
+		painter->setPen(Qt::PenStyle::NoPen);
+		dataset.forEachGeoValue([&](H3Index index, GeoValue geoValue)
+		{
+			brush.setColor(colorLookup.brushes[colorLookup.bin(geoValue.real)].color());
+			painter->setBrush(brush);
+			computeCellGeometry(index, surfaceSize, &geometry);
+			drawCellGeometry(painter, geometry);
+		});
+	});
+	
+	MapRenderer renderer;
+	renderer.colorLookup = &colorLookup;
+	renderer.reset(surfaceSize);
+	report("buckets", [&](QPainter* painter){ renderer.drawCells(painter, &dataset, nullptr, area); });
+	
+	// NOTE: The first of the runs fills the cache, the best one is drawn from it
+	CellGeometryCache geometryCache;
+	geometryCache.reset(dataset.resolution, surfaceSize);
+	renderer.geometryCache = &geometryCache;
+	report("buckets, cached", [&](QPainter* painter){ renderer.drawCells(painter, &dataset, nullptr, area); });
+	report("buckets, cached, strips", [&](QPainter* painter)
+	{
+		renderer.drawCellsInStrips(painter, &dataset, nullptr, area, QThreadPool::globalInstance()->maxThreadCount());
+	});
+}
+
+
+int main(int argc, char** argv)
+{
+	const std::pair<const char*, std::function<void()>> benchmarks[] =
+	{
+		{"containers",          benchmarkContainers},
+		{"decrease_resolution", benchmarkDecreaseResolution},
+		{"parse",               benchmarkParse},
+		{"write",               benchmarkWrite},
+		{"draw",                benchmarkDraw},
+	};
+	
+	for(const auto& [name, run] : benchmarks)
+	{
+		bool selected = argc == 1;
+		for(int i = 1; i < argc; ++i)
+			selected = selected || std::strcmp(argv[i], name) == 0;
+		if(!selected)
+			continue;
+		
+		std::printf("== %s ==\n", name);
+		run();
+	}
+	return 0;
+}
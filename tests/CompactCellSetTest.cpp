@@ -0,0 +1,139 @@
+#include <random>
+#include <set>
+
+#include "CompactCellSet.hpp"
+#include "TestUtils.hpp"
+
+
+// Cells at `resolution` under `roots`, or their parents if `resolution` is coarser than the roots
+static std::vector<H3Index> cellsUnder(const std::vector<H3Index>& roots, int resolution)
+{
+	std::set<H3Index> result;
+	for(H3Index root : roots)
+	{
+		if(resolution <= h3GetResolution(root))
+		{
+			result.insert(h3ToParent(root, resolution));
+			continue;
+		}
+		
+		// NOTE: Children on the deleted axis of a pentagon come out as H3_INVALID_INDEX
+		std::vector<H3Index> children(size_t(maxH3ToChildrenSize(root, resolution)));
+		h3ToChildren(root, resolution, children.data());
+		for(H3Index child : children)
+		{
+			if(child != H3_INVALID_INDEX)
+				result.insert(child);
+		}
+	}
+	return std::vector<H3Index>(result.begin(), result.end());
+}
+
+
+// Random inserts, erases and resolution changes, compared against a std::set of every cell after each round
+static void testAgainstReference()
+{
+	// A pentagon and a hexagon, few enough cells under them that whole groups of siblings get selected and compacted
+	H3Index pentagon = H3_INVALID_INDEX;
+	for(H3Index index : cellsAt(1))
+	{
+		if(pentagon == H3_INVALID_INDEX && h3IsPentagon(index))
+			pentagon = index;
+	}
+	std::vector<H3Index> roots = {pentagon, cellsAt(1)[100]};
+	CHECK(!h3IsPentagon(roots[1]));
+	
+	std::mt19937_64 random(1);
+	for(int round = 0; round < 100; ++round)
+	{
+		CompactCellSet    set;
+		std::set<H3Index> reference;
+		set.reset(1 + int(random() % 4));
+		std::vector<H3Index> pool = cellsUnder(roots, set.resolution);
+		
+		for(int i = 0; i < 2000; ++i)
+		{
+			H3Index  index     = pool[random() % pool.size()];
+			uint64_t operation = random() % 20;
+			if(operation < 12)
+			{
+				set.insert(index);
+				reference.insert(index);
+			}
+			else
+			if(operation < 19)
+			{
+				set.erase(index);
+				reference.erase(index);
+			}
+			else
+			{
+				int newResolution = int(random() % 5);
+				set.setResolution(newResolution);
+				std::vector<H3Index> cells = cellsUnder(std::vector<H3Index>(reference.begin(), reference.end()), newResolution);
+				reference = std::set<H3Index>(cells.begin(), cells.end());
+				pool      = cellsUnder(roots, newResolution);
+			}
+		}
+		
+		CHECK(set.resolution == h3GetResolution(pool[0]));
+		CHECK(set.size() == reference.size());
+		CHECK(set.empty() == reference.empty());
+		std::set<H3Index> visited;
+		size_t            visitCount = 0;
+		for(H3Index index : set)
+		{
+			visited.insert(index);
+			visitCount += 1;
+		}
+		CHECK(visitCount == reference.size());
+		CHECK(visited == reference);
+		
+		for(H3Index index : pool)
+			CHECK(set.contains(index) == (reference.count(index) == 1));
+		
+		// Compacted: no stored cell has a stored parent, and none is finer than the set
+		for(H3Index cell : set.cells)
+		{
+			CHECK(h3GetResolution(cell) <= set.resolution);
+			for(int r = h3GetResolution(cell) - 1; r >= 0; --r)
+				CHECK(set.cells.count(h3ToParent(cell, r)) == 0);
+		}
+	}
+}
+
+
+// Selecting every cell of a resolution stores only the base cells
+static void testFullGlobe()
+{
+	std::vector<H3Index> cells = cellsAt(2);
+	CompactCellSet set;
+	set.reset(2);
+	set.insert(cells.begin(), cells.end());
+	CHECK(set.size() == cells.size());
+	CHECK(set.cells.size() == 122);
+	
+	std::vector<H3Index> finerCells = cellsAt(4);
+	set.setResolution(4);
+	CHECK(set.size() == finerCells.size());
+	CHECK(set.cells.size() == 122);
+	
+	set.erase(finerCells[0]);
+	CHECK(set.size() == finerCells.size() - 1);
+	CHECK(!set.contains(finerCells[0]));
+	CHECK(set.contains(finerCells[1]));
+	CHECK(!set.contains(h3ToParent(finerCells[1], 0))); // Its base cell is no longer whole
+	
+	set.clear();
+	CHECK(set.empty());
+	CHECK(set.size() == 0);
+	CHECK(set.begin() == set.end());
+}
+
+
+int main()
+{
+	testAgainstReference();
+	testFullGlobe();
+	return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#include <random>
+#include <unordered_map>
+
+#include "Containers.hpp"
+#include "TestUtils.hpp"
+
+
+// Random inserts, erases and lookups, compared against std::unordered_map after each one
+static void testFlatHashMap()
+{
+	FlatHashMap<uint64_t, int>        map;
+	std::unordered_map<uint64_t, int> reference;
+	std::mt19937_64                   random(1);
+	
+	for(int i = 0; i < 200000; ++i)
+	{
+		// NOTE: Few distinct keys, so that erases hit and the probe chains wrap around the table
+		uint64_t key = random() % 5000 + 1;
+		switch(random() % 4)
+		{
+			case 0:
+			{
+				auto [mapIter, mapCreated]             = map.insert({key, i});
+				auto [referenceIter, referenceCreated] = reference.insert({key, i});
+				CHECK(mapCreated == referenceCreated);
+				CHECK(mapIter->second == referenceIter->second);
+				break;
+			}
+			case 1:
+				CHECK(map.erase(key) == reference.erase(key));
+				break;
+			case 2:
+				map[key]       = i;
+				reference[key] = i;
+				break;
+			default:
+			{
+				const int* value = map.get(key);
+				auto       it    = reference.find(key);
+				CHECK((value != nullptr) == (it != reference.end()));
+				CHECK(!value || *value == it->second);
+				CHECK(map.count(key) == reference.count(key));
+				break;
+			}
+		}
+		CHECK(map.size() == reference.size());
+	}
+	
+	size_t visited = 0;
+	for(const auto& [key, value] : map)
+	{
+		CHECK(reference.at(key) == value);
+		visited += 1;
+	}
+	CHECK(visited == reference.size());
+	
+	map.reserve(100000);
+	CHECK(map.size() == reference.size());
+	std::vector<std::pair<uint64_t, int>> entries = map.takeEntries();
+	CHECK(entries.size() == reference.size());
+	CHECK(map.empty());
+	for(const auto& [key, value] : entries)
+		CHECK(reference.at(key) == value);
+}
+
+
+static void testSortedArrayMap()
+{
+	std::mt19937_64 random(2);
+	for(size_t count : {0, 1, 17, 1000, 100000})
+	{
+		std::vector<std::pair<uint64_t, int>> entries;
+		for(size_t i = 0; i < count; ++i)
+			entries.push_back({random() | 1, int(i)}); // Odd keys, so that even ones are known to be missing
+		std::unordered_map<uint64_t, int> reference(entries.begin(), entries.end());
+		
+		SortedArrayMap<uint64_t, int> map;
+		map.assign(std::move(entries));
+		CHECK(map.size() == reference.size());
+		CHECK(std::is_sorted(map.keys.begin(), map.keys.end()));
+		
+		for(const auto& [key, value] : reference)
+		{
+			const int* found = map.get(key);
+			CHECK(found && *found == value);
+			CHECK(map.view().get(key) == found);
+		}
+		for(size_t i = 0; i < 1000; ++i)
+		{
+			uint64_t missing = random() & ~uint64_t(1);
+			CHECK(map.indexOf(missing) == map.NOT_FOUND);
+			CHECK(map.view().indexOf(missing) == map.NOT_FOUND);
+		}
+	}
+	
+	// Keys bunched at both ends throw the interpolation steps far off, the binary search must still find them
+	std::vector<uint64_t> skewed;
+	for(uint64_t i = 1; i <= 1000; ++i)
+		skewed.push_back(i);
+	for(uint64_t i = 1; i <= 1000; ++i)
+		skewed.push_back(UINT64_MAX - 1000 + i);
+	for(size_t i = 0; i < skewed.size(); ++i)
+		CHECK(sortedArrayIndexOf(skewed.data(), skewed.size(), skewed[i]) == i);
+	CHECK(sortedArrayIndexOf(skewed.data(), skewed.size(), uint64_t(1) << 63) == SIZE_MAX);
+}
+
+
+static void testDenseArrayMap()
+{
+	DenseArrayMap<int>              map;
+	std::unordered_map<size_t, int> reference;
+	std::mt19937_64                 random(3);
+	
+	map.resize(1000);
+	CHECK(map.slotCount() == 1000);
+	CHECK(map.empty());
+	for(int i = 0; i < 100000; ++i)
+	{
+		size_t slot = random() % map.slotCount();
+		if(random() % 2)
+		{
+			bool created = reference.count(slot) == 0;
+			CHECK(map.set(slot, i) == created);
+			reference[slot] = i;
+		}
+		else
+		{
+			CHECK(map.erase(slot) == reference.erase(slot));
+		}
+		CHECK(map.size() == reference.size());
+	}
+	
+	size_t visited  = 0;
+	size_t previous = 0;
+	map.forEach([&](size_t slot, int value)
+	{
+		CHECK(visited == 0 || slot > previous);
+		CHECK(reference.at(slot) == value);
+		previous = slot;
+		visited += 1;
+	});
+	CHECK(visited == reference.size());
+}
+
+
+int main()
+{
+	testFlatHashMap();
+	testSortedArrayMap();
+	testDenseArrayMap();
+	return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <QFileInfo>
+
+#include "Dataset.hpp"
+#include "DatasetFile.hpp"
+#include "H3bFormat.hpp"
+#include "TestUtils.hpp"
+
+
+// A dataset with a value on every 7th cell at resolution 3
+// NOTE: Real values are multiples of 1/4, which text files store exactly
+static Dataset makeTestDataset(bool isInteger)
+{
+	std::mt19937_64 random(1);
+	Dataset dataset = makeDataset(cellsAt(3, 7), 3, isInteger, [&](H3Index)
+	{
+		GeoValue value;
+		if(isInteger)
+			value.integer = int64_t(random() % 2000) - 1000;
+		else
+			value.real = double(int64_t(random() % 2000) - 1000) / 4.0;
+		return value;
+	});
+	dataset.aggregation = Dataset::Aggregation::Max;
+	if(isInteger)
+		dataset.defaultValue.integer = 7;
+	else
+		dataset.defaultValue.real = 0.5;
+	return dataset;
+}
+
+
+static void checkSameDataset(Dataset* loaded, Dataset* expected)
+{
+	CHECK(loaded->id == expected->id);
+	CHECK(loaded->resolution == expected->resolution);
+	CHECK(loaded->isInteger == expected->isInteger);
+	CHECK(loaded->aggregation == expected->aggregation);
+	CHECK(loaded->geoValuesAreEqual(loaded->defaultValue, expected->defaultValue));
+	CHECK(loaded->geoValueCount() == expected->geoValueCount());
+	
+	size_t mismatches = 0;
+	loaded->forEachGeoValue([&](H3Index index, GeoValue geoValue)
+	{
+		GeoValue expectedValue;
+		if(!expected->findGeoValue(index, &expectedValue) || !expected->geoValuesAreEqual(geoValue, expectedValue))
+			mismatches += 1;
+	});
+	CHECK(mismatches == 0);
+}
+
+
+// Saving and loading again gives back the same dataset, in both formats
+static void testRoundTrip()
+{
+	for(bool isInteger : {false, true})
+	{
+		Dataset dataset = makeTestDataset(isInteger);
+		for(const char* name : {"giagui_test.h3", "giagui_test.h3b"})
+		{
+			QString path = temporaryFilePath(name);
+			QString error;
+			CHECK(writeDatasetFile(path, &dataset, &error));
+			
+			Dataset loaded;
+			CHECK(readDatasetFile(path, &loaded, &error));
+			checkSameDataset(&loaded, &dataset);
+			
+			// Saving over the file the dataset is loaded from, possibly memory-mapped, must not lose its values
+			CHECK(writeDatasetFile(path, &loaded, &error));
+			Dataset reloaded;
+			CHECK(readDatasetFile(path, &reloaded, &error));
+			checkSameDataset(&reloaded, &dataset);
+			
+			std::filesystem::remove(path.toStdString());
+		}
+	}
+}
+
+
+// A project with a text and a binary layer saves each one in its own format, and lists both when opened again
+static void testProjectRoundTrip()
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "giagui_test_project";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directory(directory);
+	QString directoryPath = QString::fromStdString(directory.string());
+	
+	Dataset textDataset   = makeTestDataset(false);
+	Dataset binaryDataset = makeTestDataset(true);
+	textDataset.id   = "text";
+	binaryDataset.id = "binary";
+	
+	QString error;
+	QString textPath   = projectDatasetPath(directoryPath, &textDataset,   "");
+	QString binaryPath = projectDatasetPath(directoryPath, &binaryDataset, "/elsewhere/loaded.h3b");
+	CHECK(QFileInfo(textPath).suffix() == "h3");
+	CHECK(QFileInfo(binaryPath).suffix() == "h3b");
+	CHECK(writeDatasetFile(textPath,   &textDataset,   &error));
+	CHECK(writeDatasetFile(binaryPath, &binaryDataset, &error));
+	
+	QStringList files = projectDatasetFiles(directoryPath);
+	CHECK(files.size() == 2);
+	for(const QString& file : files)
+	{
+		Dataset loaded;
+		CHECK(readDatasetFile(file, &loaded, &error));
+		checkSameDataset(&loaded, loaded.id == "binary" ? &binaryDataset : &textDataset);
+		
+		// Saving the project again keeps the format the layer was loaded from
+		CHECK(projectDatasetPath(directoryPath, &loaded, file) == file);
+	}
+	std::filesystem::remove_all(directory);
+}
+
+
+// .h3b files with delta encoded indices, which giagui does not write itself
+static void testDeltaIndices()
+{
+	std::vector<H3Index> indices = cellsAt(4, 3);
+	std::vector<double>  values;
+	for(size_t i = 0; i < indices.size(); ++i)
+		values.push_back(double(i) * 0.5);
+	
+	H3bHeader header = h3bMakeHeader("1f", 4, indices.size());
+	header.flags     = H3B_FLAG_DELTA_INDICES;
+	header.density   = DOUBLE_NAN;
+	
+	std::stringstream stream;
+	h3bWrite(stream, header, "delta", indices.data(), values.data());
+	
+	H3bHeader   readHeader;
+	std::string name;
+	std::string error;
+	CHECK(h3bReadHeader(stream, &readHeader, &name, &error));
+	CHECK(name == "delta");
+	CHECK(readHeader.indicesSize < indices.size() * sizeof(uint64_t));
+	std::vector<H3Index> readIndices(readHeader.count);
+	CHECK(h3bReadIndices(stream, readHeader, readIndices.data(), &error));
+	CHECK(readIndices == indices);
+	
+	QString path = temporaryFilePath("giagui_test_delta.h3b");
+	std::ofstream(path.toStdString(), std::ios::binary) << stream.str();
+	Dataset loaded;
+	QString loadError;
+	CHECK(readDatasetFile(path, &loaded, &loadError));
+	CHECK(loaded.geoValueCount() == indices.size());
+	GeoValue value;
+	CHECK(loaded.findGeoValue(indices.back(), &value) && value.real == values.back());
+	std::filesystem::remove(path.toStdString());
+}
+
+
+// Files with cells that are not valid at the resolution of the dataset fail to load instead of loading wrong values
+static void testRejectedCells()
+{
+	H3Index first  = h3FromDenseSlot(5, 2);
+	H3Index second = h3FromDenseSlot(9, 2);
+	
+	auto loadText = [](const std::vector<H3Index>& indices)
+	{
+		QString path = temporaryFilePath("giagui_test_cells.h3");
+		{
+			std::ofstream stream(path.toStdString());
+			stream << "[giagui]\nname = 'cells'\n\n[h3]\nresolution = 2\ntype = '1i'\ndefault = 0\n\n[h3.values]\n";
+			for(H3Index index : indices)
+				stream << std::hex << index << std::dec << " = 1\n";
+		}
+		Dataset dataset;
+		QString error;
+		bool    loaded = readDatasetFile(path, &dataset, &error);
+		CHECK(loaded || !error.isEmpty());
+		std::filesystem::remove(path.toStdString());
+		return loaded;
+	};
+	CHECK(loadText({first, second}));
+	CHECK(loadText({second, first}));                  // Text files need not be sorted
+	CHECK(!loadText({first, h3ToParent(second, 1)}));  // Mixed resolutions
+	CHECK(!loadText({first, second | (7ull << 39)}));  // Digit 7 at resolution 2, not a cell
+	CHECK(!loadText({first, second, first}));          // Duplicates
+	
+	auto loadBinary = [](const std::vector<H3Index>& indices)
+	{
+		std::vector<int64_t> values(indices.size(), 1);
+		QString path = temporaryFilePath("giagui_test_cells.h3b");
+		{
+			std::ofstream stream(path.toStdString(), std::ios::binary);
+			h3bWrite(stream, h3bMakeHeader("1i", 2, indices.size()), "cells", indices.data(), values.data());
+		}
+		Dataset dataset;
+		QString error;
+		bool    loaded = readDatasetFile(path, &dataset, &error);
+		CHECK(loaded || !error.isEmpty());
+		std::filesystem::remove(path.toStdString());
+		return loaded;
+	};
+	CHECK(loadBinary({first, second}));
+	CHECK(!loadBinary({second, first}));               // .h3b indices must be ascending
+	CHECK(!loadBinary({first, first}));
+	CHECK(!loadBinary({h3ToParent(first, 1), second}));
+}
+
+
+// Mapped files only get a sample of their cells checked when opened, the rest and the statistics wait until needed
+static void testMappedChecks()
+{
+	std::vector<H3Index> indices = cellsAt(4);
+	std::vector<double>  values(indices.size(), 2.0);
+	size_t bad = indices.size() / 2 + 7;
+	indices[bad] |= 7ull << 33; // Digit 7 at resolution 4
+	
+	QString path = temporaryFilePath("giagui_test_mapped.h3b");
+	{
+		std::ofstream stream(path.toStdString(), std::ios::binary);
+		h3bWrite(stream, h3bMakeHeader("1f", 4, indices.size()), "mapped", indices.data(), values.data());
+	}
+	
+	Dataset dataset;
+	QString error;
+	CHECK(readDatasetFile(path, &dataset, &error));
+	CHECK(dataset.storage == Dataset::Storage::Mapped);
+	CHECK(dataset.indicesUnchecked);
+	CHECK(dataset.stats.stale);
+	CHECK(dataset.statistics().count == indices.size() && dataset.statistics().mean() == 2.0);
+	CHECK(!checkDatasetIndices(&dataset, &error));
+	CHECK(error.contains(QString::number(indices[bad], 16)));
+	std::filesystem::remove(path.toStdString());
+	
+	// Valid cells pass once, and edits go on from the computed statistics
+	indices[bad] &= ~(7ull << 33);
+	{
+		std::ofstream stream(path.toStdString(), std::ios::binary);
+		h3bWrite(stream, h3bMakeHeader("1f", 4, indices.size()), "mapped", indices.data(), values.data());
+	}
+	Dataset valid;
+	CHECK(readDatasetFile(path, &valid, &error));
+	CHECK(checkDatasetIndices(&valid, &error));
+	CHECK(!valid.indicesUnchecked);
+	CHECK(valid.removeGeoValues(indices.data(), 10) == 10);
+	CHECK(valid.statistics().count == indices.size() - 10);
+	std::filesystem::remove(path.toStdString());
+}
+
+
+int main()
+{
+	testRoundTrip();
+	testProjectRoundTrip();
+	testDeltaIndices();
+	testRejectedCells();
+	testMappedChecks();
+	return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include <cmath>
+
+#include "Dataset.hpp"
+#include "TestUtils.hpp"
+
+
+// A real dataset with `value` on each of `cells`, aggregated by area weighted mean
+static Dataset makeConstantDataset(const std::vector<H3Index>& cells, int resolution, double value)
+{
+	Dataset dataset = makeDataset(cells, resolution, false, [&](H3Index)
+	{
+		GeoValue geoValue;
+		geoValue.real = value;
+		return geoValue;
+	});
+	dataset.aggregation = Dataset::Aggregation::AreaWeightedMean;
+	return dataset;
+}
+
+
+// Children do not tile their parent exactly, yet a constant field keeps its value when coarsened
+static void testAreaWeightedMeanConstant()
+{
+	std::vector<H3Index> cells   = cellsAt(4);
+	Dataset              dataset = makeConstantDataset(cells, 4, 2.5);
+	dataset.decreaseResolution(2);
+	CHECK(dataset.geoValueCount() == cellsAt(2).size());
+	
+	size_t mismatches = 0;
+	dataset.forEachGeoValue([&](H3Index, GeoValue geoValue)
+	{
+		if(std::abs(geoValue.real - 2.5) > 1e-9)
+			mismatches += 1;
+	});
+	CHECK(mismatches == 0);
+}
+
+
+// Children without a value count as 0, a parent with one of its seven children gets a seventh of the value
+static void testAreaWeightedMeanMissing()
+{
+	std::vector<H3Index> cells  = cellsAt(4);
+	H3Index              parent = h3ToParent(cells[0], 3);
+	std::vector<H3Index> kept;
+	for(H3Index index : cells)
+	{
+		if(index == cells[0] || h3ToParent(index, 3) != parent)
+			kept.push_back(index);
+	}
+	
+	Dataset dataset = makeConstantDataset(kept, 4, 2.5);
+	dataset.decreaseResolution(3);
+	GeoValue value;
+	CHECK(dataset.findGeoValue(parent, &value) && std::abs(value.real - 2.5 / double(h3ChildrenCount(parent, 4))) < 1e-9);
+	CHECK(dataset.findGeoValue(h3ToParent(cells.back(), 3), &value) && std::abs(value.real - 2.5) < 1e-9);
+}
+
+
+int main()
+{
+	testAreaWeightedMeanConstant();
+	testAreaWeightedMeanMissing();
+	return checkFailures() == 0 ? 0 : 1;
+}
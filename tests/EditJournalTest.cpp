@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <random>
+
+#include "Dataset.hpp"
+#include "EditJournal.hpp"
+#include "TestUtils.hpp"
+
+
+#define TEST_RESOLUTION 4 // ~300k cells, enough for entries to be split in chunks and compressed
+
+
+// Every value of a dataset, in index order
+struct Snapshot
+{
+	int                                      resolution;
+	std::vector<std::pair<H3Index, int64_t>> values;
+	
+	bool operator==(const Snapshot& that) const { return resolution == that.resolution && values == that.values; }
+};
+
+
+static Snapshot takeSnapshot(const Dataset& dataset)
+{
+	Snapshot result;
+	result.resolution = dataset.resolution;
+	dataset.forEachGeoValue([&](H3Index index, GeoValue geoValue)
+	{
+		result.values.push_back({index, geoValue.integer});
+	});
+	std::sort(result.values.begin(), result.values.end());
+	return result;
+}
+
+
+// An integer dataset with values on a random fraction of the cells, few distinct ones so that edits often change nothing
+static Dataset makeTestDataset(std::mt19937_64& random, const std::vector<H3Index>& cells)
+{
+	std::vector<H3Index> filledCells;
+	uint64_t             fillPercent = random() % 100;
+	for(H3Index index : cells)
+	{
+		if(random() % 100 < fillPercent)
+			filledCells.push_back(index);
+	}
+	
+	Dataset dataset = makeDataset(filledCells, TEST_RESOLUTION, true, [&](H3Index)
+	{
+		GeoValue value;
+		value.integer = int64_t(random() % 5);
+		return value;
+	});
+	dataset.aggregation = Dataset::Aggregation::Max;
+	return dataset;
+}
+
+
+// Records then applies a random edit: an update or a removal of a few or of many cells, or a resolution change
+static void randomEdit(std::mt19937_64& random, EditJournal* journal, Dataset* dataset, const std::vector<H3Index>& cells, const std::vector<H3Index>& coarserCells)
+{
+	if(random() % 5 == 0)
+	{
+		journal->recordResolutionChange(dataset);
+		if(dataset->resolution == TEST_RESOLUTION)
+			dataset->decreaseResolution(TEST_RESOLUTION - 1);
+		else
+			dataset->increaseResolution(TEST_RESOLUTION);
+		return;
+	}
+	
+	std::vector<H3Index> indices = dataset->resolution == TEST_RESOLUTION ? cells : coarserCells;
+	std::shuffle(indices.begin(), indices.end(), random);
+	indices.resize(std::min(indices.size(), size_t(random() % 2 ? random() % 2000 : random() % 200000)));
+	
+	if(random() % 3 != 0)
+	{
+		GeoValue value;
+		value.integer = int64_t(random() % 5);
+		journal->recordUpdate(dataset, indices.data(), indices.size(), value);
+		dataset->updateGeoValues(indices.data(), indices.size(), value);
+	}
+	else
+	{
+		journal->recordRemoval(dataset, indices.data(), indices.size());
+		dataset->removeGeoValues(indices.data(), indices.size());
+	}
+}
+
+
+// Undoing every edit goes back through each earlier state of the dataset, and redoing them all comes back to the last
+static void testUndoRedo()
+{
+	std::vector<H3Index> cells        = cellsAt(TEST_RESOLUTION);
+	std::vector<H3Index> coarserCells = cellsAt(TEST_RESOLUTION - 1);
+	std::mt19937_64      random(1);
+	for(int round = 0; round < 6; ++round)
+	{
+		Dataset dataset = makeTestDataset(random, cells);
+		if(round % 3 == 1)
+			dataset.thaw();
+		if(round % 3 == 2)
+			dataset.makeDense();
+		
+		// NOTE: Edits that change nothing are not recorded, so they get no snapshot either
+		EditJournal           journal;
+		std::vector<Snapshot> history = {takeSnapshot(dataset)};
+		for(int i = 0; i < 8; ++i)
+		{
+			randomEdit(random, &journal, &dataset, cells, coarserCells);
+			Snapshot snapshot = takeSnapshot(dataset);
+			if(!(snapshot == history.back()))
+				history.push_back(std::move(snapshot));
+		}
+		
+		size_t position = history.size() - 1;
+		while(journal.canUndo() && position > 0)
+		{
+			EditJournal::Change change = journal.undo();
+			position -= 1;
+			CHECK(change.dataset == &dataset);
+			CHECK(takeSnapshot(dataset) == history[position]);
+		}
+		CHECK(position == 0);
+		CHECK(!journal.canUndo());
+		CHECK(journal.undo().dataset == nullptr);
+		
+		while(journal.canRedo())
+		{
+			journal.redo();
+			position += 1;
+			CHECK(position < history.size() && takeSnapshot(dataset) == history[position]);
+		}
+		CHECK(position == history.size() - 1);
+		
+		// Levels of detail and statistics follow the values that undo and redo write back
+		CHECK(dataset.lodGeoValues(TEST_RESOLUTION - 2).keys == dataset.parentGeoValues(TEST_RESOLUTION - 2).keys);
+		CHECK(dataset.statistics().count == dataset.geoValueCount());
+	}
+}
+
+
+// Past `maxByteCount` the oldest entries are dropped, the ones left still undo to the right states
+static void testByteCap()
+{
+	std::vector<H3Index> cells        = cellsAt(TEST_RESOLUTION);
+	std::vector<H3Index> coarserCells = cellsAt(TEST_RESOLUTION - 1);
+	std::mt19937_64      random(2);
+	Dataset              dataset = makeTestDataset(random, cells);
+	
+	EditJournal journal;
+	journal.maxByteCount = 200000;
+	std::vector<Snapshot> history = {takeSnapshot(dataset)};
+	for(int i = 0; i < 10; ++i)
+	{
+		randomEdit(random, &journal, &dataset, cells, coarserCells);
+		CHECK(journal.byteCount <= journal.maxByteCount);
+		Snapshot snapshot = takeSnapshot(dataset);
+		if(!(snapshot == history.back()))
+			history.push_back(std::move(snapshot));
+	}
+	CHECK(journal.undoEntries.size() < history.size() - 1);
+	
+	size_t position = history.size() - 1;
+	while(journal.canUndo())
+	{
+		journal.undo();
+		position -= 1;
+		CHECK(takeSnapshot(dataset) == history[position]);
+	}
+}
+
+
+// A new edit drops what could be redone, forget() drops everything about a dataset
+static void testRedoDropped()
+{
+	std::vector<H3Index> cells = cellsAt(TEST_RESOLUTION, 10);
+	std::mt19937_64      random(3);
+	Dataset              dataset = makeTestDataset(random, cells);
+	Dataset              other   = makeTestDataset(random, cells);
+	
+	EditJournal journal;
+	GeoValue    value;
+	value.integer = 100;
+	journal.recordUpdate(&dataset, cells.data(), 10, value);
+	dataset.updateGeoValues(cells.data(), 10, value);
+	journal.recordUpdate(&other, cells.data(), 10, value);
+	other.updateGeoValues(cells.data(), 10, value);
+	CHECK(journal.undoEntries.size() == 2);
+	
+	CHECK(journal.undo().dataset == &other);
+	CHECK(journal.canRedo());
+	journal.recordRemoval(&dataset, cells.data(), 10);
+	dataset.removeGeoValues(cells.data(), 10);
+	CHECK(!journal.canRedo());
+	
+	journal.forget(&dataset);
+	CHECK(!journal.canUndo());
+	CHECK(journal.byteCount == 0);
+}
+
+
+int main()
+{
+	testUndoRedo();
+	testByteCap();
+	testRedoDropped();
+	return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#ifndef GIAGUI_TESTUTILS_HPP
+#define GIAGUI_TESTUTILS_HPP
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+#include <QString>
+#include <h3/h3api.h>
+
+#include "Dataset.hpp"
+#include "MapUtils.hpp"
+
+
+// A failed CHECK prints where it failed and carries on, the test then returns checkFailures() as its exit code
+inline int& checkFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if(!(condition)) \
+		{ \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			checkFailures() += 1; \
+		} \
+	} while(false)
+
+
+// Every `stride`-th valid cell at `resolution`, in ascending index order
+// NOTE: Dense slots on the deleted axis of pentagons are not cells, h3IsValid() skips them
+inline std::vector<H3Index> cellsAt(int resolution, uint64_t stride = 1)
+{
+	std::vector<H3Index> result;
+	for(uint64_t slot = 0; slot < h3DenseSlotCount(resolution); slot += stride)
+	{
+		H3Index index = h3FromDenseSlot(slot, resolution);
+		if(h3IsValid(index))
+			result.push_back(index);
+	}
+	return result;
+}
+
+
+// A dataset at `resolution` with a value on each of `cells`, the one `valueFn(H3Index index)` returns as a GeoValue
+template<typename F>
+Dataset makeDataset(const std::vector<H3Index>& cells, int resolution, bool isInteger, F&& valueFn)
+{
+	std::vector<std::pair<H3Index, GeoValue>> entries;
+	entries.reserve(cells.size());
+	for(H3Index index : cells)
+		entries.push_back({index, valueFn(index)});
+	
+	SortedArrayMap<H3Index, GeoValue> values;
+	values.assign(std::move(entries));
+	Dataset dataset("test", false, isInteger);
+	dataset.replaceGeoValues(resolution, std::move(values));
+	return dataset;
+}
+
+
+// Path of a scratch file named `name` in the temporary directory
+inline QString temporaryFilePath(const char* name)
+{
+	return QString::fromStdString((std::filesystem::temp_directory_path() / name).string());
+}
+
+
+// Milliseconds `f()` takes, the best of `repeats` runs
+template<typename F>
+double measureMilliseconds(int repeats, F&& f)
+{
+	double best = 0.0;
+	for(int i = 0; i < repeats; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		f();
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		best = i == 0 ? elapsed : std::min(best, elapsed);
+	}
+	return best;
+}
+
+
+#endif //GIAGUI_TESTUTILS_HPP